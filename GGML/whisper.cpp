@@ -138,7 +138,8 @@ static void whisper_log_callback_default(ggml_log_level level, const char * text
     } while (0)
 
 #define WHISPER_MAX_DECODERS 8
-#define WHISPER_MAX_NODES 4096
+// room for the per-sequence cross-attention of whisper_decode_seqs()
+#define WHISPER_MAX_NODES 8192
 
 static std::string format(const char * fmt, ...) {
     va_list ap;
@@ -160,25 +161,24 @@ static std::string format(const char * fmt, ...) {
 //
 
 static bool ggml_graph_compute_helper(
+              ggml_backend_t   backend,
           struct ggml_cgraph * graph,
                          int   n_threads,
          ggml_abort_callback   abort_callback,
                         void * abort_callback_data) {
-    ggml_backend_ptr backend { ggml_backend_init_by_type(GGML_BACKEND_DEVICE_TYPE_CPU, nullptr) };
-
-    auto * reg = ggml_backend_dev_backend_reg(ggml_backend_get_device(backend.get()));
+    auto * reg = ggml_backend_dev_backend_reg(ggml_backend_get_device(backend));
 
     auto * set_abort_callback_fn = (ggml_backend_set_abort_callback_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_set_abort_callback");
     if (set_abort_callback_fn) {
-        set_abort_callback_fn(backend.get(), abort_callback, abort_callback_data);
+        set_abort_callback_fn(backend, abort_callback, abort_callback_data);
     }
 
     auto ggml_backend_set_n_threads_fn = (ggml_backend_set_n_threads_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_set_n_threads");
     if (ggml_backend_set_n_threads_fn) {
-        ggml_backend_set_n_threads_fn(backend.get(), n_threads);
+        ggml_backend_set_n_threads_fn(backend, n_threads);
     }
 
-    return ggml_backend_graph_compute(backend.get(), graph) == GGML_STATUS_SUCCESS;
+    return ggml_backend_graph_compute(backend, graph) == GGML_STATUS_SUCCESS;
 }
 
 static bool ggml_graph_compute_helper(
@@ -206,6 +206,101 @@ static bool ggml_graph_compute_helper(
     return t;
 }
 
+// persistent threadpool of the CPU backend
+// without it, the CPU backend creates and joins its worker threads for every graph, and the per-token decoder graphs are tiny
+// the functions are resolved through the backend registry, same as ggml_backend_set_n_threads above
+
+typedef ggml_threadpool_t (*whisper_threadpool_new_t)(struct ggml_threadpool_params * params);
+typedef void (*whisper_threadpool_free_t)(ggml_threadpool_t threadpool);
+typedef void (*whisper_backend_cpu_set_threadpool_t)(ggml_backend_t backend_cpu, ggml_threadpool_t threadpool);
+
+struct whisper_threadpool {
+    ggml_threadpool_t pool      = nullptr;
+    int               n_threads = 0;
+
+    // settings from whisper_context_params, applied when the pool is created
+    int32_t  poll       = 50;
+    int32_t  prio       = GGML_SCHED_PRIO_NORMAL;
+    bool     strict_cpu = false;
+    uint64_t cpumask    = 0;
+};
+
+static ggml_backend_reg_t whisper_cpu_backend_reg() {
+    ggml_backend_dev_t dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    return dev ? ggml_backend_dev_backend_reg(dev) : nullptr;
+}
+
+static void whisper_threadpool_init(whisper_threadpool & tp, const whisper_context_params & params) {
+    tp.poll       = params.cpu_poll;
+    tp.prio       = params.cpu_prio;
+    tp.strict_cpu = params.cpu_strict;
+    tp.cpumask    = params.cpu_mask;
+}
+
+static void whisper_threadpool_free(whisper_threadpool & tp) {
+    if (!tp.pool) {
+        return;
+    }
+
+    auto * reg = whisper_cpu_backend_reg();
+    auto * free_fn = reg ? (whisper_threadpool_free_t) ggml_backend_reg_get_proc_address(reg, "ggml_threadpool_free") : nullptr;
+    if (free_fn) {
+        free_fn(tp.pool);
+    }
+
+    tp.pool      = nullptr;
+    tp.n_threads = 0;
+}
+
+// attach the threadpool to the CPU backends of the list
+// the pool is created on the first call, and re-created when a graph needs more threads than the pool has
+static void whisper_threadpool_bind(whisper_threadpool & tp, const std::vector<ggml_backend_t> & backends, int n_threads) {
+    if (tp.pool && tp.n_threads >= n_threads) {
+        return;
+    }
+
+    auto * reg = whisper_cpu_backend_reg();
+    if (!reg) {
+        return;
+    }
+
+    auto * new_fn  = (whisper_threadpool_new_t)             ggml_backend_reg_get_proc_address(reg, "ggml_threadpool_new");
+    auto * free_fn = (whisper_threadpool_free_t)            ggml_backend_reg_get_proc_address(reg, "ggml_threadpool_free");
+    auto * set_fn  = (whisper_backend_cpu_set_threadpool_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_cpu_set_threadpool");
+    if (!new_fn || !free_fn || !set_fn) {
+        // the graphs will use disposable threads
+        return;
+    }
+
+    struct ggml_threadpool_params tpp = ggml_threadpool_params_default(n_threads);
+    tpp.prio       = (enum ggml_sched_priority) tp.prio;
+    tpp.poll       = (uint32_t) tp.poll;
+    tpp.strict_cpu = tp.strict_cpu;
+    for (int i = 0; i < 64 && i < GGML_MAX_N_THREADS; ++i) {
+        tpp.cpumask[i] = ((tp.cpumask >> i) & 1) != 0;
+    }
+
+    ggml_threadpool_t pool = new_fn(&tpp);
+    if (!pool) {
+        WHISPER_LOG_WARN("%s: failed to create threadpool with %d threads\n", __func__, n_threads);
+        return;
+    }
+
+    for (auto * backend : backends) {
+        ggml_backend_dev_t dev = ggml_backend_get_device(backend);
+        if (dev && ggml_backend_dev_type(dev) == GGML_BACKEND_DEVICE_TYPE_CPU) {
+            set_fn(backend, pool);
+        }
+    }
+
+    if (tp.pool) {
+        free_fn(tp.pool);
+    }
+
+    tp.pool      = pool;
+    tp.n_threads = n_threads;
+}
+
 // TODO: move these functions to ggml-base with support for ggml-backend?
 
 static ggml_tensor * whisper_set_f32(struct ggml_tensor * t, float v) {
@@ -852,6 +947,33 @@ struct whisper_decoder {
     mutable std::mt19937 rng; // used for sampling at t > 0.0
 };
 
+// view of the self-attention KV cache which the decoder graph writes the new tokens into
+// the offset is offs0 + kv_head*stride, the only part of the graph which depends on kv_head
+struct whisper_kv_view {
+    struct ggml_tensor * t;
+
+    size_t offs0;
+    size_t stride;
+};
+
+// the last decoder graph, reused by the following calls with the same shapes
+// the graph and its tensors live in sched_decode.meta, and the scheduler keeps the allocation between the calls
+struct whisper_decoder_graph {
+    struct ggml_cgraph * gf = nullptr;
+
+    int32_t n_tokens    = 0;
+    int32_t n_kv        = 0;
+    int32_t n_audio_ctx = 0;
+    bool    save_alignment_heads_QKs = false;
+
+    // (slot, n_tokens) runs of the cross-attention, see whisper_batch_cross_groups()
+    std::vector<int32_t> cross_groups;
+
+    ggml_backend_buffer_t kv_buffer = nullptr;
+
+    std::vector<whisper_kv_view> kv_views;
+};
+
 // [EXPERIMENTAL] Token-level timestamps with DTW
 struct whisper_aheads_masks {
     std::vector<struct ggml_tensor *> m;    // One mask per text layer.
@@ -888,8 +1010,20 @@ struct whisper_state {
 
     // cross-attention KV cache for the decoders
     // shared between all decoders
+    // holds n_seq equal slots, one encoded audio window per slot, see whisper_state_init_seqs()
     whisper_kv_cache kv_cross;
 
+    int32_t n_seq = 1;
+
+    // the slot written by the next encoder run
+    int32_t cross_slot_enc = 0;
+
+    // the slot each sequence attends to, the sequences outside of [0, WHISPER_MAX_DECODERS) use slot 0
+    int32_t cross_slot[WHISPER_MAX_DECODERS] = {};
+
+    // offset in `logits` of the last token of every sequence of the last whisper_decode_seqs() call
+    std::vector<size_t> seq_logits;
+
     // padded buffer for flash-attention
     whisper_kv_cache kv_pad;
 
@@ -901,12 +1035,17 @@ struct whisper_state {
 
     std::vector<ggml_backend_t> backends;
 
+    // worker threads of the CPU backend, shared by all graphs of this state
+    whisper_threadpool threadpool;
+
     // - stores meta info about the intermediate tensors into the `meta` buffers
     whisper_sched sched_conv;
     whisper_sched sched_encode;
     whisper_sched sched_cross;
     whisper_sched sched_decode;
 
+    whisper_decoder_graph decoder_graph;
+
     // result of the encoder
     struct ggml_tensor * embd_conv = nullptr;
     struct ggml_tensor * embd_enc  = nullptr;
@@ -995,10 +1134,74 @@ static void read_safe(whisper_model_loader * loader, T & dest) {
     BYTESWAP_VALUE(dest);
 }
 
+// read the headers of all tensors in the file, skipping the payloads, then rewind the loader back to the first tensor
+// the ftype in the model header is only the most common type, the quantizer writes models with per-tensor types
+static bool whisper_model_scan_tensor_types(whisper_model_loader * loader, std::map<std::string, ggml_type> & types) {
+    const size_t offset_start = loader->tell(loader->context);
+
+    std::string name;
+
+    while (true) {
+        int32_t n_dims;
+        int32_t length;
+        int32_t ttype;
+
+        read_safe(loader, n_dims);
+        read_safe(loader, length);
+        read_safe(loader, ttype);
+
+        if (loader->eof(loader->context)) {
+            break;
+        }
+
+        if (n_dims < 1 || n_dims > 4 || length <= 0 || ttype < 0 || ttype >= GGML_TYPE_COUNT || ggml_blck_size((ggml_type) ttype) == 0) {
+            WHISPER_LOG_ERROR("%s: invalid tensor header: n_dims = %d, length = %d, type = %d\n", __func__, n_dims, length, ttype);
+            return false;
+        }
+
+        int64_t nelements = 1;
+        int32_t ne[4] = { 1, 1, 1, 1 };
+        for (int i = 0; i < n_dims; ++i) {
+            read_safe(loader, ne[i]);
+            nelements *= ne[i];
+        }
+
+        name.resize(length);
+        loader->read(loader->context, &name[0], name.size());
+
+        const ggml_type type = (ggml_type) ttype;
+        if (ne[0] <= 0 || nelements <= 0 || ne[0] % ggml_blck_size(type) != 0) {
+            WHISPER_LOG_ERROR("%s: tensor '%s' has invalid shape for the type %s\n", __func__, name.c_str(), ggml_type_name(type));
+            return false;
+        }
+
+        types[name] = type;
+
+        const size_t nbytes = ggml_row_size(type, ne[0])*(size_t)(nelements/ne[0]);
+        if (!loader->seek(loader->context, loader->tell(loader->context) + nbytes)) {
+            WHISPER_LOG_ERROR("%s: failed to skip the payload of tensor '%s'\n", __func__, name.c_str());
+            return false;
+        }
+    }
+
+    return loader->seek(loader->context, offset_start);
+}
+
+// change the type of the weight tensor which was not allocated yet
+static void whisper_tensor_set_type(ggml_tensor * t, ggml_type type) {
+    t->type  = type;
+    t->nb[0] = ggml_type_size(type);
+    t->nb[1] = t->nb[0]*(t->ne[0]/ggml_blck_size(type));
+    for (int i = 2; i < GGML_MAX_DIMS; i++) {
+        t->nb[i] = t->nb[i - 1]*t->ne[i - 1];
+    }
+}
+
 static bool whisper_kv_cache_init(
              struct whisper_kv_cache & cache,
                       ggml_backend_t   backend,
-                           ggml_type   wtype,
+                           ggml_type   type_k,
+                           ggml_type   type_v,
                              int64_t   n_text_state,
                              int64_t   n_text_layer,
                                  int   n_ctx) {
@@ -1026,8 +1229,8 @@ static bool whisper_kv_cache_init(
         return false;
     }
 
-    cache.k = ggml_new_tensor_1d(ctx, wtype, n_elements);
-    cache.v = ggml_new_tensor_1d(ctx, wtype, n_elements);
+    cache.k = ggml_new_tensor_1d(ctx, type_k, n_elements);
+    cache.v = ggml_new_tensor_1d(ctx, type_v, n_elements);
 
     cache.buffer = ggml_backend_alloc_ctx_tensors(ctx, backend);
     if (!cache.buffer) {
@@ -1044,6 +1247,7 @@ static bool whisper_kv_cache_init(
 
 static void whisper_kv_cache_free(struct whisper_kv_cache & cache) {
     ggml_backend_buffer_free(cache.buffer);
+    cache.buffer = nullptr;
 }
 
 static bool whisper_kv_cache_find_slot(
@@ -1386,6 +1590,11 @@ static std::vector<ggml_backend_t> whisper_backend_init(const whisper_context_pa
 
 using buft_list_t = std::vector<std::pair<ggml_backend_dev_t, ggml_backend_buffer_type_t>>;
 
+// the buffer type of ggml-cpu which repacks the quantized weights into the interleaved layouts of its GEMM kernels
+static bool whisper_buft_is_repack(ggml_backend_buffer_type_t buft) {
+    return strcmp(ggml_backend_buft_name(buft), "CPU_REPACK") == 0;
+}
+
 static buft_list_t make_buft_list(whisper_context_params & params) {
     // Prio order: GPU -> CPU Extra -> CPU
     buft_list_t buft_list;
@@ -1418,7 +1627,9 @@ static buft_list_t make_buft_list(whisper_context_params & params) {
     if (get_extra_bufts_fn) {
         ggml_backend_buffer_type_t * extra_bufts = get_extra_bufts_fn(cpu_dev);
         while (extra_bufts && *extra_bufts) {
-            buft_list.emplace_back(cpu_dev, *extra_bufts);
+            if (params.cpu_repack || !whisper_buft_is_repack(*extra_bufts)) {
+                buft_list.emplace_back(cpu_dev, *extra_bufts);
+            }
             ++extra_bufts;
         }
     }
@@ -1695,6 +1906,16 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
     const ggml_type wtype = wctx.wtype;
     const ggml_type vtype = wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16; // conv type
 
+    // the types of the tensors stored in the file, when the loader can seek
+    // without it, every tensor must have the type derived from the ftype in the header
+    std::map<std::string, ggml_type> file_types;
+    if (loader->tell && loader->seek) {
+        if (!whisper_model_scan_tensor_types(loader, file_types)) {
+            WHISPER_LOG_ERROR("%s: failed to read the tensor types\n", __func__);
+            return false;
+        }
+    }
+
     const auto & hparams = model.hparams;
 
     const int n_audio_layer = hparams.n_audio_layer;
@@ -1729,17 +1950,32 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
     // Create a list of available bufts, in priority order
     buft_list_t buft_list = make_buft_list(wctx.params);
 
+    // with cpu_repack, the matrix multiplication weights placed in the system memory, for the report after loading
+    std::vector<std::pair<std::string, ggml_tensor *>> cpu_mul_mat_weights;
+
     auto create_tensor = [&](asr_tensor type, asr_system system, ggml_tensor * meta, int layer = 0) -> ggml_tensor * {
+        std::string name = format(ASR_TENSOR_NAMES.at(system).at(type), layer);
+
+        // mixed-precision models; the buffer type depends on the tensor type, so this happens before selecting it
+        const auto it_type = file_types.find(name);
+        if (it_type != file_types.end() && it_type->second != meta->type) {
+            whisper_tensor_set_type(meta, it_type->second);
+        }
+
         ggml_op op = ASR_TENSOR_INFO.at(type);
         ggml_backend_buffer_type_t buft = select_weight_buft(hparams, meta, op, buft_list);
         if (!buft) {
-            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", ASR_TENSOR_NAMES.at(system).at(type)));
+            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", name.c_str()));
         }
 
         ggml_context * ctx = get_ctx(buft);
         ggml_tensor * tensor = ggml_dup_tensor(ctx, meta);
 
-        model.tensors[format(ASR_TENSOR_NAMES.at(system).at(type), layer)] = tensor;
+        if (wctx.params.cpu_repack && op == GGML_OP_MUL_MAT && ggml_backend_buft_get_device(buft) == ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU)) {
+            cpu_mul_mat_weights.emplace_back(name, tensor);
+        }
+
+        model.tensors[name] = tensor;
 
         return tensor;
     };
@@ -1929,6 +2165,12 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
                 return false;
             }
 
+            if (tensor->type != ttype) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has type %d in model file, expected %s\n",
+                        __func__, name.data(), ttype, ggml_type_name(tensor->type));
+                return false;
+            }
+
             const size_t bpe = ggml_type_size(ggml_type(ttype));
 
             if ((nelements*bpe)/ggml_blck_size(tensor->type) != ggml_nbytes(tensor)) {
@@ -1964,6 +2206,29 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
         }
     }
 
+    // report which weights were repacked into the interleaved layouts
+    // the repack kernels only support some quantized types and shapes, the rest stay in the plain CPU buffer
+    if (!cpu_mul_mat_weights.empty()) {
+        int    n_repacked    = 0;
+        size_t size_repacked = 0;
+
+        for (const auto & w : cpu_mul_mat_weights) {
+            const ggml_tensor * t = w.second;
+            const bool repacked = whisper_buft_is_repack(ggml_backend_buffer_get_type(t->buffer));
+
+            WHISPER_LOG_INFO("%s: %-36s %-6s [%5d, %5d] %s\n", __func__, w.first.c_str(), ggml_type_name(t->type),
+                    (int) t->ne[0], (int) t->ne[1], repacked ? "repacked" : "not repacked");
+
+            if (repacked) {
+                n_repacked++;
+                size_repacked += ggml_nbytes(t);
+            }
+        }
+
+        WHISPER_LOG_INFO("%s: repacked %d of %zu CPU matrix weights, %.2f MB\n", __func__,
+                n_repacked, cpu_mul_mat_weights.size(), size_repacked/1e6);
+    }
+
     for (auto & buf : model.buffers) {
         ggml_backend_buffer_set_usage(buf, GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
     }
@@ -2286,6 +2551,62 @@ static struct ggml_cgraph * whisper_build_graph_encoder(
     return gf;
 }
 
+// byte offset of the cross-attention slot in kv_cross.k or kv_cross.v
+static size_t whisper_kv_cross_slot_offs(const whisper_state & wstate, const struct ggml_tensor * t, int32_t slot) {
+    return (ggml_nbytes(t)/wstate.n_seq)*slot;
+}
+
+static int32_t whisper_cross_slot_of_seq(const whisper_state & wstate, whisper_seq_id seq_id) {
+    return seq_id >= 0 && seq_id < WHISPER_MAX_DECODERS ? wstate.cross_slot[seq_id] : 0;
+}
+
+// split the batch into runs of consecutive tokens which attend to the same cross-attention slot
+// returns flattened (slot, n_tokens) pairs
+static std::vector<int32_t> whisper_batch_cross_groups(const whisper_state & wstate, const whisper_batch & batch) {
+    std::vector<int32_t> res;
+
+    for (int i = 0; i < batch.n_tokens; ++i) {
+        const int32_t slot = whisper_cross_slot_of_seq(wstate, batch.seq_id[i][0]);
+
+        if (!res.empty() && res[res.size() - 2] == slot) {
+            res.back()++;
+        } else {
+            res.push_back(slot);
+            res.push_back(1);
+        }
+    }
+
+    return res;
+}
+
+// the legacy single-audio API: the encoder writes slot 0, and every sequence attends to it
+static void whisper_cross_slots_reset(whisper_state & wstate) {
+    wstate.cross_slot_enc = 0;
+    std::fill(std::begin(wstate.cross_slot), std::end(wstate.cross_slot), 0);
+}
+
+// [EXPERIMENTAL] Token-level timestamps with DTW
+// select the alignment heads of the layer from the cross-attention weights [n_audio_ctx, n_tokens, n_head]
+// and append them to aheads_cross_QKs, along the heads dimension
+static void whisper_aheads_append(
+        struct ggml_context * ctx0,
+        struct ggml_tensor  * aheads_mask,
+        struct ggml_tensor  * KQ_soft_max,
+        struct ggml_tensor *& aheads_cross_QKs) {
+    struct ggml_tensor * aheads_KQs = ggml_reshape_2d(ctx0, KQ_soft_max, KQ_soft_max->ne[0] * KQ_soft_max->ne[1], KQ_soft_max->ne[2]);
+    aheads_KQs = ggml_transpose(ctx0, aheads_KQs);
+    aheads_KQs = ggml_cont(ctx0, aheads_KQs);
+    aheads_KQs = ggml_mul_mat(ctx0, aheads_mask, aheads_KQs);
+    aheads_KQs = ggml_transpose(ctx0, aheads_KQs);
+    aheads_KQs = ggml_cont(ctx0, aheads_KQs);
+    aheads_KQs = ggml_reshape_3d(ctx0, aheads_KQs, KQ_soft_max->ne[0], KQ_soft_max->ne[1], aheads_mask->ne[1]);
+    if (aheads_cross_QKs == NULL) {
+        aheads_cross_QKs = aheads_KQs;
+    } else {
+        aheads_cross_QKs = ggml_concat(ctx0, aheads_cross_QKs, aheads_KQs, 2);
+    }
+}
+
 // pre-compute cross-attention memory
 static struct ggml_cgraph * whisper_build_graph_cross(
         whisper_context & wctx,
@@ -2301,6 +2622,9 @@ static struct ggml_cgraph * whisper_build_graph_cross(
 
     const int n_ctx_pad = GGML_PAD(n_ctx, 256);
 
+    const size_t k_slot_offs = whisper_kv_cross_slot_offs(wstate, wstate.kv_cross.k, wstate.cross_slot_enc);
+    const size_t v_slot_offs = whisper_kv_cross_slot_offs(wstate, wstate.kv_cross.v, wstate.cross_slot_enc);
+
     struct ggml_init_params params = {
         /*.mem_size   =*/ wstate.sched_cross.meta.size(),
         /*.mem_buffer =*/ wstate.sched_cross.meta.data(),
@@ -2337,19 +2661,19 @@ static struct ggml_cgraph * whisper_build_graph_cross(
 
         if (wctx.params.flash_attn) {
             k = ggml_view_1d(ctx0, wstate.kv_cross.k, n_state*n_ctx,
-                    (ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx_pad));
+                    (ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx_pad) + k_slot_offs);
 
             v = ggml_view_1d(ctx0, wstate.kv_cross.v, n_state*n_ctx,
-                    (ggml_element_size(wstate.kv_cross.v)*n_state)*(il*n_ctx_pad));
+                    (ggml_element_size(wstate.kv_cross.v)*n_state)*(il*n_ctx_pad) + v_slot_offs);
         } else {
             Vcross = ggml_transpose(ctx0, ggml_reshape_2d(ctx0, Vcross, n_state, n_ctx));
 
             k = ggml_view_1d(ctx0, wstate.kv_cross.k, n_state*n_ctx,
-                    (ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx));
+                    (ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx) + k_slot_offs);
 
             v = ggml_view_2d(ctx0, wstate.kv_cross.v, n_ctx, n_state,
                     (   n_ctx)*ggml_element_size(wstate.kv_cross.v),
-                    (il*n_ctx)*ggml_element_size(wstate.kv_cross.v)*n_state);
+                    (il*n_ctx)*ggml_element_size(wstate.kv_cross.v)*n_state + v_slot_offs);
         }
 
         ggml_build_forward_expand(gf, ggml_cpy(ctx0, Kcross, k));
@@ -2382,6 +2706,8 @@ static bool whisper_encode_internal(
                    void * abort_callback_data) {
     const int64_t t_start_us = ggml_time_us();
 
+    whisper_threadpool_bind(wstate.threadpool, wstate.backends, n_threads);
+
     // conv
     {
         auto & sched = wstate.sched_conv.sched;
@@ -2499,8 +2825,13 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
     const int32_t n_kv    = worst_case ? n_ctx            : kv_self.n;
     const int32_t kv_head = worst_case ? n_ctx - n_tokens : kv_self.head;
 
+    const std::vector<int32_t> cross_groups = whisper_batch_cross_groups(wstate, batch);
+
     //WHISPER_LOG_DEBUG("%s: n_past = %d, n_tokens = %d, n_audio_ctx = %d, n_ctx = %d\n", __func__, n_past, n_tokens, n_audio_ctx, n_ctx);
 
+    auto & kv_views = wstate.decoder_graph.kv_views;
+    kv_views.clear();
+
     struct ggml_init_params params = {
         /*.mem_size   =*/ wstate.sched_decode.meta.size(),
         /*.mem_buffer =*/ wstate.sched_decode.meta.data(),
@@ -2585,25 +2916,40 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
                 struct ggml_tensor * k;
                 struct ggml_tensor * v;
 
+                // note: row sizes instead of element sizes, the cache may be quantized
                 if (wctx.params.flash_attn) {
                     k = ggml_view_1d(ctx0, kv_self.k, n_tokens*n_state,
-                            (ggml_element_size(kv_self.k)*n_state)*(il*n_ctx + kv_head));
+                            ggml_row_size(kv_self.k->type, n_state)*(il*n_ctx + kv_head));
 
                     v = ggml_view_1d(ctx0, kv_self.v, n_tokens*n_state,
-                            (ggml_element_size(kv_self.v)*n_state)*(il*n_ctx + kv_head));
+                            ggml_row_size(kv_self.v->type, n_state)*(il*n_ctx + kv_head));
                 } else {
                     Vcur = ggml_transpose(ctx0, ggml_reshape_2d(ctx0, Vcur, n_state, n_tokens));
 
                     k = ggml_view_1d(ctx0, kv_self.k, n_tokens*n_state,
-                            (ggml_element_size(kv_self.k)*n_state)*(il*n_ctx + kv_head));
+                            ggml_row_size(kv_self.k->type, n_state)*(il*n_ctx + kv_head));
 
                     v = ggml_view_2d(ctx0, kv_self.v, n_tokens, n_state,
                             (   n_ctx)*ggml_element_size(kv_self.v),
                             (il*n_ctx)*ggml_element_size(kv_self.v)*n_state + kv_head*ggml_element_size(kv_self.v));
                 }
 
-                ggml_build_forward_expand(gf, ggml_cpy(ctx0, Kcur, k));
-                ggml_build_forward_expand(gf, ggml_cpy(ctx0, Vcur, v));
+                struct ggml_tensor * k_cpy = ggml_cpy(ctx0, Kcur, k);
+                struct ggml_tensor * v_cpy = ggml_cpy(ctx0, Vcur, v);
+
+                ggml_build_forward_expand(gf, k_cpy);
+                ggml_build_forward_expand(gf, v_cpy);
+
+                // the copies are views of the cache as well, with the same offsets
+                {
+                    const size_t k_stride = ggml_row_size(kv_self.k->type, n_state);
+                    const size_t v_stride = wctx.params.flash_attn ? ggml_row_size(kv_self.v->type, n_state) : ggml_element_size(kv_self.v);
+
+                    kv_views.push_back({ k,     k->view_offs     - kv_head*k_stride, k_stride });
+                    kv_views.push_back({ k_cpy, k_cpy->view_offs - kv_head*k_stride, k_stride });
+                    kv_views.push_back({ v,     v->view_offs     - kv_head*v_stride, v_stride });
+                    kv_views.push_back({ v_cpy, v_cpy->view_offs - kv_head*v_stride, v_stride });
+                }
             }
 
             // ------
@@ -2616,17 +2962,17 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
             struct ggml_tensor * K =
                 ggml_view_3d(ctx0, kv_self.k,
                         n_state_head, n_kv, n_head,
-                        ggml_element_size(kv_self.k)*n_state,
-                        ggml_element_size(kv_self.k)*n_state_head,
-                        ggml_element_size(kv_self.k)*n_state*n_ctx*il);
+                        ggml_row_size(kv_self.k->type, n_state),
+                        ggml_row_size(kv_self.k->type, n_state_head),
+                        ggml_row_size(kv_self.k->type, n_state)*n_ctx*il);
 
             if (wctx.params.flash_attn) {
                 struct ggml_tensor * V =
                     ggml_view_3d(ctx0, kv_self.v,
                             n_state_head, n_kv, n_head,
-                            ggml_element_size(kv_self.v)*n_state,
-                            ggml_element_size(kv_self.v)*n_state_head,
-                            ggml_element_size(kv_self.v)*n_state*n_ctx*il);
+                            ggml_row_size(kv_self.v->type, n_state),
+                            ggml_row_size(kv_self.v->type, n_state_head),
+                            ggml_row_size(kv_self.v->type, n_state)*n_ctx*il);
 
                 cur = ggml_flash_attn_ext(ctx0, Q, K, V, KQ_mask_f16, 1.0f, 0.0f, 0.0f);
 
@@ -2688,75 +3034,103 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
                         Qcur,
                         layer.cross_attn_q_b);
 
-            struct ggml_tensor * Q =
-                ggml_permute(ctx0,
-                        ggml_reshape_3d(ctx0, Qcur, n_state_head, n_head, n_tokens),
-                        0, 2, 1, 3);
+            // every run of tokens attends to the audio of its own slot, the results are concatenated back in the batch order
+            struct ggml_tensor * KQV_cat = nullptr;
 
-            if (wctx.params.flash_attn) {
-                struct ggml_tensor * Kcross =
-                    ggml_view_3d(ctx0, wstate.kv_cross.k,
-                            n_state_head, n_audio_ctx_pad, n_head,
-                            ggml_element_size(wstate.kv_cross.k)*n_state,
-                            ggml_element_size(wstate.kv_cross.k)*n_state_head,
-                            ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx_pad*il);
-
-                struct ggml_tensor * Vcross =
-                    ggml_view_3d(ctx0, wstate.kv_cross.v,
-                            n_state_head, n_audio_ctx_pad, n_head,
-                            ggml_element_size(wstate.kv_cross.v)*n_state,
-                            ggml_element_size(wstate.kv_cross.v)*n_state_head,
-                            ggml_element_size(wstate.kv_cross.v)*n_state*n_audio_ctx_pad*il);
-
-                cur = ggml_flash_attn_ext(ctx0, Q, Kcross, Vcross, nullptr, KQscale, 0.0f, 0.0f);
+            for (size_t ig = 0, t0 = 0; ig < cross_groups.size(); ig += 2) {
+                const int32_t slot = cross_groups[ig + 0];
+                const int32_t n_g  = cross_groups[ig + 1];
 
-                cur = ggml_reshape_2d(ctx0, cur, n_state, n_tokens);
-            } else {
-                struct ggml_tensor * Kcross =
-                    ggml_view_3d(ctx0, wstate.kv_cross.k,
-                            n_state_head, n_audio_ctx, n_head,
-                            ggml_element_size(wstate.kv_cross.k)*n_state,
-                            ggml_element_size(wstate.kv_cross.k)*n_state_head,
-                            ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx*il);
-
-                struct ggml_tensor * Vcross =
-                    ggml_view_3d(ctx0, wstate.kv_cross.v,
-                            n_audio_ctx, n_state_head, n_head,
-                            n_audio_ctx*ggml_element_size(wstate.kv_cross.v),
-                            n_audio_ctx*ggml_element_size(wstate.kv_cross.v)*n_state_head,
-                            n_audio_ctx*ggml_element_size(wstate.kv_cross.v)*n_state*il);
-
-                // ------
+                const size_t k_slot_offs = whisper_kv_cross_slot_offs(wstate, wstate.kv_cross.k, slot);
+                const size_t v_slot_offs = whisper_kv_cross_slot_offs(wstate, wstate.kv_cross.v, slot);
 
-                // K * Q
-                struct ggml_tensor * KQ = ggml_mul_mat(ctx0, Kcross, Q);
+                struct ggml_tensor * Q =
+                    ggml_permute(ctx0,
+                            ggml_view_3d(ctx0, Qcur, n_state_head, n_head, n_g,
+                                Qcur->nb[0]*n_state_head,
+                                Qcur->nb[1],
+                                Qcur->nb[1]*t0),
+                            0, 2, 1, 3);
 
-                struct ggml_tensor * KQ_soft_max = ggml_soft_max_ext(ctx0, KQ, nullptr, KQscale, 0.0f);
+                struct ggml_tensor * KQV_g = nullptr;
 
-                // [EXPERIMENTAL] Token-level timestamps with DTW
-                if (wctx.params.dtw_token_timestamps) {
-                    if (wstate.aheads_masks.m[il] != nullptr) {
-                        struct ggml_tensor * aheads_KQs = ggml_reshape_2d(ctx0, KQ_soft_max, KQ_soft_max->ne[0] * KQ_soft_max->ne[1], KQ_soft_max->ne[2]);
-                        aheads_KQs = ggml_transpose(ctx0, aheads_KQs);
-                        aheads_KQs = ggml_cont(ctx0, aheads_KQs);
-                        aheads_KQs = ggml_mul_mat(ctx0, wstate.aheads_masks.m[il], aheads_KQs);
-                        aheads_KQs = ggml_transpose(ctx0, aheads_KQs);
-                        aheads_KQs = ggml_cont(ctx0, aheads_KQs);
-                        aheads_KQs = ggml_reshape_3d(ctx0, aheads_KQs, KQ_soft_max->ne[0], KQ_soft_max->ne[1], wstate.aheads_masks.m[il]->ne[1]);
-                        if (aheads_cross_QKs == NULL) {
-                            aheads_cross_QKs = aheads_KQs;
-                        } else {
-                            aheads_cross_QKs = ggml_concat(ctx0, aheads_cross_QKs, aheads_KQs, 2);
-                        }
+                if (wctx.params.flash_attn) {
+                    struct ggml_tensor * Kcross =
+                        ggml_view_3d(ctx0, wstate.kv_cross.k,
+                                n_state_head, n_audio_ctx_pad, n_head,
+                                ggml_element_size(wstate.kv_cross.k)*n_state,
+                                ggml_element_size(wstate.kv_cross.k)*n_state_head,
+                                ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx_pad*il + k_slot_offs);
+
+                    struct ggml_tensor * Vcross =
+                        ggml_view_3d(ctx0, wstate.kv_cross.v,
+                                n_state_head, n_audio_ctx_pad, n_head,
+                                ggml_element_size(wstate.kv_cross.v)*n_state,
+                                ggml_element_size(wstate.kv_cross.v)*n_state_head,
+                                ggml_element_size(wstate.kv_cross.v)*n_state*n_audio_ctx_pad*il + v_slot_offs);
+
+                    KQV_g = ggml_flash_attn_ext(ctx0, Q, Kcross, Vcross, nullptr, KQscale, 0.0f, 0.0f);
+
+                    KQV_g = ggml_reshape_2d(ctx0, KQV_g, n_state, n_g);
+
+                    // [EXPERIMENTAL] Token-level timestamps with DTW
+                    // flash attention doesn't output the weights, so they are computed separately,
+                    // only in the layers with alignment heads, and without the padding of the audio context
+                    if (wctx.params.dtw_token_timestamps && cross_groups.size() == 2 && wstate.aheads_masks.m[il] != nullptr) {
+                        struct ggml_tensor * Kaheads =
+                            ggml_view_3d(ctx0, wstate.kv_cross.k,
+                                    n_state_head, n_audio_ctx, n_head,
+                                    ggml_element_size(wstate.kv_cross.k)*n_state,
+                                    ggml_element_size(wstate.kv_cross.k)*n_state_head,
+                                    ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx_pad*il + k_slot_offs);
+
+                        struct ggml_tensor * KQ = ggml_mul_mat(ctx0, Kaheads, Q);
+
+                        struct ggml_tensor * KQ_soft_max = ggml_soft_max_ext(ctx0, KQ, nullptr, KQscale, 0.0f);
+
+                        whisper_aheads_append(ctx0, wstate.aheads_masks.m[il], KQ_soft_max, aheads_cross_QKs);
+                    }
+                } else {
+                    struct ggml_tensor * Kcross =
+                        ggml_view_3d(ctx0, wstate.kv_cross.k,
+                                n_state_head, n_audio_ctx, n_head,
+                                ggml_element_size(wstate.kv_cross.k)*n_state,
+                                ggml_element_size(wstate.kv_cross.k)*n_state_head,
+                                ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx*il + k_slot_offs);
+
+                    struct ggml_tensor * Vcross =
+                        ggml_view_3d(ctx0, wstate.kv_cross.v,
+                                n_audio_ctx, n_state_head, n_head,
+                                n_audio_ctx*ggml_element_size(wstate.kv_cross.v),
+                                n_audio_ctx*ggml_element_size(wstate.kv_cross.v)*n_state_head,
+                                n_audio_ctx*ggml_element_size(wstate.kv_cross.v)*n_state*il + v_slot_offs);
+
+                    // ------
+
+                    // K * Q
+                    struct ggml_tensor * KQ = ggml_mul_mat(ctx0, Kcross, Q);
+
+                    struct ggml_tensor * KQ_soft_max = ggml_soft_max_ext(ctx0, KQ, nullptr, KQscale, 0.0f);
+
+                    // [EXPERIMENTAL] Token-level timestamps with DTW
+                    // only for the batches of a single audio window, which is always the case for whisper_full()
+                    if (wctx.params.dtw_token_timestamps && cross_groups.size() == 2 && wstate.aheads_masks.m[il] != nullptr) {
+                        whisper_aheads_append(ctx0, wstate.aheads_masks.m[il], KQ_soft_max, aheads_cross_QKs);
                     }
-                }
 
-                struct ggml_tensor * KQV = ggml_mul_mat(ctx0, Vcross, KQ_soft_max);
+                    struct ggml_tensor * KQV = ggml_mul_mat(ctx0, Vcross, KQ_soft_max);
 
-                struct ggml_tensor * KQV_merged = ggml_permute(ctx0, KQV, 0, 2, 1, 3);
+                    struct ggml_tensor * KQV_merged = ggml_permute(ctx0, KQV, 0, 2, 1, 3);
 
-                cur = ggml_cont_2d(ctx0, KQV_merged, n_state, n_tokens);
+                    KQV_g = ggml_cont_2d(ctx0, KQV_merged, n_state, n_g);
+                }
+
+                KQV_cat = KQV_cat ? ggml_concat(ctx0, KQV_cat, KQV_g, 1) : KQV_g;
+
+                t0 += n_g;
             }
+
+            cur = KQV_cat;
         }
 
         // projection
@@ -2851,6 +3225,23 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
     return gf;
 }
 
+// move the KV cache writes of an allocated decoder graph to another kv_head
+// the views share the buffer of the cache, so besides the offsets there is nothing to re-initialize
+static void whisper_decoder_graph_set_head(whisper_decoder_graph & dg, int32_t kv_head) {
+    for (const auto & kv : dg.kv_views) {
+        struct ggml_tensor * t = kv.t;
+
+        const size_t offs = kv.offs0 + kv_head*kv.stride;
+
+        t->view_offs = offs;
+        t->data      = (char *) t->view_src->data + offs;
+
+        if (t->op == GGML_OP_VIEW) {
+            memcpy(t->op_params, &offs, sizeof(offs));
+        }
+    }
+}
+
 // evaluate the decoder
 //
 // given text prompt + audio features -> computes the logits for the next token
@@ -2871,6 +3262,8 @@ static bool whisper_decode_internal(
                    void * abort_callback_data) {
     const int64_t t_start_us = ggml_time_us();
 
+    whisper_threadpool_bind(wstate.threadpool, wstate.backends, n_threads);
+
     const auto & model   = wctx.model;
     const auto & hparams = model.hparams;
 
@@ -2899,12 +3292,50 @@ static bool whisper_decode_internal(
     // decoder
     {
         auto & sched = wstate.sched_decode.sched;
+        auto & dg    = wstate.decoder_graph;
 
-        ggml_cgraph * gf = whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+        const auto & kv_self = wstate.kv_self;
 
-        if (!ggml_backend_sched_alloc_graph(sched, gf)) {
-            // should never happen as we pre-allocate the memory
-            return false;
+        const int32_t n_audio_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
+
+        const std::vector<int32_t> cross_groups = whisper_batch_cross_groups(wstate, batch);
+
+        // during the text generation, the graph only changes when kv_self.n grows to the next padding boundary
+        // in between, reuse the allocated graph and only move the KV cache writes to the new head
+        const bool reuse =
+            dg.gf          != nullptr              &&
+            dg.n_tokens    == n_tokens             &&
+            dg.n_kv        == (int32_t) kv_self.n  &&
+            dg.n_audio_ctx == n_audio_ctx          &&
+            dg.kv_buffer   == kv_self.buffer       &&
+            dg.cross_groups == cross_groups        &&
+            dg.save_alignment_heads_QKs == save_alignment_heads_QKs;
+
+        ggml_cgraph * gf = nullptr;
+
+        if (reuse) {
+            gf = dg.gf;
+            whisper_decoder_graph_set_head(dg, kv_self.head);
+        } else {
+            dg.gf = nullptr;
+
+            // release the allocation of the previous graph
+            ggml_backend_sched_reset(sched);
+
+            gf = whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+
+            if (!ggml_backend_sched_alloc_graph(sched, gf)) {
+                // should never happen as we pre-allocate the memory
+                return false;
+            }
+
+            dg.gf          = gf;
+            dg.n_tokens    = n_tokens;
+            dg.n_kv        = kv_self.n;
+            dg.n_audio_ctx = n_audio_ctx;
+            dg.kv_buffer   = kv_self.buffer;
+            dg.cross_groups = cross_groups;
+            dg.save_alignment_heads_QKs = save_alignment_heads_QKs;
         }
 
         // set the inputs
@@ -2924,8 +3355,6 @@ static bool whisper_decode_internal(
         {
             struct ggml_tensor * KQ_mask = ggml_graph_get_tensor(gf, "KQ_mask");
 
-            auto & kv_self = wstate.kv_self;
-
             const int32_t n_kv = kv_self.n;
 
             wstate.inp_mask.resize(ggml_nelements(KQ_mask));
@@ -2957,7 +3386,9 @@ static bool whisper_decode_internal(
 
         logits = ggml_graph_node(gf, -1);
 
-        if (!ggml_graph_compute_helper(sched, gf, n_threads)) {
+        // keep the allocation for the next call, the helper resets the scheduler on failure
+        if (!ggml_graph_compute_helper(sched, gf, n_threads, false)) {
+            dg.gf = nullptr;
             return false;
         }
     }
@@ -3397,10 +3828,13 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         return nullptr;
     }
 
+    // the threads are created by the first graph computation, when the number of threads is known
+    whisper_threadpool_init(state->threadpool, ctx->params);
+
     // at this point, we don't know yet how many decoders will be used
     // later during decoding, if more decoders are used, we will recreate the KV cache respectively
     state->kv_self_n_dec = 1;
-    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->params.type_k, ctx->params.type_v,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
                 GGML_PAD(ctx->model.hparams.n_text_ctx, 256))) {
@@ -3414,7 +3848,7 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         WHISPER_LOG_INFO("%s: kv self size  = %7.2f MB\n", __func__, memory_size / 1e6);
     }
 
-    if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->itype, ctx->itype,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
                 GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
@@ -3428,7 +3862,7 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         WHISPER_LOG_INFO("%s: kv cross size = %7.2f MB\n", __func__, memory_size / 1e6);
     }
 
-    if (!whisper_kv_cache_init(state->kv_pad, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_pad, state->backends[0], ctx->itype, ctx->itype,
                 ctx->model.hparams.n_audio_state,
                 1,
                 GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
@@ -3622,7 +4056,7 @@ int whisper_ctx_init_openvino_encoder(
 struct whisper_context_params whisper_context_default_params() {
     struct whisper_context_params result = {
         /*.use_gpu              =*/ true,
-        /*.flash_attn           =*/ false,
+        /*.flash_attn           =*/ true,
         /*.gpu_device           =*/ 0,
 
         /*.dtw_token_timestamps =*/ false,
@@ -3633,6 +4067,16 @@ struct whisper_context_params whisper_context_default_params() {
             /*.heads            =*/ NULL,
         },
         /*.dtw_mem_size         =*/ 1024*1024*128,
+
+        /*.cpu_poll             =*/ 50,
+        /*.cpu_prio             =*/ GGML_SCHED_PRIO_NORMAL,
+        /*.cpu_strict           =*/ false,
+        /*.cpu_mask             =*/ 0,
+
+        /*.type_k               =*/ GGML_TYPE_F16,
+        /*.type_v               =*/ GGML_TYPE_F16,
+
+        /*.cpu_repack           =*/ false,
     };
     return result;
 }
@@ -3672,6 +4116,18 @@ struct whisper_context * whisper_init_from_file_with_params_no_state(const char
         fin->close();
     };
 
+    loader.tell = [](void * ctx) {
+        std::ifstream * fin = (std::ifstream*)ctx;
+        return (size_t) fin->tellg();
+    };
+
+    loader.seek = [](void * ctx, size_t offset) {
+        std::ifstream * fin = (std::ifstream*)ctx;
+        fin->clear();
+        fin->seekg((std::streamoff) offset);
+        return !fin->fail();
+    };
+
     auto ctx = whisper_init_with_params_no_state(&loader, params);
 
     if (ctx) {
@@ -3715,21 +4171,40 @@ struct whisper_context * whisper_init_from_buffer_with_params_no_state(void * bu
 
     loader.close = [](void * /*ctx*/) { };
 
+    loader.tell = [](void * ctx) {
+        buf_context * buf = reinterpret_cast<buf_context *>(ctx);
+
+        return buf->current_offset;
+    };
+
+    loader.seek = [](void * ctx, size_t offset) {
+        buf_context * buf = reinterpret_cast<buf_context *>(ctx);
+
+        if (offset > buf->size) {
+            return false;
+        }
+        buf->current_offset = offset;
+        return true;
+    };
+
     return whisper_init_with_params_no_state(&loader, params);
 }
 
 struct whisper_context * whisper_init_with_params_no_state(struct whisper_model_loader * loader, struct whisper_context_params params) {
     ggml_time_init();
 
-    if (params.flash_attn && params.dtw_token_timestamps) {
-        WHISPER_LOG_WARN("%s: dtw_token_timestamps is not supported with flash_attn - disabling\n", __func__);
-        params.dtw_token_timestamps = false;
+    // the non-flash decoder keeps V transposed, one element of a token per row, which can't be split into quantization blocks
+    if (ggml_is_quantized(params.type_v) && !params.flash_attn) {
+        WHISPER_LOG_WARN("%s: quantized type_v requires flash_attn - using f16\n", __func__);
+        params.type_v = GGML_TYPE_F16;
     }
 
     WHISPER_LOG_INFO("%s: use gpu    = %d\n", __func__, params.use_gpu);
     WHISPER_LOG_INFO("%s: flash attn = %d\n", __func__, params.flash_attn);
     WHISPER_LOG_INFO("%s: gpu_device = %d\n", __func__, params.gpu_device);
     WHISPER_LOG_INFO("%s: dtw        = %d\n", __func__, params.dtw_token_timestamps);
+    WHISPER_LOG_INFO("%s: kv types   = %s, %s\n", __func__, ggml_type_name(params.type_k), ggml_type_name(params.type_v));
+    WHISPER_LOG_INFO("%s: cpu repack = %d\n", __func__, params.cpu_repack);
     WHISPER_LOG_INFO("%s: devices    = %zu\n", __func__, ggml_backend_dev_count());
     WHISPER_LOG_INFO("%s: backends   = %zu\n", __func__, ggml_backend_reg_count());
 
@@ -3848,6 +4323,8 @@ void whisper_free_state(struct whisper_state * state) {
             ggml_backend_free(backend);
         }
 
+        whisper_threadpool_free(state->threadpool);
+
         // [EXPERIMENTAL] Token-level timestamps with DTW
         aheads_masks_free(state->aheads_masks);
 
@@ -3931,6 +4408,8 @@ int whisper_set_mel(
 }
 
 int whisper_encode_with_state(struct whisper_context * ctx, struct whisper_state * state, int offset, int n_threads) {
+    whisper_cross_slots_reset(*state);
+
     if (!whisper_encode_internal(*ctx, *state, offset, n_threads, nullptr, nullptr)) {
         WHISPER_LOG_ERROR("%s: failed to eval\n", __func__);
         return -1;
@@ -3940,6 +4419,8 @@ int whisper_encode_with_state(struct whisper_context * ctx, struct whisper_state
 }
 
 int whisper_encode(struct whisper_context * ctx, int offset, int n_threads) {
+    whisper_cross_slots_reset(*ctx->state);
+
     if (!whisper_encode_internal(*ctx, *ctx->state, offset, n_threads, nullptr, nullptr)) {
         WHISPER_LOG_ERROR("%s: failed to eval\n", __func__);
         return -1;
@@ -3970,6 +4451,127 @@ int whisper_decode(struct whisper_context * ctx, const whisper_token * tokens, i
     return whisper_decode_with_state(ctx, ctx->state, tokens, n_tokens, n_past, n_threads);
 }
 
+int whisper_state_init_seqs(struct whisper_context * ctx, struct whisper_state * state, int n_seq) {
+    if (n_seq < 1 || n_seq > WHISPER_MAX_DECODERS) {
+        WHISPER_LOG_ERROR("%s: n_seq = %d, must be in [1, %d]\n", __func__, n_seq, WHISPER_MAX_DECODERS);
+        return -1;
+    }
+
+    const auto & hparams = ctx->model.hparams;
+
+    whisper_kv_cache_free(state->kv_cross);
+    whisper_kv_cache_free(state->kv_self);
+
+    // the cached decoder graph has views of the old caches
+    state->decoder_graph.gf = nullptr;
+
+    state->n_seq = n_seq;
+    whisper_cross_slots_reset(*state);
+    state->seq_logits.clear();
+
+    if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->itype, ctx->itype,
+                hparams.n_text_state,
+                hparams.n_text_layer,
+                GGML_PAD(hparams.n_audio_ctx, 256)*n_seq)) {
+        WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for cross-attention cache\n", __func__);
+        return -2;
+    }
+
+    // same overallocation as whisper_full() uses for the beam search
+    const int factor = n_seq > 1 ? n_seq + 2 : 1;
+
+    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->params.type_k, ctx->params.type_v,
+                hparams.n_text_state,
+                hparams.n_text_layer,
+                GGML_PAD(hparams.n_text_ctx, 256)*factor)) {
+        WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
+        return -3;
+    }
+
+    state->kv_self_n_dec = n_seq;
+
+    {
+        const size_t memory_size = ggml_nbytes(state->kv_cross.k) + ggml_nbytes(state->kv_cross.v);
+        WHISPER_LOG_INFO("%s: n_seq = %d, kv cross size = %7.2f MB\n", __func__, n_seq, memory_size / 1e6);
+    }
+
+    return 0;
+}
+
+int whisper_encode_seq(struct whisper_context * ctx, struct whisper_state * state, int offset, int n_threads, int seq_id) {
+    if (seq_id < 0 || seq_id >= state->n_seq) {
+        WHISPER_LOG_ERROR("%s: seq_id = %d, the state has %d sequences\n", __func__, seq_id, state->n_seq);
+        return -1;
+    }
+
+    state->cross_slot_enc = seq_id;
+
+    const bool ok = whisper_encode_internal(*ctx, *state, offset, n_threads, nullptr, nullptr);
+
+    state->cross_slot_enc = 0;
+
+    if (!ok) {
+        WHISPER_LOG_ERROR("%s: failed to eval\n", __func__);
+        return -1;
+    }
+
+    state->cross_slot[seq_id] = seq_id;
+
+    // new audio, the text decoded so far is no longer relevant
+    whisper_kv_cache_seq_rm(state->kv_self, seq_id, -1, -1);
+
+    return 0;
+}
+
+int whisper_decode_seqs(struct whisper_context * ctx, struct whisper_state * state, const struct whisper_seq_batch * seqs, int n_seqs, int n_threads) {
+    auto & batch = state->batch;
+
+    int n_tokens = 0;
+    for (int i = 0; i < n_seqs; ++i) {
+        if (seqs[i].seq_id < 0 || seqs[i].seq_id >= state->n_seq || seqs[i].n_tokens < 1 || seqs[i].n_past < 0 ||
+            seqs[i].n_past + seqs[i].n_tokens > ctx->model.hparams.n_text_ctx) {
+            WHISPER_LOG_ERROR("%s: invalid sequence #%d: seq_id = %d, n_tokens = %d, n_past = %d\n",
+                    __func__, i, seqs[i].seq_id, seqs[i].n_tokens, seqs[i].n_past);
+            return -1;
+        }
+        n_tokens += seqs[i].n_tokens;
+    }
+
+    if (n_tokens < 1 || n_tokens > ctx->model.hparams.n_text_ctx) {
+        WHISPER_LOG_ERROR("%s: n_tokens = %d, must be in [1, %d]\n", __func__, n_tokens, ctx->model.hparams.n_text_ctx);
+        return -1;
+    }
+
+    // tokens of every sequence are contiguous, so the decoder runs one cross-attention per sequence
+    state->seq_logits.resize(n_seqs);
+
+    batch.n_tokens = 0;
+    for (int i = 0; i < n_seqs; ++i) {
+        const auto & seq = seqs[i];
+
+        whisper_kv_cache_seq_rm(state->kv_self, seq.seq_id, seq.n_past, -1);
+
+        for (int j = 0; j < seq.n_tokens; ++j) {
+            const int k = batch.n_tokens++;
+
+            batch.token   [k]    = seq.tokens[j];
+            batch.pos     [k]    = seq.n_past + j;
+            batch.n_seq_id[k]    = 1;
+            batch.seq_id  [k][0] = seq.seq_id;
+            batch.logits  [k]    = j == seq.n_tokens - 1;
+        }
+
+        state->seq_logits[i] = (size_t) (batch.n_tokens - 1)*ctx->model.hparams.n_vocab;
+    }
+
+    if (!whisper_decode_internal(*ctx, *state, batch, n_threads, false, nullptr, nullptr)) {
+        WHISPER_LOG_ERROR("%s: failed to eval\n", __func__);
+        return 1;
+    }
+
+    return 0;
+}
+
 int whisper_tokenize(struct whisper_context * ctx, const char * text, whisper_token * tokens, int n_max_tokens) {
     const auto res = tokenize(ctx->vocab, text);
 
@@ -4214,6 +4816,14 @@ float * whisper_get_logits_from_state(struct whisper_state * state) {
     return state->logits.data();
 }
 
+float * whisper_get_logits_seq_from_state(struct whisper_state * state, int i) {
+    if (i < 0 || i >= (int) state->seq_logits.size()) {
+        return nullptr;
+    }
+
+    return state->logits.data() + state->seq_logits[i];
+}
+
 struct ggml_tensor * whisper_get_tensor_by_name(struct whisper_context * ctx, const char * name) {
     if (!ctx) {
         return nullptr;
@@ -4441,6 +5051,7 @@ struct whisper_vad_context {
     int     n_threads;
 
     std::vector<ggml_backend_t> backends;
+    whisper_threadpool          threadpool;
     ggml_backend_buffer_t       buffer = nullptr;
     whisper_context_params      params;
     std::vector<uint8_t>        ctx_buf;
@@ -4692,6 +5303,9 @@ static bool whisper_vad_init_context(whisper_vad_context * vctx) {
         return false;
     }
 
+    whisper_threadpool_init(vctx->threadpool, whisper_context_params);
+    whisper_threadpool_bind(vctx->threadpool, vctx->backends, vctx->n_threads);
+
     const int32_t lstm_hidden_size = vctx->model.hparams.lstm_hidden_size;
 
     vctx->ctx_buf.resize(2u*ggml_tensor_overhead());
@@ -5475,6 +6089,7 @@ void whisper_vad_free(whisper_vad_context * ctx) {
             ggml_backend_free(backend);
         }
 
+        whisper_threadpool_free(ctx->threadpool);
 
         delete ctx;
     }
@@ -7015,6 +7630,8 @@ int whisper_full_with_state(
         }
 
         // encode audio features starting at offset seek
+        whisper_cross_slots_reset(*state);
+
         if (!whisper_encode_internal(*ctx, *state, seek, params.n_threads, params.abort_callback, params.abort_callback_user_data)) {
             WHISPER_LOG_ERROR("%s: failed to encode\n", __func__);
             return -6;
@@ -7108,10 +7725,13 @@ int whisper_full_with_state(
 
                     whisper_kv_cache_free(state->kv_self);
 
+                    // the cached decoder graph has views of the old cache
+                    state->decoder_graph.gf = nullptr;
+
                     // overallocate to workaround KV cache fragmentation issues
                     const int factor = n_decoders_cur > 1 ? n_decoders_cur + 2 : 1;
 
-                    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
+                    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->params.type_k, ctx->params.type_v,
                                 ctx->model.hparams.n_text_state,
                                 ctx->model.hparams.n_text_layer,
                                 GGML_PAD(ctx->model.hparams.n_text_ctx, 256)*factor)) {
@@ -8227,6 +8847,12 @@ WHISPER_API const char * whisper_bench_ggml_mul_mat_str(int n_threads) {
     // put a bunch of random data in the buffer
     for (size_t i = 0; i < buf.size(); i++) buf[i] = i;
 
+    // one CPU backend and threadpool for all runs, so that the thread startup is not measured
+    ggml_backend_ptr backend { ggml_backend_init_by_type(GGML_BACKEND_DEVICE_TYPE_CPU, nullptr) };
+
+    whisper_threadpool threadpool;
+    whisper_threadpool_bind(threadpool, { backend.get() }, n_threads);
+
     for (int j = 0; j < (int) sizes.size(); j++) {
         int n_q4_0 = 0;
         int n_q4_1 = 0;
@@ -8279,12 +8905,12 @@ WHISPER_API const char * whisper_bench_ggml_mul_mat_str(int n_threads) {
             double tsum = 0.0;
 
             // heat-up
-            ggml_graph_compute_helper(gf, n_threads, nullptr, nullptr);
+            ggml_graph_compute_helper(backend.get(), gf, n_threads, nullptr, nullptr);
 
             for (int i = 0; i < n_max; ++i) {
                 const int64_t t0 = ggml_time_us();
 
-                ggml_graph_compute_helper(gf, n_threads, nullptr, nullptr);
+                ggml_graph_compute_helper(backend.get(), gf, n_threads, nullptr, nullptr);
 
                 const int64_t t1 = ggml_time_us();
 
@@ -8317,6 +8943,9 @@ WHISPER_API const char * whisper_bench_ggml_mul_mat_str(int n_threads) {
         s += strbuf;
     }
 
+    backend.reset();
+    whisper_threadpool_free(threadpool);
+
     return s.c_str();
 }
 
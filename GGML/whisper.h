@@ -115,7 +115,7 @@ extern "C" {
 
     struct whisper_context_params {
         bool  use_gpu;
-        bool  flash_attn;
+        bool  flash_attn;  // default on; compatible with dtw_token_timestamps
         int   gpu_device;  // CUDA device
 
         // [EXPERIMENTAL] Token-level timestamps with DTW
@@ -126,6 +126,22 @@ extern "C" {
         struct whisper_aheads dtw_aheads;
 
         size_t dtw_mem_size; // TODO: remove
+
+        // persistent CPU threadpool, one per whisper_state
+        int      cpu_poll;   // polling level of the idle worker threads (0 - no polling, 100 - aggressive polling)
+        int      cpu_prio;   // enum ggml_sched_priority of the worker threads
+        bool     cpu_strict; // strict cpu placement, one core of the mask per thread
+        uint64_t cpu_mask;   // affinity mask of the worker threads, bit i = core i (0 - default affinity)
+
+        // data types of the self-attention KV cache of the decoder, GGML_TYPE_F16 by default
+        // GGML_TYPE_Q8_0 halves the memory and the bandwidth of the cache; quantized type_v requires flash_attn
+        enum ggml_type type_k;
+        enum ggml_type type_v;
+
+        // place the quantized weights which the CPU backend multiplies into the CPU_REPACK buffer type
+        // the weights are repacked into interleaved layouts while loading, which the faster GEMM kernels of ggml-cpu consume
+        // the loader prints which weights were repacked
+        bool cpu_repack;
     };
 
     typedef struct whisper_token_data {
@@ -156,6 +172,11 @@ extern "C" {
         size_t (*read)(void * ctx, void * output, size_t read_size);
         bool    (*eof)(void * ctx);
         void  (*close)(void * ctx);
+
+        // optional; when both are set, the loader reads the types of all tensors before allocating them,
+        // which is required for the models with per-tensor types written by Tools/quantize
+        size_t (*tell)(void * ctx);
+        bool   (*seek)(void * ctx, size_t offset);
     } whisper_model_loader;
 
     // grammar element type
@@ -337,6 +358,42 @@ extern "C" {
                                int   n_past,
                                int   n_threads);
 
+    // Multi-sequence decoding: up to 8 sequences, each with its own audio window, decoded in a single batch.
+    // whisper_state_init_seqs() reallocates the KV caches of the state for n_seq sequences, invalidating their contents.
+    // whisper_encode_seq() encodes the current mel spectrogram into the cross-attention slot of the sequence,
+    // and clears the decoded text of that sequence.
+    // The sequences share whisper_set_audio_ctx(), and the legacy whisper_encode() maps all of them back to one audio.
+    // Returns 0 on success; when whisper_state_init_seqs() fails, the state is no longer usable
+    WHISPER_API int whisper_state_init_seqs(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+                               int   n_seq);
+
+    WHISPER_API int whisper_encode_seq(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+                               int   offset,
+                               int   n_threads,
+                               int   seq_id);
+
+    // Tokens of one sequence for whisper_decode_seqs(); the cached positions at or after n_past are discarded
+    struct whisper_seq_batch {
+        int seq_id;
+        const whisper_token * tokens;
+        int n_tokens;
+        int n_past;
+    };
+
+    // Run the decoder on several sequences at once, the total count of tokens must not exceed n_text_ctx.
+    // Use whisper_get_logits_seq_from_state() to get the logits of the last token of each sequence.
+    // Returns 0 on success
+    WHISPER_API int whisper_decode_seqs(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+    const struct whisper_seq_batch * seqs,
+                               int   n_seqs,
+                               int   n_threads);
+
     // Convert the provided text into tokens.
     // The tokens pointer must be large enough to hold the resulting tokens.
     // Returns the number of tokens on success, no more than n_max_tokens
@@ -413,6 +470,9 @@ extern "C" {
     WHISPER_API float * whisper_get_logits           (struct whisper_context * ctx);
     WHISPER_API float * whisper_get_logits_from_state(struct whisper_state * state);
 
+    // Logits of the last token of seqs[i] from the last call to whisper_decode_seqs(), n_vocab elements
+    WHISPER_API float * whisper_get_logits_seq_from_state(struct whisper_state * state, int i);
+
     // Get tensor by name from the loaded model
     // Returns pointer to ggml_tensor if found, nullptr if not found or ctx is null
     // This function provides safe access to model tensors for validation and debugging purposes
@@ -0,0 +1,529 @@
+// Microbenchmark of the GGML CPU operators used by Whisper, at the shapes of the tiny to large models.
+// Only depends on GGML and the C++ standard library, the results are printed as JSON.
+// Run it before and after updating the vendored GGML, and compare the numbers to catch kernel regressions.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+#include "ggml-cpu.h"
+
+namespace {
+
+struct ModelShape {
+    const char* name;
+    int n_state;
+    int n_head;
+    int n_mels;
+};
+
+// Encoder and decoder of Whisper have the same width; large-v3 has 128 mel bins
+const ModelShape modelShapes[] = {
+    { "tiny",   384,  6,  80 },
+    { "base",   512,  8,  80 },
+    { "small",  768,  12, 80 },
+    { "medium", 1024, 16, 80 },
+    { "large",  1280, 20, 128 },
+};
+
+constexpr int n_audio_ctx = 1500;
+// whisper.cpp pads the cross-attention KV cache to a multiple of 256
+constexpr int n_audio_ctx_pad = 1536;
+// 30 seconds of the mel spectrogram
+constexpr int n_mel_frames = 3000;
+
+const char* const allOps[] = { "mul_mat", "flash_attn_ext", "conv_1d", "norm", "soft_max" };
+
+struct Options {
+    std::vector<const ModelShape*> models;
+    std::vector<ggml_type> types;
+    std::vector<std::string> ops;
+    std::vector<int> rows = { 1, 4, 8, 1500 };
+    std::vector<int> threads;
+    double minTime = 0.1;
+    int minReps = 3;
+    const char* output = nullptr;
+};
+
+// A graph of a single operator with random inputs, and the amount of work for the metrics
+struct Case {
+    std::string op;
+    std::string model;
+    std::string shape;
+    std::string type;
+    int rows = 0;
+    // Floating-point operations per evaluation, 0 when not meaningful for the operator
+    double flops = 0;
+    // Bytes of the inputs and the output
+    double bytes = 0;
+
+    ggml_context* ctx = nullptr;
+    ggml_cgraph* graph = nullptr;
+    ggml_backend_buffer_t buffer = nullptr;
+};
+
+struct Timing {
+    int threads;
+    // Median time of a single evaluation, microseconds
+    double us;
+};
+
+void printUsage() {
+    fprintf(stderr, R"(Usage: OperatorBenchmark [options]
+
+Measures mul_mat, flash_attn_ext, conv_1d, norm and soft_max of GGML at Whisper shapes, prints JSON.
+
+Options:
+  -m, --models <list>   Comma-separated models, default tiny,base,small,medium,large
+  -t, --types <list>    Weight types of mul_mat, default every type GGML can quantize without imatrix;
+                        flash_attn_ext uses f16 and q8_0 from that list for the K/V
+  -p, --ops <list>      Operators, default mul_mat,flash_attn_ext,conv_1d,norm,soft_max
+  -n, --rows <list>     Token counts, default 1,4,8,1500
+  -j, --threads <list>  Thread counts, default 1,2,4,... up to the hardware threads
+  -s, --min-time <sec>  Minimum measured time of every case and thread count, default 0.1
+  -o, --output <path>   Write JSON into the file instead of stdout
+)");
+}
+
+std::vector<std::string> splitList(const char* arg) {
+    std::vector<std::string> res;
+    std::string cur;
+    for (const char* p = arg; ; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!cur.empty())
+                res.push_back(cur);
+            cur.clear();
+            if (*p == '\0')
+                break;
+        } else {
+            cur += *p;
+        }
+    }
+    return res;
+}
+
+// Weight types the benchmark can create: floats, and the quantized types which have CPU dot products and don't need an importance matrix
+bool isBenchmarkType(ggml_type t) {
+    const ggml_type_traits* traits = ggml_get_type_traits(t);
+    if (traits->blck_size == 0 || traits->type_name == nullptr)
+        return false;
+    if (t == GGML_TYPE_F32 || t == GGML_TYPE_F16 || t == GGML_TYPE_BF16)
+        return true;
+    if (!traits->is_quantized || ggml_quantize_requires_imatrix(t))
+        return false;
+    return ggml_get_type_traits_cpu(t)->vec_dot != nullptr;
+}
+
+ggml_type parseType(const std::string& name) {
+    for (int i = 0; i < GGML_TYPE_COUNT; i++) {
+        const ggml_type t = (ggml_type)i;
+        if (isBenchmarkType(t) && name == ggml_type_name(t))
+            return t;
+    }
+    return GGML_TYPE_COUNT;
+}
+
+bool parseIntList(const char* arg, std::vector<int>& rdi) {
+    rdi.clear();
+    for (const std::string& s : splitList(arg)) {
+        const int i = atoi(s.c_str());
+        if (i <= 0)
+            return false;
+        rdi.push_back(i);
+    }
+    return !rdi.empty();
+}
+
+bool parseArguments(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+
+        if (arg == "-m" || arg == "--models") {
+            for (const std::string& s : splitList(value)) {
+                auto it = std::find_if(std::begin(modelShapes), std::end(modelShapes), [&](const ModelShape& m) { return s == m.name; });
+                if (it == std::end(modelShapes))
+                    return false;
+                opts.models.push_back(&*it);
+            }
+        } else if (arg == "-t" || arg == "--types") {
+            for (const std::string& s : splitList(value)) {
+                const ggml_type t = parseType(s);
+                if (t == GGML_TYPE_COUNT)
+                    return false;
+                opts.types.push_back(t);
+            }
+        } else if (arg == "-p" || arg == "--ops") {
+            for (const std::string& s : splitList(value)) {
+                if (std::find(std::begin(allOps), std::end(allOps), s) == std::end(allOps))
+                    return false;
+                opts.ops.push_back(s);
+            }
+        } else if (arg == "-n" || arg == "--rows") {
+            if (!parseIntList(value, opts.rows))
+                return false;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!parseIntList(value, opts.threads))
+                return false;
+        } else if (arg == "-s" || arg == "--min-time") {
+            opts.minTime = atof(value);
+            if (!(opts.minTime >= 0))
+                return false;
+        } else if (arg == "-o" || arg == "--output") {
+            opts.output = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (opts.models.empty()) {
+        for (const ModelShape& m : modelShapes)
+            opts.models.push_back(&m);
+    }
+    if (opts.types.empty()) {
+        for (int i = 0; i < GGML_TYPE_COUNT; i++) {
+            if (isBenchmarkType((ggml_type)i))
+                opts.types.push_back((ggml_type)i);
+        }
+    }
+    if (opts.ops.empty())
+        opts.ops.assign(std::begin(allOps), std::end(allOps));
+    if (opts.threads.empty()) {
+        const int hw = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int n = 1; n < hw; n *= 2)
+            opts.threads.push_back(n);
+        opts.threads.push_back(hw);
+    }
+    return true;
+}
+
+bool hasOp(const Options& opts, const char* op) {
+    return std::find(opts.ops.begin(), opts.ops.end(), op) != opts.ops.end();
+}
+
+// Fill the tensor with random numbers in [ -1, 1 ], quantizing them when needed
+void fillRandom(ggml_tensor* t, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> values((size_t)ggml_nelements(t));
+    for (float& f : values)
+        f = dist(rng);
+
+    if (t->type == GGML_TYPE_F32)
+        memcpy(t->data, values.data(), values.size() * sizeof(float));
+    else
+        ggml_quantize_chunk(t->type, values.data(), t->data, 0, ggml_nrows(t), t->ne[0], nullptr);
+}
+
+// Create the context for the inputs of a case; the graph is built by the caller
+Case createCase(const char* op, const ModelShape& model, const char* shape, ggml_type type, int rows) {
+    Case c;
+    c.op = op;
+    c.model = model.name;
+    c.shape = shape;
+    c.type = ggml_type_name(type);
+    c.rows = rows;
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead() * 16 + ggml_graph_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+    c.ctx = ggml_init(params);
+    return c;
+}
+
+// Allocate all tensors of the case, fill the inputs, and build the graph of the result
+bool finishCase(Case& c, ggml_tensor* result, std::mt19937& rng) {
+    c.graph = ggml_new_graph(c.ctx);
+    ggml_build_forward_expand(c.graph, result);
+
+    c.buffer = ggml_backend_alloc_ctx_tensors_from_buft(c.ctx, ggml_backend_cpu_buffer_type());
+    if (c.buffer == nullptr)
+        return false;
+
+    for (ggml_tensor* t = ggml_get_first_tensor(c.ctx); t != nullptr; t = ggml_get_next_tensor(c.ctx, t)) {
+        if (t->op == GGML_OP_NONE) {
+            fillRandom(t, rng);
+            c.bytes += (double)ggml_nbytes(t);
+        }
+    }
+    c.bytes += (double)ggml_nbytes(result);
+    return true;
+}
+
+void freeCase(Case& c) {
+    if (c.buffer != nullptr)
+        ggml_backend_buffer_free(c.buffer);
+    if (c.ctx != nullptr)
+        ggml_free(c.ctx);
+    c.buffer = nullptr;
+    c.ctx = nullptr;
+}
+
+// Median time of the graph, running it for at least minTime seconds and minReps times
+// The pools are created paused, so the idle pools don't spin on the cores while another one is measured
+class ResumedPool {
+    ggml_threadpool* threadpool;
+
+public:
+    ResumedPool(ggml_threadpool* tp) : threadpool(tp) { ggml_threadpool_resume(threadpool); }
+    ~ResumedPool() { ggml_threadpool_pause(threadpool); }
+    ResumedPool(const ResumedPool&) = delete;
+    ResumedPool& operator=(const ResumedPool&) = delete;
+};
+
+double measure(Case& c, int n_threads, ggml_threadpool* threadpool, const Options& opts) {
+    // Without the persistent pool, GGML would create threads on every call, and measure that instead
+    if (threadpool == nullptr)
+        return -1;
+    ResumedPool resumed(threadpool);
+    ggml_cplan plan = ggml_graph_plan(c.graph, n_threads, threadpool);
+    std::vector<uint8_t> work(plan.work_size);
+    plan.work_data = work.data();
+
+    // Warm up the caches and the threads
+    if (ggml_graph_compute(c.graph, &plan) != GGML_STATUS_SUCCESS)
+        return -1;
+
+    using clock = std::chrono::steady_clock;
+    std::vector<double> times;
+    const clock::time_point begin = clock::now();
+    while (true) {
+        const clock::time_point t0 = clock::now();
+        const ggml_status status = ggml_graph_compute(c.graph, &plan);
+        const clock::time_point t1 = clock::now();
+        if (status != GGML_STATUS_SUCCESS)
+            return -1;
+        times.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+        const double elapsed = std::chrono::duration<double>(t1 - begin).count();
+        if ((int)times.size() >= opts.minReps && elapsed >= opts.minTime)
+            break;
+    }
+
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+class JsonWriter {
+    FILE* file;
+    bool firstResult = true;
+
+public:
+    JsonWriter(FILE* f) : file(f) {}
+
+    void header(const Options& opts) {
+        fprintf(file, "{\n  \"cpu\": {");
+        const std::pair<const char*, int> features[] = {
+            { "avx", ggml_cpu_has_avx() },
+            { "avx2", ggml_cpu_has_avx2() },
+            { "fma", ggml_cpu_has_fma() },
+            { "f16c", ggml_cpu_has_f16c() },
+            { "avx512", ggml_cpu_has_avx512() },
+            { "avx_vnni", ggml_cpu_has_avx_vnni() },
+            { "neon", ggml_cpu_has_neon() },
+            { "dotprod", ggml_cpu_has_dotprod() },
+        };
+        bool first = true;
+        for (const auto& f : features) {
+            fprintf(file, "%s\"%s\": %d", first ? " " : ", ", f.first, f.second);
+            first = false;
+        }
+        fprintf(file, ", \"hardware_threads\": %u },\n", std::thread::hardware_concurrency());
+        fprintf(file, "  \"min_time_s\": %g,\n  \"results\": [", opts.minTime);
+    }
+
+    void result(const Case& c, const std::vector<Timing>& timings) {
+        fprintf(file, "%s\n    { \"op\": \"%s\", \"model\": \"%s\", \"shape\": \"%s\", \"type\": \"%s\", \"rows\": %d, \"flops\": %.0f, \"bytes\": %.0f, \"threads\": [",
+            firstResult ? "" : ",", c.op.c_str(), c.model.c_str(), c.shape.c_str(), c.type.c_str(), c.rows, c.flops, c.bytes);
+        firstResult = false;
+
+        const double us1 = timings.empty() ? 0 : timings[0].us;
+        for (size_t i = 0; i < timings.size(); i++) {
+            const Timing& t = timings[i];
+            fprintf(file, "%s\n      { \"n\": %d, \"us\": %.3f, ", i == 0 ? "" : ",", t.threads, t.us);
+            if (c.flops > 0)
+                fprintf(file, "\"gflops\": %.3f, ", c.flops / (t.us * 1e3));
+            else
+                fprintf(file, "\"gflops\": null, ");
+            fprintf(file, "\"gbps\": %.3f, \"speedup\": %.3f }", c.bytes / (t.us * 1e3), us1 / t.us);
+        }
+        fprintf(file, " ] }");
+        fflush(file);
+    }
+
+    void footer() {
+        fprintf(file, "\n  ]\n}\n");
+    }
+};
+
+// Build all cases of the selected operators for one model, and pass every case to the callback
+void forEachCase(const Options& opts, const ModelShape& m, std::mt19937& rng, const std::function<void(Case&)>& callback) {
+    const int n_state = m.n_state;
+    const int n_head = m.n_head;
+    const int n_state_head = n_state / n_head;
+
+    auto run = [&](Case& c, ggml_tensor* result) {
+        if (finishCase(c, result, rng))
+            callback(c);
+        else
+            fprintf(stderr, "Failed to allocate %s %s %s\n", c.op.c_str(), c.model.c_str(), c.shape.c_str());
+        freeCase(c);
+    };
+
+    // Attention projections, and both layers of the MLP
+    if (hasOp(opts, "mul_mat")) {
+        struct MatShape {
+            const char* name;
+            int k, m;
+        };
+        const MatShape matShapes[] = {
+            { "attn", n_state, n_state },
+            { "mlp_up", n_state, 4 * n_state },
+            { "mlp_down", 4 * n_state, n_state },
+        };
+        for (ggml_type type : opts.types) {
+            for (const MatShape& s : matShapes) {
+                if (0 != s.k % ggml_blck_size(type))
+                    continue;
+                for (int rows : opts.rows) {
+                    Case c = createCase("mul_mat", m, s.name, type, rows);
+                    ggml_tensor* w = ggml_new_tensor_2d(c.ctx, type, s.k, s.m);
+                    ggml_tensor* x = ggml_new_tensor_2d(c.ctx, GGML_TYPE_F32, s.k, rows);
+                    c.flops = 2.0 * s.k * s.m * rows;
+                    run(c, ggml_mul_mat(c.ctx, w, x));
+                }
+            }
+        }
+    }
+
+    // Encoder self-attention with 1500 rows, decoder cross-attention with fewer rows
+    if (hasOp(opts, "flash_attn_ext")) {
+        for (ggml_type type : opts.types) {
+            if (type != GGML_TYPE_F16 && type != GGML_TYPE_Q8_0)
+                continue;
+            for (int rows : opts.rows) {
+                Case c = createCase("flash_attn_ext", m, rows >= n_audio_ctx ? "encoder" : "cross", type, rows);
+                ggml_tensor* q = ggml_new_tensor_3d(c.ctx, GGML_TYPE_F32, n_state_head, rows, n_head);
+                ggml_tensor* k = ggml_new_tensor_3d(c.ctx, type, n_state_head, n_audio_ctx_pad, n_head);
+                ggml_tensor* v = ggml_new_tensor_3d(c.ctx, type, n_state_head, n_audio_ctx_pad, n_head);
+                c.flops = 4.0 * n_state_head * n_audio_ctx_pad * rows * n_head;
+                run(c, ggml_flash_attn_ext(c.ctx, q, k, v, nullptr, 1.0f / sqrtf((float)n_state_head), 0.0f, 0.0f));
+            }
+        }
+    }
+
+    // The two convolutions of the encoder input; FP16 kernels, like the models
+    if (hasOp(opts, "conv_1d")) {
+        struct ConvShape {
+            const char* name;
+            int channelsIn, stride;
+        };
+        const ConvShape convShapes[] = {
+            { "conv1", m.n_mels, 1 },
+            { "conv2", n_state, 2 },
+        };
+        for (const ConvShape& s : convShapes) {
+            Case c = createCase("conv_1d", m, s.name, GGML_TYPE_F16, n_mel_frames / s.stride);
+            ggml_tensor* kernel = ggml_new_tensor_3d(c.ctx, GGML_TYPE_F16, 3, s.channelsIn, n_state);
+            ggml_tensor* x = ggml_new_tensor_2d(c.ctx, GGML_TYPE_F32, n_mel_frames, s.channelsIn);
+            c.flops = 2.0 * 3 * s.channelsIn * n_state * c.rows;
+            run(c, ggml_conv_1d_ph(c.ctx, kernel, x, s.stride, 1));
+        }
+    }
+
+    if (hasOp(opts, "norm")) {
+        for (int rows : opts.rows) {
+            Case c = createCase("norm", m, "layer", GGML_TYPE_F32, rows);
+            ggml_tensor* x = ggml_new_tensor_2d(c.ctx, GGML_TYPE_F32, n_state, rows);
+            run(c, ggml_norm(c.ctx, x, 1e-5f));
+        }
+    }
+
+    // Attention scores of the non-flash path
+    if (hasOp(opts, "soft_max")) {
+        for (int rows : opts.rows) {
+            Case c = createCase("soft_max", m, rows >= n_audio_ctx ? "encoder" : "cross", GGML_TYPE_F32, rows);
+            ggml_tensor* x = ggml_new_tensor_3d(c.ctx, GGML_TYPE_F32, n_audio_ctx, rows, n_head);
+            run(c, ggml_soft_max_ext(c.ctx, x, nullptr, 1.0f / sqrtf((float)n_state_head), 0.0f));
+        }
+    }
+}
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseArguments(argc, argv, opts)) {
+        printUsage();
+        return 1;
+    }
+
+    FILE* file = stdout;
+    if (opts.output != nullptr) {
+        file = fopen(opts.output, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Unable to create %s\n", opts.output);
+            return 1;
+        }
+    }
+
+    ggml_cpu_init();
+
+    // One persistent pool per thread count, creating threads in the measured loop would dominate the small cases
+    std::vector<ggml_threadpool*> pools;
+    for (int n : opts.threads) {
+        ggml_threadpool_params tpp = ggml_threadpool_params_default(n);
+        tpp.paused = true;
+        ggml_threadpool* tp = ggml_threadpool_new(&tpp);
+        if (tp == nullptr)
+            fprintf(stderr, "Unable to create a thread pool with %d threads\n", n);
+        pools.push_back(tp);
+    }
+
+    JsonWriter json(file);
+    json.header(opts);
+
+    std::mt19937 rng(0);
+    int failed = 0;
+    for (const ModelShape* m : opts.models) {
+        forEachCase(opts, *m, rng, [&](Case& c) {
+            fprintf(stderr, "%s %s %s %s rows=%d\n", c.op.c_str(), c.model.c_str(), c.shape.c_str(), c.type.c_str(), c.rows);
+
+            std::vector<Timing> timings;
+            for (size_t i = 0; i < opts.threads.size(); i++) {
+                const double us = measure(c, opts.threads[i], pools[i], opts);
+                if (us < 0) {
+                    failed++;
+                    return;
+                }
+                timings.push_back(Timing{ opts.threads[i], us });
+            }
+            json.result(c, timings);
+        });
+    }
+    json.footer();
+
+    for (ggml_threadpool* tp : pools)
+        if (tp != nullptr)
+            ggml_threadpool_free(tp);
+    if (file != stdout)
+        fclose(file);
+
+    if (failed != 0) {
+        fprintf(stderr, "%d cases failed to compute\n", failed);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include "Quantizer.h"
+#include "../../ComLightLib/hresult.h"
+#include <whisper.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+namespace
+{
+	constexpr uint32_t ggmlMagic = 0x67676d6c;
+
+	// Same layout as sModelParams structure in the DLL
+	struct sModelHeader
+	{
+		int n_vocab, n_audio_ctx, n_audio_state, n_audio_head, n_audio_layer;
+		int n_text_ctx, n_text_state, n_text_head, n_text_layer;
+		int n_mels, ftype;
+	};
+
+	struct sTensorHeader
+	{
+		int n_dims, length, ftype;
+	};
+
+	// These tensors are added to activations without any matrix products, quantizing them costs too much precision for very little memory
+	const char* const neverQuantize[] =
+	{
+		"encoder.positional_embedding",
+		"decoder.positional_embedding",
+	};
+
+	class File
+	{
+		FILE* f = nullptr;
+
+	public:
+		File() = default;
+		File( const File& ) = delete;
+		~File()
+		{
+			if( nullptr != f )
+				fclose( f );
+		}
+
+		HRESULT open( const wchar_t* path, const wchar_t* mode )
+		{
+			if( 0 != _wfopen_s( &f, path, mode ) )
+			{
+				fwprintf( stderr, L"Unable to open the file \"%s\"\n", path );
+				return CO_E_FAILEDTOOPENFILE;
+			}
+			return S_OK;
+		}
+
+		HRESULT read( void* rdi, size_t cb )
+		{
+			if( 0 == cb )
+				return S_OK;
+			return ( fread( rdi, 1, cb, f ) == cb ) ? S_OK : E_EOF;
+		}
+
+		template<class T>
+		HRESULT read( T& rdi )
+		{
+			return read( &rdi, sizeof( T ) );
+		}
+
+		// Returns S_FALSE at the end of file
+		template<class T>
+		HRESULT tryRead( T& rdi )
+		{
+			const size_t cb = fread( &rdi, 1, sizeof( T ), f );
+			if( cb == sizeof( T ) )
+				return S_OK;
+			return ( 0 == cb && feof( f ) ) ? S_FALSE : E_EOF;
+		}
+
+		HRESULT write( const void* rsi, size_t cb )
+		{
+			if( 0 == cb )
+				return S_OK;
+			return ( fwrite( rsi, 1, cb, f ) == cb ) ? S_OK : STG_E_WRITEFAULT;
+		}
+
+		template<class T>
+		HRESULT write( const T& rsi )
+		{
+			return write( &rsi, sizeof( T ) );
+		}
+
+		// Copy bytes from another file to this one
+		HRESULT copy( File& src, size_t cb, std::vector<uint8_t>& buffer )
+		{
+			buffer.resize( cb );
+			CHECK( src.read( buffer.data(), cb ) );
+			return write( buffer.data(), cb );
+		}
+
+		HRESULT seek( int64_t offset )
+		{
+			return ( 0 == _fseeki64( f, offset, SEEK_SET ) ) ? S_OK : E_FAIL;
+		}
+
+		HRESULT close()
+		{
+			if( nullptr == f )
+				return S_FALSE;
+			FILE* p = f;
+			f = nullptr;
+			return ( 0 == fclose( p ) ) ? S_OK : STG_E_WRITEFAULT;
+		}
+	};
+
+	inline size_t typeSize( ggml_type type, size_t elements )
+	{
+		return ggml_row_size( type, (int64_t)elements );
+	}
+
+	inline double bitsPerWeight( ggml_type type )
+	{
+		return 8.0 * (double)ggml_type_size( type ) / (double)ggml_blck_size( type );
+	}
+
+	struct sPolicy
+	{
+		float maxError;
+		ggml_type type;
+		bool keep;
+	};
+
+	sPolicy tensorPolicy( const sQuantizeParams& params, const std::string& name )
+	{
+		sPolicy res{ params.maxError, GGML_TYPE_COUNT, false };
+		for( const sQuantizeRule& r : params.rules )
+		{
+			if( std::string::npos == name.find( r.pattern ) )
+				continue;
+			if( r.maxError >= 0 )
+				res.maxError = r.maxError;
+			if( r.type != GGML_TYPE_COUNT )
+				res.type = r.type;
+			res.keep = r.keep;
+		}
+
+		// After the user's rules, none of them can override that list
+		for( const char* s : neverQuantize )
+			if( name == s )
+				res.keep = true;
+		return res;
+	}
+
+	// Quantizes a tensor on all threads, and measures the error of the reconstruction
+	class Evaluator
+	{
+		const int countThreads;
+
+	public:
+		Evaluator( int threads ) :
+			countThreads( threads > 0 ? threads : std::max( (int)std::thread::hardware_concurrency(), 1 ) ) { }
+
+		// Quantize the source into the output buffer, and return relative RMS error of the dequantized weights
+		double quantize( ggml_type type, const float* src, int64_t rows, int64_t n_per_row, std::vector<uint8_t>& rdi )
+		{
+			const size_t rowSize = ggml_row_size( type, n_per_row );
+			rdi.resize( rowSize * (size_t)rows );
+			const ggml_to_float_t toFloat = ggml_get_type_traits( type )->to_float;
+			// Rows per work item, about 64k elements
+			const int64_t rowsPerChunk = std::max( ( (int64_t)1 << 16 ) / n_per_row, (int64_t)1 );
+
+			std::atomic<int64_t> nextRow = 0;
+			std::vector<std::array<double, 2>> sums( (size_t)countThreads, std::array<double, 2>{ 0, 0 } );
+
+			auto proc = [ & ]( int idx )
+			{
+				std::vector<float> tmp( (size_t)n_per_row );
+				double err = 0, norm = 0;
+				while( true )
+				{
+					const int64_t r0 = nextRow.fetch_add( rowsPerChunk );
+					if( r0 >= rows )
+						break;
+					const int64_t nr = std::min( rowsPerChunk, rows - r0 );
+					ggml_quantize_chunk( type, src, rdi.data(), r0 * n_per_row, nr, n_per_row, nullptr );
+
+					for( int64_t r = r0; r < r0 + nr; r++ )
+					{
+						const float* x = src + r * n_per_row;
+						toFloat( rdi.data() + r * rowSize, tmp.data(), n_per_row );
+						for( int64_t i = 0; i < n_per_row; i++ )
+						{
+							const double diff = (double)x[ i ] - (double)tmp[ i ];
+							err += diff * diff;
+							norm += (double)x[ i ] * (double)x[ i ];
+						}
+					}
+				}
+				sums[ idx ] = { err, norm };
+			};
+
+			std::vector<std::thread> threads;
+			for( int i = 1; i < countThreads; i++ )
+				threads.emplace_back( proc, i );
+			proc( 0 );
+			for( auto& t : threads )
+				t.join();
+
+			double err = 0, norm = 0;
+			for( const auto& s : sums )
+			{
+				err += s[ 0 ];
+				norm += s[ 1 ];
+			}
+			return ( norm > 0 ) ? std::sqrt( err / norm ) : 0.0;
+		}
+	};
+
+	// ggml_ftype value for the header of the output file, from the most common type of the weights
+	int headerFileType( const std::array<uint64_t, GGML_TYPE_COUNT>& elementsByType )
+	{
+		const auto it = std::max_element( elementsByType.begin(), elementsByType.end() );
+		switch( (ggml_type)( it - elementsByType.begin() ) )
+		{
+		case GGML_TYPE_Q4_0:
+			return GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + GGML_FTYPE_MOSTLY_Q4_0;
+		case GGML_TYPE_Q5_1:
+			return GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + GGML_FTYPE_MOSTLY_Q5_1;
+		case GGML_TYPE_Q8_0:
+			return GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + GGML_FTYPE_MOSTLY_Q8_0;
+		case GGML_TYPE_F32:
+			return GGML_FTYPE_ALL_F32;
+		}
+		return GGML_FTYPE_MOSTLY_F16;
+	}
+
+	// Load the model with the CPU backend of whisper.cpp, it fails on tensors with unexpected types or sizes
+	HRESULT verifyModel( const wchar_t* path )
+	{
+		const int len = WideCharToMultiByte( CP_UTF8, 0, path, -1, nullptr, 0, nullptr, nullptr );
+		if( len <= 0 )
+			return HRESULT_FROM_WIN32( GetLastError() );
+		std::string utf8;
+		utf8.resize( (size_t)len );
+		WideCharToMultiByte( CP_UTF8, 0, path, -1, utf8.data(), len, nullptr, nullptr );
+
+		// The loader prints a lot of information, only keep the errors
+		whisper_log_set( []( ggml_log_level level, const char* text, void* )
+			{
+				if( level == GGML_LOG_LEVEL_ERROR )
+					fputs( text, stderr );
+			}, nullptr );
+
+		whisper_context_params cp = whisper_context_default_params();
+		cp.use_gpu = false;
+		whisper_context* const ctx = whisper_init_from_file_with_params_no_state( utf8.c_str(), cp );
+		whisper_log_set( nullptr, nullptr );
+		if( nullptr == ctx )
+		{
+			fprintf( stderr, "whisper.cpp failed to load the output model\n" );
+			return E_INVALIDARG;
+		}
+		whisper_free( ctx );
+		return S_OK;
+	}
+
+	HRESULT quantizeImpl( File& src, File& dst, const sQuantizeParams& params, sQuantizeStats& stats )
+	{
+		std::vector<uint8_t> buffer;
+
+		uint32_t magic;
+		CHECK( src.read( magic ) );
+		if( magic != ggmlMagic )
+		{
+			fprintf( stderr, "The source is not a GGML model file\n" );
+			return E_INVALIDARG;
+		}
+		CHECK( dst.write( magic ) );
+
+		sModelHeader header;
+		CHECK( src.read( header ) );
+		CHECK( dst.write( header ) );
+
+		// MEL filters
+		int melSize[ 2 ];
+		CHECK( src.read( melSize ) );
+		CHECK( dst.write( melSize ) );
+		CHECK( dst.copy( src, (size_t)melSize[ 0 ] * (size_t)melSize[ 1 ] * 4, buffer ) );
+
+		// Vocabulary
+		int countWords;
+		CHECK( src.read( countWords ) );
+		CHECK( dst.write( countWords ) );
+		for( int i = 0; i < countWords; i++ )
+		{
+			int len;
+			CHECK( src.read( len ) );
+			CHECK( dst.write( len ) );
+			CHECK( dst.copy( src, (size_t)len, buffer ) );
+		}
+
+		std::vector<ggml_type> candidates = params.candidates;
+		std::sort( candidates.begin(), candidates.end(), []( ggml_type a, ggml_type b ) { return bitsPerWeight( a ) < bitsPerWeight( b ); } );
+		for( ggml_type t : candidates )
+			ggml_quantize_init( t );
+
+		Evaluator evaluator{ params.threads };
+		std::array<uint64_t, GGML_TYPE_COUNT> elementsByType = {};
+		std::vector<float> f32;
+		std::vector<uint8_t> quantized, best;
+		const auto started = std::chrono::steady_clock::now();
+
+		while( true )
+		{
+			sTensorHeader th;
+			HRESULT hr = src.tryRead( th );
+			CHECK( hr );
+			if( S_FALSE == hr )
+				break;
+			if( th.n_dims < 1 || th.n_dims > 3 || th.length <= 0 || th.ftype < 0 || th.ftype >= GGML_TYPE_COUNT )
+				return E_INVALIDARG;
+
+			std::array<int, 3> ne = { 1, 1, 1 };
+			CHECK( src.read( ne.data(), (size_t)th.n_dims * 4 ) );
+			std::string name;
+			name.resize( (size_t)th.length );
+			CHECK( src.read( name.data(), name.size() ) );
+
+			const ggml_type srcType = (ggml_type)th.ftype;
+			const size_t elements = (size_t)ne[ 0 ] * (size_t)ne[ 1 ] * (size_t)ne[ 2 ];
+			const size_t srcBytes = typeSize( srcType, elements );
+			buffer.resize( srcBytes );
+			CHECK( src.read( buffer.data(), srcBytes ) );
+
+			stats.tensors++;
+			stats.bytesIn += srcBytes;
+
+			// Only the 2D weights of the matrix products are quantized, and only from the floating point types
+			const sPolicy policy = tensorPolicy( params, name );
+			ggml_type outType = srcType;
+			const std::vector<uint8_t>* payload = &buffer;
+			double error = 0;
+			const bool canQuantize = th.n_dims == 2 && !policy.keep &&
+				( srcType == GGML_TYPE_F16 || srcType == GGML_TYPE_F32 ) && 0 == ne[ 0 ] % 32;
+
+			if( canQuantize )
+			{
+				f32.resize( elements );
+				if( srcType == GGML_TYPE_F16 )
+					ggml_fp16_to_fp32_row( (const ggml_fp16_t*)buffer.data(), f32.data(), (int64_t)elements );
+				else
+					memcpy( f32.data(), buffer.data(), elements * 4 );
+
+				if( policy.type != GGML_TYPE_COUNT )
+				{
+					if( policy.type != srcType )
+					{
+						error = evaluator.quantize( policy.type, f32.data(), ne[ 1 ], ne[ 0 ], best );
+						outType = policy.type;
+						payload = &best;
+					}
+				}
+				else
+				{
+					for( ggml_type t : candidates )
+					{
+						// Candidates which ain't cheaper than the source would only lose precision
+						if( bitsPerWeight( t ) >= bitsPerWeight( srcType ) )
+							break;
+						const double e = evaluator.quantize( t, f32.data(), ne[ 1 ], ne[ 0 ], quantized );
+						if( params.verbose )
+							printf( "    %-48s %-5s error %.5f\n", name.c_str(), ggml_type_name( t ), e );
+						if( e <= policy.maxError )
+						{
+							std::swap( quantized, best );
+							outType = t;
+							payload = &best;
+							error = e;
+							break;
+						}
+					}
+				}
+			}
+
+			if( outType != srcType )
+				stats.quantized++;
+			stats.countByType[ outType ]++;
+			elementsByType[ outType ] += elements;
+
+			printf( "%-52s %5d x %5d  %-5s -> %-5s", name.c_str(), ne[ 0 ], ne[ 1 ] * ne[ 2 ], ggml_type_name( srcType ), ggml_type_name( outType ) );
+			if( outType != srcType )
+				printf( "  error %.5f\n", error );
+			else
+				printf( "\n" );
+
+			th.ftype = (int)outType;
+			CHECK( dst.write( th ) );
+			CHECK( dst.write( ne.data(), (size_t)th.n_dims * 4 ) );
+			CHECK( dst.write( name.data(), name.size() ) );
+			CHECK( dst.write( payload->data(), payload->size() ) );
+			stats.bytesOut += payload->size();
+		}
+		stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - started ).count();
+
+		// Patch the file type in the header, from the type with the most weights
+		header.ftype = headerFileType( elementsByType );
+		CHECK( dst.seek( sizeof( magic ) ) );
+		CHECK( dst.write( header ) );
+		return S_OK;
+	}
+}
+
+ggml_type parseQuantizeType( const char* name )
+{
+	const ggml_type supported[] = { GGML_TYPE_Q4_0, GGML_TYPE_Q5_1, GGML_TYPE_Q8_0, GGML_TYPE_F16 };
+	for( ggml_type t : supported )
+		if( 0 == _stricmp( name, ggml_type_name( t ) ) )
+			return t;
+	return GGML_TYPE_COUNT;
+}
+
+HRESULT quantizeModel( const wchar_t* source, const wchar_t* dest, const sQuantizeParams& params, sQuantizeStats& stats )
+{
+	stats = sQuantizeStats{};
+	for( ggml_type t : params.candidates )
+		if( ggml_get_type_traits( t )->to_float == nullptr )
+			return E_INVALIDARG;
+
+	File src, dst;
+	CHECK( src.open( source, L"rb" ) );
+	CHECK( dst.open( dest, L"wb" ) );
+
+	HRESULT hr = quantizeImpl( src, dst, params, stats );
+	const HRESULT hrClose = dst.close();
+	if( SUCCEEDED( hr ) )
+		hr = hrClose;
+	if( SUCCEEDED( hr ) && params.verify )
+		hr = verifyModel( dest );
+	if( FAILED( hr ) )
+		DeleteFileW( dest );
+	return hr;
+}
\ No newline at end of file
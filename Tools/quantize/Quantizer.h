@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <windows.h>
+#include <ggml.h>
+
+// A rule which applies to the tensors with names containing the pattern; when several rules match a tensor, the last one wins
+struct sQuantizeRule
+{
+	std::string pattern;
+	// Maximum relative RMS error of the reconstructed weights, negative = inherit
+	float maxError = -1;
+	// When not GGML_TYPE_COUNT, use that type without measuring anything
+	ggml_type type = GGML_TYPE_COUNT;
+	// Keep the tensor in the source precision
+	bool keep = false;
+};
+
+struct sQuantizeParams
+{
+	// Types to try, the quantizer sorts them by bits per weight and picks the first one which meets the error budget
+	std::vector<ggml_type> candidates = { GGML_TYPE_Q4_0, GGML_TYPE_Q5_1, GGML_TYPE_Q8_0 };
+	// Default error budget, relative RMS error sqrt( Σ( x - x' )² / Σ x² )
+	float maxError = 0.08f;
+	std::vector<sQuantizeRule> rules;
+	// Count of worker threads, 0 = all hardware threads
+	int threads = 0;
+	// Print the errors of every evaluated type, not just the chosen one
+	bool verbose = false;
+	// Load the output back with the whisper.cpp loader, and delete it when that fails
+	bool verify = true;
+};
+
+struct sQuantizeStats
+{
+	size_t tensors = 0;
+	size_t quantized = 0;
+	uint64_t bytesIn = 0;
+	uint64_t bytesOut = 0;
+	// Count of tensors written with each ggml_type
+	std::array<uint32_t, GGML_TYPE_COUNT> countByType = {};
+	// Time spent quantizing and measuring errors, seconds
+	double seconds = 0;
+};
+
+// Convert FP16 or FP32 GGML model file into a mixed-precision model, choosing the type of each 2D tensor from the error budget.
+// The output is in the same legacy GGML format with per-tensor types, the ftype field of the header is only the most common type.
+// The whisper.cpp loader reads these types ahead when its model loader can seek, the file and buffer loaders can; the DirectCompute GPU model doesn't support quantized tensors.
+HRESULT quantizeModel( const wchar_t* source, const wchar_t* dest, const sQuantizeParams& params, sQuantizeStats& stats );
+
+// Parse type name like "q4_0", "q8_0" or "f16"; returns GGML_TYPE_COUNT when unknown or not supported by the quantizer
+ggml_type parseQuantizeType( const char* name );
\ No newline at end of file
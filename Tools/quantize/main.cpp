@@ -0,0 +1,142 @@
+#include "Quantizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atlstr.h>
+
+namespace
+{
+	void printUsage()
+	{
+		fprintf( stderr, R"(Usage: quantize [options] <source.bin> <destination.bin>
+
+Converts FP16 or FP32 GGML model into a mixed-precision one. For every 2D tensor, picks the cheapest
+candidate type with the relative RMS error of the reconstructed weights within the budget.
+
+Options:
+  -e, --max-error <x>          Default error budget, 0.08
+  -b, --budget <pattern>=<x>   Error budget for the tensors with names containing the pattern
+  -t, --type <pattern>=<type>  Use that type for the matching tensors, without measuring errors
+  -k, --keep <pattern>         Keep the matching tensors in the source precision
+  -c, --candidates <list>      Comma-separated candidate types, default q4_0,q5_1,q8_0
+  -j, --threads <n>            Count of threads, default all hardware threads
+  -v, --verbose                Print errors of every evaluated type
+  --no-verify                  Don't load the output back with whisper.cpp after writing it
+
+When several rules match a tensor, the last one wins. Types: q4_0, q5_1, q8_0, f16.
+Example, Q8_0 cross-attention and Q4_0 everywhere else:
+  quantize -t cross_attn=q8_0 -t mlp=q4_0 ggml-medium.bin ggml-medium-mixed.bin
+)" );
+	}
+
+	// Split "pattern=value" argument
+	bool splitRule( const wchar_t* arg, std::string& pattern, CStringA& value )
+	{
+		const CStringA str{ arg };
+		const int i = str.ReverseFind( '=' );
+		if( i <= 0 )
+			return false;
+		pattern = str.Left( i ).operator LPCSTR();
+		value = str.Mid( i + 1 );
+		return !value.IsEmpty();
+	}
+
+	bool parseCandidates( const wchar_t* arg, std::vector<ggml_type>& rdi )
+	{
+		rdi.clear();
+		const CStringA str{ arg };
+		int pos = 0;
+		while( true )
+		{
+			const CStringA tok = str.Tokenize( ",", pos );
+			if( pos < 0 )
+				break;
+			const ggml_type t = parseQuantizeType( tok );
+			if( t == GGML_TYPE_COUNT )
+				return false;
+			rdi.push_back( t );
+		}
+		return !rdi.empty();
+	}
+
+	bool parseArguments( int argc, wchar_t* argv[], sQuantizeParams& params, const wchar_t*& source, const wchar_t*& dest )
+	{
+		source = dest = nullptr;
+		for( int i = 1; i < argc; i++ )
+		{
+			const CStringW arg = argv[ i ];
+			const bool hasValue = i + 1 < argc;
+			if( arg == L"-v" || arg == L"--verbose" )
+				params.verbose = true;
+			else if( arg == L"--no-verify" )
+				params.verify = false;
+			else if( ( arg == L"-e" || arg == L"--max-error" ) && hasValue )
+				params.maxError = (float)_wtof( argv[ ++i ] );
+			else if( ( arg == L"-j" || arg == L"--threads" ) && hasValue )
+				params.threads = _wtoi( argv[ ++i ] );
+			else if( ( arg == L"-c" || arg == L"--candidates" ) && hasValue )
+			{
+				if( !parseCandidates( argv[ ++i ], params.candidates ) )
+					return false;
+			}
+			else if( ( arg == L"-k" || arg == L"--keep" ) && hasValue )
+			{
+				sQuantizeRule& r = params.rules.emplace_back();
+				r.pattern = CStringA{ argv[ ++i ] }.operator LPCSTR();
+				r.keep = true;
+			}
+			else if( ( arg == L"-b" || arg == L"--budget" || arg == L"-t" || arg == L"--type" ) && hasValue )
+			{
+				sQuantizeRule r;
+				CStringA value;
+				if( !splitRule( argv[ ++i ], r.pattern, value ) )
+					return false;
+				if( arg == L"-b" || arg == L"--budget" )
+					r.maxError = (float)atof( value );
+				else
+				{
+					r.type = parseQuantizeType( value );
+					if( r.type == GGML_TYPE_COUNT )
+						return false;
+				}
+				params.rules.push_back( std::move( r ) );
+			}
+			else if( arg[ 0 ] == L'-' )
+				return false;
+			else if( nullptr == source )
+				source = argv[ i ];
+			else if( nullptr == dest )
+				dest = argv[ i ];
+			else
+				return false;
+		}
+		return nullptr != dest && params.maxError >= 0;
+	}
+}
+
+int wmain( int argc, wchar_t* argv[] )
+{
+	sQuantizeParams params;
+	const wchar_t* source;
+	const wchar_t* dest;
+	if( !parseArguments( argc, argv, params, source, dest ) )
+	{
+		printUsage();
+		return 1;
+	}
+
+	sQuantizeStats stats;
+	const HRESULT hr = quantizeModel( source, dest, params, stats );
+	if( FAILED( hr ) )
+	{
+		fprintf( stderr, "Quantization failed, status 0x%08X\n", (uint32_t)hr );
+		return hr;
+	}
+
+	constexpr double mulMb = 1.0 / ( 1 << 20 );
+	printf( "\n%zu tensors, %zu quantized in %.2f seconds; %.1f MB -> %.1f MB\n",
+		stats.tensors, stats.quantized, stats.seconds, mulMb * (double)stats.bytesIn, mulMb * (double)stats.bytesOut );
+	for( int t = 0; t < GGML_TYPE_COUNT; t++ )
+		if( 0 != stats.countByType[ t ] )
+			printf( "    %-5s %u tensors\n", ggml_type_name( (ggml_type)t ), stats.countByType[ t ] );
+	return 0;
+}
\ No newline at end of file
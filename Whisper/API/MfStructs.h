@@ -19,6 +19,8 @@ namespace Whisper
 	{
 		// When the capture device supports stereo, keep stereo PCM samples in addition to mono
 		Stereo = 1,
+		// Use the neural voice activity detector, the GGML model from vadModelPath field, instead of the default energy and spectrum heuristics
+		NeuralVAD = 2,
 	};
 
 	// Parameters for audio capture
@@ -30,6 +32,9 @@ namespace Whisper
 		float pauseDuration = 0.333f;
 		// Flags for the audio capture
 		uint32_t flags = 0;
+		// Path to the GGML voice activity detection model, like "ggml-silero-v5.1.2.bin"
+		// Only used with eCaptureFlags.NeuralVAD flag. The string is copied when the capture device is opened.
+		const wchar_t* vadModelPath = nullptr;
 	};
 
 	enum struct eCaptureStatus : uint8_t
@@ -7,6 +7,8 @@
 #include "sLoadModelCallbacks.h"
 #include "sModelSetup.h"
 
+struct whisper_context;
+
 namespace Whisper
 {
 	struct iModel;
@@ -41,6 +43,9 @@ namespace Whisper
 		// Performance information
 		virtual HRESULT COMLIGHTCALL timingsPrint() = 0;
 		virtual HRESULT COMLIGHTCALL timingsReset() = 0;
+		// Record the timeline of the profiler blocks on all threads, and save it as Chrome trace event JSON, viewable in chrome://tracing or ui.perfetto.dev
+		virtual HRESULT COMLIGHTCALL timingsTraceStart() = 0;
+		virtual HRESULT COMLIGHTCALL timingsTraceSave( const wchar_t* path ) = 0;
 	};
 
 	struct DECLSPEC_NOVTABLE iModel : public ComLight::IUnknown
@@ -57,6 +62,17 @@ namespace Whisper
 		virtual const char* COMLIGHTCALL stringFromToken( whisper_token token ) = 0;
 
 		virtual HRESULT COMLIGHTCALL clone( iModel** rdi ) = 0;
+
+		// Expose the underlying whisper_context for advanced operations like tensor inspection
+		// Must stay at the same position as in iContext.h, the two declarations share the vtable layout
+		virtual HRESULT COMLIGHTCALL getWhisperContext( struct whisper_context** pp ) = 0;
+
+		// Time spent in the stages of the model loader
+		virtual HRESULT COMLIGHTCALL getLoadStageTimes( sLoadModelTimes& rdi ) = 0;
+
+		// Budget in megabytes for the resident decoder layers of the model loaded with eGpuModelFlags.LazyResidency flag, 0 = unlimited.
+		// Shared by the clones of the model. Returns S_FALSE when the model doesn't use lazy residency.
+		virtual HRESULT COMLIGHTCALL setResidentBudget( uint32_t megabytes ) = 0;
 	};
 
 	HRESULT COMLIGHTCALL setupLogger( const sLoggerSetup& setup );
@@ -38,6 +38,9 @@ namespace Whisper
 		// Performance information
 		HRESULT __stdcall timingsPrint();
 		HRESULT __stdcall timingsReset();
+		// Record the timeline of the profiler blocks on all threads, and save it as Chrome trace event JSON, viewable in chrome://tracing or ui.perfetto.dev
+		HRESULT __stdcall timingsTraceStart();
+		HRESULT __stdcall timingsTraceSave( const wchar_t* path );
 	};
 
 	__interface __declspec( novtable, uuid( "abefb4c9-e8d8-46a3-8747-5afbadef1adb" ) ) iModel : public IUnknown
@@ -57,6 +60,13 @@ namespace Whisper
 
 		// Expose the underlying whisper_context for advanced operations like tensor inspection
 		HRESULT __stdcall getWhisperContext( struct whisper_context** pp );
+
+		// Time spent in the stages of the model loader
+		HRESULT __stdcall getLoadStageTimes( sLoadModelTimes& rdi );
+
+		// Budget in megabytes for the resident decoder layers of the model loaded with eGpuModelFlags.LazyResidency flag, 0 = unlimited.
+		// Shared by the clones of the model. Returns S_FALSE when the model doesn't use lazy residency.
+		HRESULT __stdcall setResidentBudget( uint32_t megabytes );
 	};
 
 	HRESULT __stdcall setupLogger( const sLoggerSetup& setup );
@@ -31,6 +31,9 @@ namespace Whisper
 		// Experimental
 		TokenTimestamps = 0x100,
 		SpeedupAudio = 0x200,
+
+		// Cache MEL spectrograms on disk, keyed by the hash of the PCM data; only used by runFull method
+		MelCache = 0x400,
 	};
 
 	inline eFullParamsFlags operator | ( eFullParamsFlags a, eFullParamsFlags b )
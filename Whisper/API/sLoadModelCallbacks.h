@@ -6,6 +6,19 @@ namespace Whisper
 	// Return S_OK to continue, or S_FALSE to fail with "The operation was canceled by the user" status code
 	using pfnCancel = HRESULT( __stdcall* )( void* pv ) noexcept;
 	
+	// Time spent in the stages of the model loader, in 100-nanosecond ticks, returned by iModel.getLoadStageTimes
+	struct sLoadModelTimes
+	{
+		// Parsing tensor headers and reading the payloads; runs on the background thread, in parallel with the other stages
+		uint64_t read;
+		// Copying CPU tensors into their final buffers, on the thread pool
+		uint64_t convert;
+		// Creating GPU buffers with the tensors, including the reshaping
+		uint64_t upload;
+		// Elapsed time of the complete load
+		uint64_t total;
+	};
+	
 	struct sLoadModelCallbacks
 	{
 		pfnLoadProgress progress;
@@ -24,6 +24,20 @@ namespace Whisper
 		NoReshapedMatMul = 4,
 		UseReshapedMatMul = 8,
 		Cloneable = 0x10,
+		// Memory-map the model file instead of reading it; uploads tensors to VRAM straight from the mapping
+		MemoryMapped = 0x20,
+		// Keep a compiled copy of the model in the cache folder, with the tensors in their final layouts; subsequent loads map that file instead of parsing the model
+		CompiledCache = 0x40,
+		// For the hybrid model, keep the decoder weights memory-mapped, and only resident in RAM while they're used.
+		// The decoder prefetches the next layer, and evicts the least recently used layers when they exceed the budget set with iModel.setResidentBudget, unlimited by default
+		// Implies MemoryMapped for the hybrid model, ignored by the GPU model
+		LazyResidency = 0x80,
+		// Place the immutable system memory data of the model into a named shared memory segment; other processes which load the same model attach to that segment.
+		// Ignored when combined with CompiledCache, the cache files are already shared by the OS.
+		SharedWeights = 0x100,
+		// For the hybrid model, keep the self-attention KV cache of the decoder in Q8_0 format, halving the memory and the bandwidth of the cache.
+		// The attention kernels read the quantized cache directly. Ignored by the GPU model
+		QuantizedKvCache = 0x200,
 	};
 
 	struct sModelSetup
@@ -1,7 +1,9 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include "Tensor.h"
 #include "LargeBuffer.h"
+#include "LayerResidency.h"
 #if TENSOR_GGML_COMPAT
 #include "../source/ggml.h"
 #endif
@@ -99,6 +101,9 @@ namespace CpuCompute
 		// A vector of layers
 		std::vector<LayerDecoder> layers;
 
+		// When the model was loaded with eGpuModelFlags.LazyResidency flag, manages the working set of the memory-mapped layers
+		std::shared_ptr<LayerResidency> residency;
+
 		void setMemoryBuffer( LargeBuffer&& mem ) noexcept
 		{
 			memory = std::move( mem );
@@ -128,4 +133,35 @@ namespace CpuCompute
 		std::vector<ggml_tensor> ggml;
 #endif
 	};
+
+	// Call the function for every tensor of the decoder, in a fixed order; the set of tensors is the same as in HybridLoader.cpp
+	// Works for both const and mutable DecoderTensors, the function receives `Tensor&` or `const Tensor&` accordingly.
+	template<class Tensors, class Fn>
+	inline HRESULT forEachTensor( Tensors& dec, Fn&& fn )
+	{
+		auto pair = [ & ]( auto& p ) -> HRESULT
+		{
+			CHECK( fn( p.w ) );
+			return fn( p.b );
+		};
+
+		CHECK( fn( dec.positionalEmbedding ) );
+		CHECK( fn( dec.tokenEmbedding ) );
+		CHECK( pair( dec.ln ) );
+		for( auto& layer : dec.layers )
+		{
+			CHECK( pair( layer.mlpLn ) );
+			CHECK( pair( layer.mlp0 ) );
+			CHECK( pair( layer.mlp1 ) );
+			CHECK( pair( layer.attnLn0 ) );
+			CHECK( pair( layer.attnQuery ) );
+			CHECK( fn( layer.attnKey ) );
+			CHECK( pair( layer.attnValue ) );
+			CHECK( pair( layer.attnLn1 ) );
+			CHECK( pair( layer.crossAttnLn0 ) );
+			CHECK( pair( layer.crossAttnQuery ) );
+			CHECK( pair( layer.crossAttnLn1 ) );
+		}
+		return S_OK;
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "HybridLoader.h"
+#include "../Utils/parallelFor.h"
 using namespace CpuCompute;
 using namespace ComLight;
 
@@ -94,6 +95,7 @@ HRESULT HybridLoader::setupTensor( const CStringA& name, int n_dims, int ftype,
 
 	size_t payloadBytes = cbElement * totalElts;
 	pt.payloadBytes = payloadBytes;
+	pt.cbElement = cbElement;
 	CHECK( stream->seek( payloadBytes, eSeekOrigin::Current ) );
 	postponedBytes += (int64_t)payloadBytes;
 
@@ -102,7 +104,42 @@ HRESULT HybridLoader::setupTensor( const CStringA& name, int n_dims, int ftype,
 	return S_OK;
 }
 
-HRESULT HybridLoader::completeLoad( ComLight::iReadStream* stream, iLoaderProgressSink& progressSink )
+namespace
+{
+	// The CPU decoder loads the weights with unaligned SIMD instructions, the element alignment is enough
+	inline bool canMapTensor( const uint8_t* mappedFile, int64_t streamOffset, size_t cbElement )
+	{
+		if( nullptr == mappedFile )
+			return false;
+		return 0 == ( (size_t)( mappedFile + streamOffset ) % cbElement );
+	}
+
+	struct CopyJob
+	{
+		uint8_t* rdi;
+		const uint8_t* rsi;
+		size_t cb;
+	};
+
+	struct CopyJobs
+	{
+		std::vector<CopyJob> jobs;
+		int countThreads = 1;
+
+		static HRESULT workCallback( int ith, void* ctx ) noexcept
+		{
+			const CopyJobs& cj = *(const CopyJobs*)ctx;
+			for( size_t i = ith; i < cj.jobs.size(); i += cj.countThreads )
+			{
+				const CopyJob& j = cj.jobs[ i ];
+				memcpy( j.rdi, j.rsi, j.cb );
+			}
+			return S_OK;
+		}
+	};
+}
+
+HRESULT HybridLoader::completeLoad( ComLight::iReadStream* stream, iLoaderProgressSink& progressSink, const uint8_t* mappedFile )
 {
 	if( pending.size() != map.GetCount() )
 	{
@@ -110,19 +147,46 @@ HRESULT HybridLoader::completeLoad( ComLight::iReadStream* stream, iLoaderProgre
 		return E_INVALIDARG;
 	}
 
+	// Count bytes for the tensors which need to be copied
+	size_t copyBytes = 0;
+	size_t mappedBytes = 0;
+	for( const auto& pt : pending )
+	{
+		if( canMapTensor( mappedFile, pt.streamOffset, pt.cbElement ) )
+			mappedBytes += pt.payloadBytes;
+		else
+			copyBytes += ( pt.payloadBytes + 31 ) & ( ~( (size_t)31 ) );
+	}
+
 	LargeBuffer buffer;
-	CHECK( buffer.allocate( bufferBytes ) );
+	if( copyBytes > 0 )
+		CHECK( buffer.allocate( copyBytes ) );
 
-	uint8_t* rdi = buffer.pointer();
+	uint8_t* rdi = ( copyBytes > 0 ) ? buffer.pointer() : nullptr;
+	// With the memory-mapped file, these copies don't depend on the stream position, they run on the thread pool
+	CopyJobs copies;
 
 	for( const auto& pt : pending )
 	{
-		if( pt.payloadBytes > INT_MAX )
-			return DISP_E_OVERFLOW;
-		CHECK( stream->seek( pt.streamOffset, eSeekOrigin::Begin ) );
-
-		int written = 0;
-		CHECK( stream->read( rdi, (int)pt.payloadBytes, written ) );
+		if( canMapTensor( mappedFile, pt.streamOffset, pt.cbElement ) )
+		{
+			// The mapping is read-only, same as the memory protection of the buffer we would have loaded
+			pt.destPointer->setDataPointer( const_cast<uint8_t*>( mappedFile + pt.streamOffset ) );
+			CHECK( progressSink.gotBytes( (int64_t)pt.payloadBytes ) );
+			continue;
+		}
+
+		if( nullptr != mappedFile )
+			copies.jobs.push_back( CopyJob{ rdi, mappedFile + pt.streamOffset, pt.payloadBytes } );
+		else
+		{
+			if( pt.payloadBytes > INT_MAX )
+				return DISP_E_OVERFLOW;
+			CHECK( stream->seek( pt.streamOffset, eSeekOrigin::Begin ) );
+
+			int written = 0;
+			CHECK( stream->read( rdi, (int)pt.payloadBytes, written ) );
+		}
 		CHECK( progressSink.gotBytes( (int64_t)pt.payloadBytes ) );
 
 		pt.destPointer->setDataPointer( rdi );
@@ -131,10 +195,22 @@ HRESULT HybridLoader::completeLoad( ComLight::iReadStream* stream, iLoaderProgre
 		rdi += cb;
 	}
 
-	CHECK( buffer.setReadOnly( bufferBytes ) );
+	if( !copies.jobs.empty() )
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo( &si );
+		copies.countThreads = std::min( (int)si.dwNumberOfProcessors, (int)copies.jobs.size() );
+		CHECK( Whisper::parallelFor( &CopyJobs::workCallback, copies.countThreads, &copies ) );
+	}
+
+	if( copyBytes > 0 )
+		CHECK( buffer.setReadOnly( copyBytes ) );
 	destination.setMemoryBuffer( std::move( buffer ) );
 
 	constexpr double mulMb = 1.0 / ( 1 << 20 );
-	logDebug( u8"Loaded %zu decoder tensors, %g MB RAM", pending.size(), mulMb * (double)(int64_t)bufferBytes );
+	if( nullptr != mappedFile )
+		logDebug( u8"Loaded %zu decoder tensors, %g MB mapped from the model file, %g MB RAM", pending.size(), mulMb * (double)(int64_t)mappedBytes, mulMb * (double)(int64_t)copyBytes );
+	else
+		logDebug( u8"Loaded %zu decoder tensors, %g MB RAM", pending.size(), mulMb * (double)(int64_t)copyBytes );
 	return S_OK;
 }
\ No newline at end of file
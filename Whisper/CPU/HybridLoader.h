@@ -23,6 +23,7 @@ namespace CpuCompute
 			int64_t streamOffset = 0;
 			size_t bufferOffset = 0;
 			size_t payloadBytes = 0;
+			size_t cbElement = 0;
 		};
 		std::vector<PendingTensor> pending;
 
@@ -32,6 +33,8 @@ namespace CpuCompute
 
 		HRESULT setupTensor( const CStringA& name, int n_dims, int ftype, const std::array<int, 4>& ne, ComLight::iReadStream* stream, int64_t& postponedBytes );
 
-		HRESULT completeLoad( ComLight::iReadStream* stream, iLoaderProgressSink& progressSink );
+		// When mappedFile is not nullptr, it points to the memory-mapped model file.
+		// In that case the tensors which are aligned in the file point straight into the mapping, only the misaligned ones are copied.
+		HRESULT completeLoad( ComLight::iReadStream* stream, iLoaderProgressSink& progressSink, const uint8_t* mappedFile = nullptr );
 	};
 }
\ No newline at end of file
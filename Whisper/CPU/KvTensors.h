@@ -1,35 +1,59 @@
 #pragma once
 #include "Tensor.h"
 #include "LargeBuffer.h"
+#include "attentionQ8.h"
 #include "../Whisper/sModelParams.h"
 
 namespace CpuCompute
 {
 	class KvTensors
 	{
-		uint16_t* keys = nullptr;
-		uint16_t* values = nullptr;
+		void* keys = nullptr;
+		void* values = nullptr;
 		uint32_t size = 0;
+		eDataType type = eDataType::FP16;
 
 		CpuCompute::LargeBuffer memory;
 
 	public:
-		// Create these two large tensors, FP16 precision
-		HRESULT create( const Whisper::sModelParams& mp );
+		// Create these two large tensors, FP16 or Q8_0 precision
+		HRESULT create( const Whisper::sModelParams& mp, bool quantized = false );
+
+		eDataType dataType() const { return type; }
 
 		// A slice of model.memory_cross_k tensor
 		Tensor keysView( uint32_t len, uint32_t off ) const
 		{
-			if( len + off <= size )
-				return Tensor::fromData( keys + off, eDataType::FP16, len );
+			if( len + off <= size && type == eDataType::FP16 )
+				return Tensor::fromData( (uint16_t*)keys + off, eDataType::FP16, len );
 			throw E_BOUNDS;
 		}
 
 		// A slice of model.memory_cross_v tensor
 		Tensor valuesView( uint32_t len, uint32_t off ) const
 		{
-			if( len + off <= size )
-				return Tensor::fromData( values + off, eDataType::FP16, len );
+			if( len + off <= size && type == eDataType::FP16 )
+				return Tensor::fromData( (uint16_t*)values + off, eDataType::FP16, len );
+			throw E_BOUNDS;
+		}
+
+		// Q8_0 blocks of the keys, the length and offset are in elements, multiples of 32
+		BlockQ8* keysQ8( uint32_t len, uint32_t off ) const
+		{
+			return blocksQ8( keys, len, off );
+		}
+
+		// Q8_0 blocks of the values, the length and offset are in elements, multiples of 32
+		BlockQ8* valuesQ8( uint32_t len, uint32_t off ) const
+		{
+			return blocksQ8( values, len, off );
+		}
+
+	private:
+		BlockQ8* blocksQ8( void* pv, uint32_t len, uint32_t off ) const
+		{
+			if( len + off <= size && type == eDataType::Q8_0 && 0 == ( off % 32 ) )
+				return (BlockQ8*)pv + off / 32;
 			throw E_BOUNDS;
 		}
 	};
@@ -2,18 +2,32 @@
 #include "KvTensors.h"
 using namespace CpuCompute;
 
-// Create these two large tensors, FP16 precision
-HRESULT KvTensors::create( const Whisper::sModelParams& mp )
+// Create these two large tensors, FP16 or Q8_0 precision
+HRESULT KvTensors::create( const Whisper::sModelParams& mp, bool quantized )
 {
 	const uint32_t n_mem = mp.n_text_layer * mp.n_text_ctx;
 	const uint32_t n_elements = mp.n_text_state * n_mem;
 
-	const size_t cb = sizeof( uint16_t ) * (size_t)n_elements * 2;
-	CHECK( memory.allocate( cb ) );
+	size_t cbTensor;
+	if( quantized )
+	{
+		// The kernels need whole blocks in every head
+		if( 0 != mp.n_text_state % ( mp.n_text_head * 32 ) )
+			return E_INVALIDARG;
+		cbTensor = sizeof( BlockQ8 ) * (size_t)( n_elements / 32 );
+		type = eDataType::Q8_0;
+	}
+	else
+	{
+		cbTensor = sizeof( uint16_t ) * (size_t)n_elements;
+		type = eDataType::FP16;
+	}
 
-	uint16_t* pointer = (uint16_t*)memory.pointer();
+	CHECK( memory.allocate( cbTensor * 2 ) );
+
+	uint8_t* pointer = (uint8_t*)memory.pointer();
 	keys = pointer;
-	values = pointer + n_elements;
+	values = pointer + cbTensor;
 	size = n_elements;
 	return S_OK;
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "stdafx.h"
+#include "LayerResidency.h"
+#include "DecoderTensors.h"
+using namespace CpuCompute;
+
+namespace
+{
+	using Lock = CComCritSecLock<CComAutoCriticalSection>;
+
+	constexpr size_t pageSize = 4096;
+
+	size_t tensorBytes( const Tensor& t )
+	{
+		switch( t.type() )
+		{
+		case eDataType::FP16:
+			return (size_t)t.countElements() * 2;
+		case eDataType::FP32:
+			return (size_t)t.countElements() * 4;
+		}
+		return 0;
+	}
+
+	class RangesBuilder
+	{
+		const uint8_t* const begin;
+		const uint8_t* const end;
+		std::vector<std::pair<size_t, size_t>> ranges;
+
+	public:
+		RangesBuilder( const uint8_t* mapped, size_t length ) :
+			begin( mapped ), end( mapped + length ) { }
+
+		void add( const Tensor& t )
+		{
+			const uint8_t* p = (const uint8_t*)t.data();
+			if( nullptr == p || p < begin || p >= end )
+				return;
+			const size_t a = (size_t)p & ~( pageSize - 1 );
+			const size_t b = ( (size_t)p + tensorBytes( t ) + pageSize - 1 ) & ~( pageSize - 1 );
+			ranges.emplace_back( a, b );
+		}
+		void add( const TensorPair& tp )
+		{
+			add( tp.w );
+			add( tp.b );
+		}
+
+		size_t build( std::vector<WIN32_MEMORY_RANGE_ENTRY>& rdi )
+		{
+			std::sort( ranges.begin(), ranges.end() );
+			rdi.clear();
+			size_t bytes = 0;
+			for( size_t i = 0; i < ranges.size(); )
+			{
+				size_t a = ranges[ i ].first;
+				size_t b = ranges[ i ].second;
+				for( i++; i < ranges.size() && ranges[ i ].first <= b; i++ )
+					b = std::max( b, ranges[ i ].second );
+
+				WIN32_MEMORY_RANGE_ENTRY& e = rdi.emplace_back();
+				e.VirtualAddress = (void*)a;
+				e.NumberOfBytes = b - a;
+				bytes += b - a;
+			}
+			return bytes;
+		}
+	};
+}
+
+HRESULT LayerResidency::create( const DecoderTensors& tensors, const uint8_t* mappedBegin, size_t mappedLength )
+{
+	if( nullptr == mappedBegin || 0 == mappedLength )
+		return E_INVALIDARG;
+
+	layers.clear();
+	layers.resize( tensors.layers.size() );
+	size_t totalBytes = 0;
+	for( size_t i = 0; i < layers.size(); i++ )
+	{
+		const LayerDecoder& src = tensors.layers[ i ];
+		RangesBuilder builder{ mappedBegin, mappedLength };
+		builder.add( src.attnLn0 );
+		builder.add( src.attnLn1 );
+		builder.add( src.attnQuery );
+		builder.add( src.attnKey );
+		builder.add( src.attnValue );
+		builder.add( src.crossAttnLn0 );
+		builder.add( src.crossAttnLn1 );
+		builder.add( src.crossAttnQuery );
+		builder.add( src.mlpLn );
+		builder.add( src.mlp0 );
+		builder.add( src.mlp1 );
+		layers[ i ].bytes = builder.build( layers[ i ].ranges );
+		totalBytes += layers[ i ].bytes;
+	}
+
+	constexpr double mulMb = 1.0 / ( 1 << 20 );
+	logDebug( u8"Lazy residency of decoder layers: %g MB mapped", mulMb * (double)(int64_t)totalBytes );
+	return S_OK;
+}
+
+void LayerResidency::setBudget( size_t budgetBytes )
+{
+	Lock lock( m_cs );
+	budget = budgetBytes;
+
+	constexpr double mulMb = 1.0 / ( 1 << 20 );
+	if( 0 != budget )
+		logDebug( u8"Lazy residency of decoder layers: %g MB budget", mulMb * (double)(int64_t)budget );
+	else
+		logDebug( u8"Lazy residency of decoder layers: unlimited budget" );
+}
+
+void LayerResidency::prefetch( Layer& layer )
+{
+	if( !layer.ranges.empty() )
+	{
+		// Asynchronous, the kernel queues the reads and returns
+		if( !PrefetchVirtualMemory( GetCurrentProcess(), layer.ranges.size(), layer.ranges.data(), 0 ) )
+			logWarningHr( getLastHr(), u8"PrefetchVirtualMemory" );
+	}
+	layer.resident = true;
+	residentBytes += layer.bytes;
+}
+
+void LayerResidency::evict( Layer& layer )
+{
+	// Calling VirtualUnlock on pages which aren't locked removes them from the working set of the process.
+	// The function then fails with ERROR_NOT_LOCKED, that's expected.
+	for( const auto& r : layer.ranges )
+		VirtualUnlock( r.VirtualAddress, r.NumberOfBytes );
+	layer.resident = false;
+	residentBytes -= layer.bytes;
+}
+
+void LayerResidency::beginLayer( uint32_t il )
+{
+	Lock lock( m_cs );
+	const size_t count = layers.size();
+	if( il >= count )
+		return;
+
+	Layer& curr = layers[ il ];
+	curr.lastUse = ++useCounter;
+	if( !curr.resident )
+		prefetch( curr );
+
+	// After the last layer, the next token starts from the first one
+	Layer& next = layers[ ( il + 1 ) % count ];
+	if( !next.resident )
+	{
+		next.lastUse = useCounter;
+		prefetch( next );
+	}
+
+	if( 0 == budget )
+		return;
+	while( residentBytes > budget )
+	{
+		Layer* victim = nullptr;
+		for( auto& l : layers )
+		{
+			if( !l.resident || &l == &curr || &l == &next )
+				continue;
+			if( nullptr == victim || l.lastUse < victim->lastUse )
+				victim = &l;
+		}
+		if( nullptr == victim )
+			break;
+		evict( *victim );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <atlbase.h>
+
+namespace CpuCompute
+{
+	struct DecoderTensors;
+
+	// Working set management for the decoder weights of the hybrid model, when these weights are memory-mapped from a file.
+	// The decoder calls beginLayer() before computing each layer. That method asks the OS to prefetch the weights of the next layer,
+	// and when the resident weights exceed the budget, removes the least recently used layers from the working set of the process.
+	// The evicted pages stay in the OS page cache while there's free memory, otherwise they're re-read from the file on the next use.
+	class LayerResidency
+	{
+		struct Layer
+		{
+			// Page-aligned address ranges of the mapped weights, sorted and merged
+			std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges;
+			// Total size of these ranges
+			size_t bytes = 0;
+			uint64_t lastUse = 0;
+			bool resident = false;
+		};
+		std::vector<Layer> layers;
+		// Maximum bytes of resident layers, 0 = unlimited
+		size_t budget = 0;
+		size_t residentBytes = 0;
+		uint64_t useCounter = 0;
+		CComAutoCriticalSection m_cs;
+
+		void prefetch( Layer& layer );
+		void evict( Layer& layer );
+
+	public:
+		// Change the budget, the excess layers are evicted by the next beginLayer() call
+		void setBudget( size_t budgetBytes );
+
+		// Collect address ranges of the decoder layers. The tensors outside of the mapped memory range stay resident all the time, and ain't tracked.
+		HRESULT create( const DecoderTensors& tensors, const uint8_t* mappedBegin, size_t mappedLength );
+
+		// Called by the decoder before computing the layer, from any thread
+		void beginLayer( uint32_t il );
+	};
+}
\ No newline at end of file
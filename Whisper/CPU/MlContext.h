@@ -1,6 +1,7 @@
 #pragma once
 #include "Tensor.h"
 #include "ParallelForRunner.h"
+#include "attentionQ8.h"
 
 namespace CpuCompute
 {
@@ -67,5 +68,12 @@ namespace CpuCompute
 		Tensor permute( const Tensor& a, uint8_t axis0, uint8_t axis1, uint8_t axis2, uint8_t axis3 );
 
 		void copyInPlace( Tensor& dest, const Tensor& a, eDataType type, std::initializer_list<uint32_t> size );
+
+		// Quantize continuous FP32 tensor into the Q8_0 blocks at the destination
+		void storeQ8( BlockQ8* rdi, const Tensor& source );
+
+		// Masked self-attention over the Q8_0 KV cache, reads the quantized keys and values directly.
+		// Q is FP32 [ n_state, N ], the cache has n_past + N rows of n_state elements; returns FP32 [ n_state, N ] with the heads merged
+		Tensor attentionQ8( const Tensor& Q, const BlockQ8* keys, const BlockQ8* values, uint32_t n_head, uint32_t n_past );
 	};
 }
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "MlContext.h"
+#include "attentionQ8.h"
+#include "simdUtils.h"
+using namespace CpuCompute;
+
+namespace
+{
+	constexpr size_t QK8 = 32;
+
+	__forceinline float horizontalSum( __m256 vec )
+	{
+		__m128 v = _mm256_extractf128_ps( vec, 1 );
+		v = _mm_add_ps( v, _mm256_castps256_ps128( vec ) );
+		v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+		v = _mm_add_ss( v, _mm_movehdup_ps( v ) );
+		return _mm_cvtss_f32( v );
+	}
+
+	__forceinline float horizontalMax( __m256 vec )
+	{
+		__m128 v = _mm256_extractf128_ps( vec, 1 );
+		v = _mm_max_ps( v, _mm256_castps256_ps128( vec ) );
+		v = _mm_max_ps( v, _mm_movehl_ps( v, v ) );
+		v = _mm_max_ss( v, _mm_movehdup_ps( v ) );
+		return _mm_cvtss_f32( v );
+	}
+
+	__forceinline float loadScale( const BlockQ8* rsi )
+	{
+		const __m128i i = _mm_cvtsi32_si128( rsi->scale );
+		return _mm_cvtss_f32( _mm_cvtph_ps( i ) );
+	}
+
+	// Load 8 int8 values, and upcast them to FP32; AVX1 has no 32-byte integer instructions, using two SSE 4.1 conversions
+	__forceinline __m256 loadInt8( const int8_t* rsi )
+	{
+		const __m128i i8 = _mm_loadl_epi64( ( const __m128i* )rsi );
+		const __m128i low = _mm_cvtepi8_epi32( i8 );
+		const __m128i high = _mm_cvtepi8_epi32( _mm_srli_si128( i8, 4 ) );
+		return _mm256_cvtepi32_ps( _mm256_setr_m128i( low, high ) );
+	}
+
+	// Dot product of a Q8_0 vector and FP32 vector, the length is in blocks
+	inline float dotQ8( const BlockQ8* rsi, const float* x, size_t blocks )
+	{
+		__m256 acc = _mm256_setzero_ps();
+		for( size_t i = 0; i < blocks; i++, rsi++, x += QK8 )
+		{
+			__m256 block = _mm256_mul_ps( loadInt8( rsi->values ), _mm256_loadu_ps( x ) );
+			block = _mm256_add_ps( block, _mm256_mul_ps( loadInt8( rsi->values + 8 ), _mm256_loadu_ps( x + 8 ) ) );
+			block = _mm256_add_ps( block, _mm256_mul_ps( loadInt8( rsi->values + 16 ), _mm256_loadu_ps( x + 16 ) ) );
+			block = _mm256_add_ps( block, _mm256_mul_ps( loadInt8( rsi->values + 24 ), _mm256_loadu_ps( x + 24 ) ) );
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( block, _mm256_set1_ps( loadScale( rsi ) ) ) );
+		}
+		return horizontalSum( acc );
+	}
+
+	// rdi += rsi * mul, where rsi is a Q8_0 vector; the length is in blocks
+	inline void addScaledQ8( float* rdi, const BlockQ8* rsi, float mul, size_t blocks )
+	{
+		for( size_t i = 0; i < blocks; i++, rsi++, rdi += QK8 )
+		{
+			const __m256 scale = _mm256_set1_ps( mul * loadScale( rsi ) );
+			for( size_t j = 0; j < QK8; j += 8 )
+			{
+				__m256 v = _mm256_loadu_ps( rdi + j );
+				v = _mm256_add_ps( v, _mm256_mul_ps( loadInt8( rsi->values + j ), scale ) );
+				_mm256_storeu_ps( rdi + j, v );
+			}
+		}
+	}
+
+	// Round 8 floats to int32, and pack into 8 bytes with signed saturation
+	__forceinline __m128i packInt8( __m256 v )
+	{
+		const __m256i i32 = _mm256_cvtps_epi32( _mm256_round_ps( v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+		const __m128i i16 = _mm_packs_epi32( _mm256_castsi256_si128( i32 ), _mm256_extractf128_si256( i32, 1 ) );
+		return _mm_packs_epi16( i16, i16 );
+	}
+}
+
+void CpuCompute::quantizeQ8( BlockQ8* rdi, const float* rsi, size_t length )
+{
+	assert( 0 == length % QK8 );
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7FFFFFFF ) );
+	const float* const rsiEnd = rsi + length;
+	for( ; rsi < rsiEnd; rsi += QK8, rdi++ )
+	{
+		const __m256 v0 = _mm256_loadu_ps( rsi );
+		const __m256 v1 = _mm256_loadu_ps( rsi + 8 );
+		const __m256 v2 = _mm256_loadu_ps( rsi + 16 );
+		const __m256 v3 = _mm256_loadu_ps( rsi + 24 );
+
+		__m256 amax = _mm256_max_ps( _mm256_and_ps( v0, absMask ), _mm256_and_ps( v1, absMask ) );
+		amax = _mm256_max_ps( amax, _mm256_max_ps( _mm256_and_ps( v2, absMask ), _mm256_and_ps( v3, absMask ) ) );
+		const float scale = horizontalMax( amax ) / 127.0f;
+		rdi->scale = _cvtss_sh( scale, 0 );
+
+		const __m256 mul = _mm256_set1_ps( ( scale != 0 ) ? 1.0f / scale : 0.0f );
+		const __m128i low = _mm_unpacklo_epi64( packInt8( _mm256_mul_ps( v0, mul ) ), packInt8( _mm256_mul_ps( v1, mul ) ) );
+		const __m128i high = _mm_unpacklo_epi64( packInt8( _mm256_mul_ps( v2, mul ) ), packInt8( _mm256_mul_ps( v3, mul ) ) );
+		_mm_storeu_si128( ( __m128i* )rdi->values, low );
+		_mm_storeu_si128( ( __m128i* )( rdi->values + 16 ), high );
+	}
+}
+
+void MlContext::storeQ8( BlockQ8* rdi, const Tensor& source )
+{
+	if( !( source.isContinuous() && source.type() == eDataType::FP32 ) )
+		throw E_INVALIDARG;
+	const size_t length = source.countElements();
+	if( 0 != length % QK8 )
+		throw E_INVALIDARG;
+	quantizeQ8( rdi, source.fp32(), length );
+}
+
+Tensor MlContext::attentionQ8( const Tensor& Q, const BlockQ8* keys, const BlockQ8* values, uint32_t n_head, uint32_t n_past )
+{
+	if( !( Q.isContinuous() && Q.type() == eDataType::FP32 ) )
+		throw E_INVALIDARG;
+	const uint32_t n_state = Q.ne[ 0 ];
+	const uint32_t N = Q.countRows();
+	if( 0 != n_state % ( n_head * QK8 ) )
+		throw E_INVALIDARG;
+
+	Tensor res = createTensor( eDataType::FP32, { n_state, N } );
+
+	// One work item per head per token; the token #i attends to the first n_past + i + 1 rows of the cache
+	struct AttentionContext : public iComputeRange
+	{
+		const float* q;
+		float* result;
+		const BlockQ8* keys;
+		const BlockQ8* values;
+		uint32_t n_state, n_head, n_past;
+
+		HRESULT __stdcall compute( size_t i, size_t end ) const override final
+		{
+			const size_t headSize = n_state / n_head;
+			const size_t headBlocks = headSize / QK8;
+			const size_t rowBlocks = n_state / QK8;
+
+			ALIGNED_SPAN( scores, n_past + ( end + n_head - 1 ) / n_head );
+			for( ; i < end; i++ )
+			{
+				const size_t token = i / n_head;
+				const size_t head = i % n_head;
+				const size_t length = n_past + token + 1;
+				const float* const rsi = q + token * n_state + head * headSize;
+				float* const rdi = result + token * n_state + head * headSize;
+
+				const BlockQ8* k = keys + head * headBlocks;
+				for( size_t j = 0; j < length; j++, k += rowBlocks )
+					scores[ j ] = dotQ8( k, rsi, headBlocks );
+				::softMax( scores, length, 1.0f );
+
+				memset( rdi, 0, headSize * 4 );
+				const BlockQ8* v = values + head * headBlocks;
+				for( size_t j = 0; j < length; j++, v += rowBlocks )
+					addScaledQ8( rdi, v, scores[ j ], headBlocks );
+			}
+			return S_OK;
+		}
+	};
+
+	AttentionContext context;
+	context.q = Q.fp32();
+	context.result = res.fp32();
+	context.keys = keys;
+	context.values = values;
+	context.n_state = n_state;
+	context.n_head = n_head;
+	context.n_past = n_past;
+
+	check( pfor.parallelFor( context, (size_t)n_head * N ) );
+	return res;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+namespace CpuCompute
+{
+	// 32 elements quantized into int8 with a shared FP16 scale, binary compatible with block_q8_0 of GGML
+	struct BlockQ8
+	{
+		uint16_t scale;
+		int8_t values[ 32 ];
+	};
+	static_assert( sizeof( BlockQ8 ) == 34 );
+
+	// Quantize FP32 vector into Q8_0 blocks, the length must be a multiple of 32
+	void quantizeQ8( BlockQ8* rdi, const float* rsi, size_t length );
+}
\ No newline at end of file
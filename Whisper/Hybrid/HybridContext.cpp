@@ -116,7 +116,7 @@ HRESULT HybridContext::create()
 	CHECK( kvCross.create( whisperModel.parameters ) );
 
 	// Create RAM buffers for memory_k / memory_v
-	CHECK( kv.create( whisperModel.parameters ) );
+	CHECK( kv.create( whisperModel.parameters, whisperModel.quantizedKvCache ) );
 
 	return S_OK;
 }
@@ -169,6 +169,8 @@ HRESULT HybridContext::decode( const int* tokens, const int n_tokens, const int
 	{
 		if( 0 == il ) Tracing::tensor( "dec-inpL", inpL );
 		const auto& layer = model.layers[ il ];
+		if( model.residency )
+			model.residency->beginLayer( il );
 		SetAllocatorRaii acLayer{ this, allocComputeLayer };
 
 		// norm
@@ -193,39 +195,55 @@ HRESULT HybridContext::decode( const int* tokens, const int n_tokens, const int
 			ml.addRepeat( Vcur, layer.attnValue.b );
 			if( 0 == il ) Tracing::tensor( "dec-Vcur", Vcur );
 
-			// store key and value to memory
+			if( kv.dataType() == eDataType::Q8_0 )
 			{
+				// Quantized cache: store the new rows, and run the complete attention with the custom kernel
 				const uint32_t len = N * n_state;
 				const uint32_t off = n_state * ( (uint32_t)il * n_ctx + n_past );
-				Tensor k = kv.keysView( len, off );
-				Tensor v = kv.valuesView( len, off );
+				ml.storeQ8( kv.keysQ8( len, off ), Kcur );
+				ml.storeQ8( kv.valuesQ8( len, off ), Vcur );
 
-				CHECK( ml.copyImpl( k, Kcur ) );
-				CHECK( ml.copyImpl( v, Vcur ) );
+				const uint32_t lenLayer = ( n_past + N ) * n_state;
+				const uint32_t offLayer = (uint32_t)il * n_ctx * n_state;
+				cur = ml.attentionQ8( Qcur, kv.keysQ8( lenLayer, offLayer ), kv.valuesQ8( lenLayer, offLayer ), n_head, n_past );
+				if( 0 == il ) Tracing::tensor( "dec-KQV", cur );
+			}
+			else
+			{
+				// store key and value to memory
+				{
+					const uint32_t len = N * n_state;
+					const uint32_t off = n_state * ( (uint32_t)il * n_ctx + n_past );
+					Tensor k = kv.keysView( len, off );
+					Tensor v = kv.valuesView( len, off );
+
+					CHECK( ml.copyImpl( k, Kcur ) );
+					CHECK( ml.copyImpl( v, Vcur ) );
+				}
+
+				// ------
+				Tensor Q = ml.permute( ml.copy( Qcur, eDataType::FP32, { n_state / n_head, n_head, N } ), 0, 2, 1, 3 );
+				Tensor K = ml.permute( kv.keysView( ( n_past + N ) * n_state, (uint32_t)il * n_ctx * n_state )
+					.reshape3d( n_state / n_head, n_head, n_past + N ),
+					0, 2, 1, 3 );
+				Tensor KQ = ml.mulMat( K, Q );
+				if( 0 == il ) Tracing::tensor( "dec-KQ-0", KQ );
+				ml.diagMaskInf( KQ, n_past );
+				if( 0 == il ) Tracing::tensor( "dec-KQ-1", KQ );
+				ml.softMax( KQ );
+				if( 0 == il ) Tracing::tensor( "dec-KQ-2", KQ );
+
+				Tensor V_trans = ml.permute(
+					kv.valuesView( ( n_past + N ) * n_state, (uint32_t)il * n_ctx * n_state )
+					.reshape3d( n_state / n_head, n_head, n_past + N ),
+					1, 2, 0, 3 );
+
+				Tensor KQV = ml.mulMat( V_trans, KQ );
+				if( 0 == il ) Tracing::tensor( "dec-KQV", KQV );
+
+				Tensor KQV_merged = ml.permute( KQV, 0, 2, 1, 3 );
+				ml.copyInPlace( cur, KQV_merged, eDataType::FP32, { n_state, N } );
 			}
-
-			// ------
-			Tensor Q = ml.permute( ml.copy( Qcur, eDataType::FP32, { n_state / n_head, n_head, N } ), 0, 2, 1, 3 );
-			Tensor K = ml.permute( kv.keysView( ( n_past + N ) * n_state, (uint32_t)il * n_ctx * n_state )
-				.reshape3d( n_state / n_head, n_head, n_past + N ),
-				0, 2, 1, 3 );
-			Tensor KQ = ml.mulMat( K, Q );
-			if( 0 == il ) Tracing::tensor( "dec-KQ-0", KQ );
-			ml.diagMaskInf( KQ, n_past );
-			if( 0 == il ) Tracing::tensor( "dec-KQ-1", KQ );
-			ml.softMax( KQ );
-			if( 0 == il ) Tracing::tensor( "dec-KQ-2", KQ );
-
-			Tensor V_trans = ml.permute(
-				kv.valuesView( ( n_past + N ) * n_state, (uint32_t)il * n_ctx * n_state )
-				.reshape3d( n_state / n_head, n_head, n_past + N ),
-				1, 2, 0, 3 );
-
-			Tensor KQV = ml.mulMat( V_trans, KQ );
-			if( 0 == il ) Tracing::tensor( "dec-KQV", KQV );
-
-			Tensor KQV_merged = ml.permute( KQV, 0, 2, 1, 3 );
-			ml.copyInPlace( cur, KQV_merged, eDataType::FP32, { n_state, N } );
 		}
 
 		{
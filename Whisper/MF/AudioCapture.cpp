@@ -104,6 +104,7 @@ namespace
 		CComPtr<IMFSourceReader> reader;
 		CComPtr<iMediaFoundation> mediaFoundation;
 		sCaptureParams captureParams;
+		CString vadModelPath;
 
 		HRESULT COMLIGHTCALL getReader( IMFSourceReader** pp ) const noexcept override final
 		{
@@ -148,6 +149,12 @@ namespace
 		}
 
 		captureParams = cp;
+		if( nullptr != cp.vadModelPath )
+		{
+			// Keep a copy of the string, the caller owns the memory
+			vadModelPath = cp.vadModelPath;
+			captureParams.vadModelPath = vadModelPath;
+		}
 		mediaFoundation = owner;
 		return S_OK;
 	}
@@ -7,6 +7,7 @@
 #include <mfreadwrite.h>
 #include "mfUtils.h"
 #include "AudioCapture.h"
+#include "WaveFileAudio.h"
 #include <mfapi.h>
 #include <shlwapi.h>
 
@@ -100,6 +101,12 @@ namespace Whisper
 			if( nullptr == path || nullptr == pp )
 				return E_POINTER;
 
+			// Uncompressed PCM files are memory-mapped and decoded without Media Foundation
+			const HRESULT hr = tryOpenWaveFile( path, stereo, pp );
+			CHECK( hr );
+			if( S_OK == hr )
+				return S_OK;
+
 			ComLight::CComPtr<ComLight::Object<AudioReader>> res;
 			CHECK( ComLight::Object<AudioReader>::create( res ) );
 			CHECK( res->open( this, path, stereo ) );
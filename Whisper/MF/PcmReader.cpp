@@ -8,10 +8,8 @@ namespace Whisper
 {
 	__interface iSampleHandler
 	{
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, PcmStereoChunk* pStereo ) const;
 		void moveBufferData( AudioBuffer& rdi, size_t amount ) const;
 		void appendPcm( AudioBuffer& rdi, const float* rsi, size_t countFloats ) const;
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, size_t samples, PcmStereoChunk* pStereo ) const;
 		uint32_t readerChannelsCount() const;
 	};
 }
@@ -20,35 +18,12 @@ namespace
 {
 	using namespace Whisper;
 
-	__forceinline void copyMono( PcmMonoChunk* rdi, const AudioBuffer& rsi, size_t sourceOffset, size_t samples )
-	{
-		assert( sourceOffset + samples <= rsi.mono.size() );
-		memcpy( rdi->mono.data(), &rsi.mono[ sourceOffset ], samples * 4 );
-		if( samples < FFT_STEP )
-			memset( rdi->mono.data() + samples, 0, ( FFT_STEP - samples ) * 4 );
-	}
-
-	__forceinline void copyStereo( PcmStereoChunk* rdi, const AudioBuffer& rsi, size_t sourceOffset, size_t samples )
-	{
-		memcpy( rdi->stereo.data(), &rsi.stereo[ sourceOffset * 2 ], samples * 8 );
-		if( samples < FFT_STEP )
-			memset( rdi->stereo.data() + samples * 2, 0, ( FFT_STEP - samples ) * 8 );
-	}
-
 	struct HandlerMono : iSampleHandler
 	{
 		void appendPcm( AudioBuffer& rdi, const float* rsi, size_t countFloats ) const override
 		{
 			rdi.appendMono( rsi, countFloats );
 		}
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, PcmStereoChunk* pStereo ) const override final
-		{
-			copyMono( pMono, rsi, sourceOffset, FFT_STEP );
-		}
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, size_t samples, PcmStereoChunk* pStereo ) const override final
-		{
-			copyMono( pMono, rsi, sourceOffset, samples );
-		}
 		void moveBufferData( AudioBuffer& rdi, size_t amount ) const override final
 		{
 			const size_t len = rdi.mono.size();
@@ -78,16 +53,6 @@ namespace
 		{
 			rdi.appendStereo( rsi, countFloats );
 		}
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, PcmStereoChunk* pStereo ) const override final
-		{
-			copyMono( pMono, rsi, sourceOffset, FFT_STEP );
-			copyStereo( pStereo, rsi, sourceOffset, FFT_STEP );
-		}
-		void copyChunk( PcmMonoChunk* pMono, const AudioBuffer& rsi, size_t sourceOffset, size_t samples, PcmStereoChunk* pStereo ) const override final
-		{
-			copyMono( pMono, rsi, sourceOffset, samples );
-			copyStereo( pStereo, rsi, sourceOffset, samples );
-		}
 		void moveBufferData( AudioBuffer& rdi, size_t amount ) const override final
 		{
 			const size_t len = rdi.mono.size();
@@ -272,14 +237,38 @@ namespace
 	}
 }
 
+void PcmReader::setSampleHandler( bool sourceMono, bool wantStereo )
+{
+	if( sourceMono )
+		sampleHandler = &s_mono;
+	else if( !wantStereo )
+		sampleHandler = &s_downmix;
+	else
+	{
+		sampleHandler = &s_stereo;
+		m_stereoOutput = true;
+	}
+}
+
 PcmReader::PcmReader( const iAudioReader* iar )
 {
 	if( nullptr == iar )
 		throw E_POINTER;
 
-	check( iar->getReader( &reader ) );
 	const bool stereo = iar->requestedStereo() == S_OK;
 
+	// Native readers of uncompressed audio files don't have IMFSourceReader, they implement the internal iPcmSource interface instead.
+	// QueryInterface is not a const method, but it doesn't modify the object.
+	iAudioReader* const unconst = const_cast<iAudioReader*>( iar );
+	if( SUCCEEDED( unconst->QueryInterface( iPcmSource::iid(), (void**)&source ) ) )
+	{
+		setSampleHandler( source->sourceChannels() < 2, stereo );
+		m_length = (size_t)( source->sourceSamples() / FFT_STEP );
+		return;
+	}
+
+	check( iar->getReader( &reader ) );
+
 	// Set up media type, and figure out sample handler
 	check( reader->SetStreamSelection( MF_SOURCE_READER_ALL_STREAMS, FALSE ) );
 	check( reader->SetStreamSelection( MF_SOURCE_READER_FIRST_AUDIO_STREAM, TRUE ) );
@@ -290,15 +279,7 @@ PcmReader::PcmReader( const iAudioReader* iar )
 	check( mtNative->GetUINT32( MF_MT_AUDIO_NUM_CHANNELS, &numChannels ) );
 
 	const bool sourceMono = numChannels < 2;
-	if( sourceMono )
-		sampleHandler = &s_mono;
-	else if( !stereo )
-		sampleHandler = &s_downmix;
-	else
-	{
-		sampleHandler = &s_stereo;
-		m_stereoOutput = true;
-	}
+	setSampleHandler( sourceMono, stereo );
 
 	CComPtr<IMFMediaType> mt;
 	check( createMediaType( !sourceMono, &mt ) );
@@ -325,6 +306,9 @@ HRESULT PcmReader::readNextSample()
 		pcm.clear();
 	bufferReadOffset = 0;
 
+	if( source )
+		return readNextBlock();
+
 	while( true )
 	{
 		DWORD dwFlags = 0;
@@ -390,18 +374,43 @@ HRESULT PcmReader::readNextSample()
 	}
 }
 
-HRESULT PcmReader::readChunk( PcmMonoChunk& mono, PcmStereoChunk* stereo )
+HRESULT PcmReader::readNextBlock()
 {
-	while( true )
+	// The native source decodes straight from the memory-mapped file, use large blocks: 1 second of audio
+	constexpr uint64_t blockSamples = SAMPLE_RATE;
+
+	const uint64_t total = source->sourceSamples();
+	if( sourceOffset >= total )
+		return E_EOF;
+	const size_t count = (size_t)std::min( total - sourceOffset, blockSamples );
+	CHECK( source->decode( sourceOffset, count, pcm, m_stereoOutput ) );
+	sourceOffset += count;
+	return S_OK;
+}
+
+HRESULT PcmReader::readChunks( size_t count, float* mono, float* stereo, size_t& loaded )
+{
+	assert( nullptr == stereo || m_stereoOutput );
+	loaded = 0;
+	while( loaded < count )
 	{
 		const size_t off = bufferReadOffset;
 		const size_t availableSamples = pcm.mono.size() - off;
-		if( availableSamples >= FFT_STEP )
+		const size_t completeChunks = std::min( availableSamples / FFT_STEP, count - loaded );
+		if( completeChunks > 0 )
 		{
-			// We have enough data in the buffer
-			sampleHandler->copyChunk( &mono, pcm, off, stereo );
-			bufferReadOffset = off + FFT_STEP;
-			return S_OK;
+			// Copy all complete chunks we have in the buffer, the AudioBuffer vectors are continuous
+			const size_t samples = completeChunks * FFT_STEP;
+			memcpy( mono, &pcm.mono[ off ], samples * 4 );
+			mono += samples;
+			if( nullptr != stereo )
+			{
+				memcpy( stereo, &pcm.stereo[ off * 2 ], samples * 8 );
+				stereo += samples * 2;
+			}
+			bufferReadOffset = off + samples;
+			loaded += completeChunks;
+			continue;
 		}
 
 		if( !m_readerEndOfFile )
@@ -418,12 +427,27 @@ HRESULT PcmReader::readChunk( PcmMonoChunk& mono, PcmStereoChunk* stereo )
 		if( availableSamples > 0 )
 		{
 			// We have reached the end of stream of the reader, but the buffer still has a few samples.
-			// Return the final incomplete chunk padded with zeros
-			sampleHandler->copyChunk( &mono, pcm, off, availableSamples, stereo );
+			// Deliver the final incomplete chunk padded with zeros
+			memcpy( mono, &pcm.mono[ off ], availableSamples * 4 );
+			memset( mono + availableSamples, 0, ( FFT_STEP - availableSamples ) * 4 );
+			if( nullptr != stereo )
+			{
+				memcpy( stereo, &pcm.stereo[ off * 2 ], availableSamples * 8 );
+				memset( stereo + availableSamples * 2, 0, ( FFT_STEP - availableSamples ) * 8 );
+			}
 			bufferReadOffset = off + availableSamples;
-			return S_OK;
+			loaded++;
 		}
-
-		return E_EOF;
+		break;
 	}
+
+	if( loaded == count )
+		return S_OK;
+	return ( loaded > 0 ) ? S_FALSE : E_EOF;
+}
+
+HRESULT PcmReader::readChunk( PcmMonoChunk& mono, PcmStereoChunk* stereo )
+{
+	size_t loaded;
+	return readChunks( 1, mono.mono.data(), ( nullptr != stereo ) ? stereo->stereo.data() : nullptr, loaded );
 }
\ No newline at end of file
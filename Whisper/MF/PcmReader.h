@@ -4,6 +4,8 @@
 #include <mfreadwrite.h>
 #include "AudioBuffer.h"
 #include "../API/iMediaFoundation.cl.h"
+#include "iPcmSource.h"
+#include "../../ComLightLib/client/CComPtr.hpp"
 
 namespace Whisper
 {
@@ -34,6 +36,10 @@ namespace Whisper
 		const iSampleHandler* sampleHandler;
 		// The underlying MF source reader which delivers audio data
 		CComPtr<IMFSourceReader> reader;
+		// Alternatively, the native decoder of uncompressed audio files, doesn't use Media Foundation
+		ComLight::CComPtr<iPcmSource> source;
+		// Count of samples already decoded from the native source
+		uint64_t sourceOffset = 0;
 		// True after we consumed all available media samples from the reader
 		bool m_readerEndOfFile = false;
 		// True if this object delivers stereo samples
@@ -42,6 +48,9 @@ namespace Whisper
 		size_t m_length = 0;
 		// Read next sample from the reader, store in the PCM buffer in this class
 		HRESULT readNextSample();
+		// Decode next block of samples from the native source, store in the PCM buffer in this class
+		HRESULT readNextBlock();
+		void setSampleHandler( bool sourceMono, bool wantStereo );
 
 	public:
 
@@ -60,5 +69,11 @@ namespace Whisper
 		// Load another 10ms chunk from the stream
 		// For the last chunk in the stream, the output buffers are padded with zeros
 		HRESULT readChunk( PcmMonoChunk& mono, PcmStereoChunk* stereo );
+
+		// Load up to `count` chunks into continuous buffers, mono is count * FFT_STEP floats, the optional stereo output is twice as large.
+		// Copies complete spans straight from the intermediate buffer, instead of one chunk per call.
+		// Returns S_OK when all chunks were loaded, S_FALSE at the end of the stream when fewer chunks were available, E_EOF when none were.
+		// For the last chunk in the stream, the output buffers are padded with zeros
+		HRESULT readChunks( size_t count, float* mono, float* stereo, size_t& loaded );
 	};
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "Resampler.h"
+#include "../Whisper/audioConstants.h"
+#include <mutex>
+#include <numeric>
+#include <cmath>
+using namespace Whisper;
+
+namespace
+{
+	// Source sample rates with precomputed filter banks
+	constexpr std::array<uint32_t, 8> supportedRates = { 8000, 11025, 22050, 24000, 32000, 44100, 48000, 96000 };
+
+	// Fraction of the output Nyquist frequency passed through unchanged; Whisper doesn't care about the very top of the spectrum
+	constexpr double passband = 0.9;
+	// Kaiser window parameter, ~85 dB stopband attenuation
+	constexpr double kaiserBeta = 8.6;
+	// Count of taps of the filter, in source samples, when upsampling
+	constexpr uint32_t minTaps = 32;
+
+	// Modified Bessel function of the first kind, order 0
+	double besselI0( double x )
+	{
+		double sum = 1, term = 1;
+		const double halfSq = x * x * 0.25;
+		for( int k = 1; k < 64; k++ )
+		{
+			term *= halfSq / ( (double)k * k );
+			sum += term;
+			if( term < sum * 1e-17 )
+				break;
+		}
+		return sum;
+	}
+
+	inline float horizontalSum( __m256 v )
+	{
+		__m128 r = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+		r = _mm_add_ps( r, _mm_movehl_ps( r, r ) );
+		r = _mm_add_ss( r, _mm_movehdup_ps( r ) );
+		return _mm_cvtss_f32( r );
+	}
+}
+
+void Resampler::build( uint32_t sourceRate )
+{
+	const uint32_t g = std::gcd( sourceRate, SAMPLE_RATE );
+	up = SAMPLE_RATE / g;
+	down = sourceRate / g;
+
+	// When downsampling, the filter length in source samples grows proportionally to the ratio, to keep the same transition band in the output
+	const double ratio = std::max( 1.0, (double)down / (double)up );
+	taps = (uint32_t)std::ceil( minTaps * ratio / 8.0 ) * 8;
+
+	// Prototype low-pass filter at the upsampled rate: windowed sinc, centered at the tap which matches the output sample
+	const size_t length = (size_t)taps * up;
+	const double center = (double)( taps / 2 ) * up;
+	const double cutoff = passband * 0.5 / std::max( up, down );
+	const double windowScale = 1.0 / besselI0( kaiserBeta );
+	std::vector<double> proto( length );
+	for( size_t i = 0; i < length; i++ )
+	{
+		const double x = (double)(int64_t)i - center;
+		const double sincArg = 2.0 * M_PI * cutoff * x;
+		const double sinc = ( x == 0 ) ? 1.0 : std::sin( sincArg ) / sincArg;
+		const double w = x / center;
+		const double window = ( std::abs( w ) <= 1.0 ) ? besselI0( kaiserBeta * std::sqrt( 1.0 - w * w ) ) * windowScale : 0.0;
+		proto[ i ] = sinc * window;
+	}
+
+	// Split into phases, reverse the taps so the inner loop reads the input sequentially, and normalize each phase to unity DC gain
+	coefficients.resize( length );
+	for( uint32_t p = 0; p < up; p++ )
+	{
+		float* const rdi = &coefficients[ (size_t)p * taps ];
+		double sum = 0;
+		for( uint32_t j = 0; j < taps; j++ )
+			sum += proto[ p + (size_t)j * up ];
+		const double mul = 1.0 / sum;
+		for( uint32_t j = 0; j < taps; j++ )
+			rdi[ taps - 1 - j ] = (float)( proto[ p + (size_t)j * up ] * mul );
+	}
+}
+
+const Resampler* Resampler::get( uint32_t sourceRate )
+{
+	static std::array<Resampler, supportedRates.size()> banks;
+	static std::array<std::once_flag, supportedRates.size()> flags;
+
+	for( size_t i = 0; i < supportedRates.size(); i++ )
+	{
+		if( supportedRates[ i ] != sourceRate )
+			continue;
+		std::call_once( flags[ i ], [ i ]() { banks[ i ].build( supportedRates[ i ] ); } );
+		return &banks[ i ];
+	}
+	return nullptr;
+}
+
+void Resampler::inputRange( uint64_t offset, size_t count, int64_t& begin, int64_t& end ) const
+{
+	const int64_t half = taps / 2;
+	const int64_t first = (int64_t)( ( offset * down ) / up );
+	const int64_t last = (int64_t)( ( ( offset + count - 1 ) * down ) / up );
+	begin = first + half - taps + 1;
+	end = last + half + 1;
+}
+
+void Resampler::process( const float* source, uint64_t offset, size_t count, float* rdi ) const
+{
+	const int64_t half = taps / 2;
+	int64_t begin, end;
+	inputRange( offset, count, begin, end );
+
+	// Position at the upsampled rate, split into the input sample index and the phase
+	uint64_t position = offset * down;
+	uint64_t index = position / up;
+	uint32_t phase = (uint32_t)( position % up );
+	const uint32_t indexStep = down / up;
+	const uint32_t phaseStep = down % up;
+
+	for( size_t i = 0; i < count; i++, rdi++ )
+	{
+		const float* x = source + ( (int64_t)index + half - taps + 1 - begin );
+		const float* c = &coefficients[ (size_t)phase * taps ];
+		const float* const cEnd = c + taps;
+
+		__m256 acc = _mm256_setzero_ps();
+		for( ; c < cEnd; c += 8, x += 8 )
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_loadu_ps( x ), _mm256_loadu_ps( c ) ) );
+		*rdi = horizontalSum( acc );
+
+		// Advance by down / up input samples
+		index += indexStep;
+		phase += phaseStep;
+		if( phase >= up )
+		{
+			phase -= up;
+			index++;
+		}
+	}
+}
\ No newline at end of file
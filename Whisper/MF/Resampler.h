@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+
+namespace Whisper
+{
+	// Polyphase FIR resampler from one of the common sample rates to SAMPLE_RATE = 16 kHz.
+	// The filter banks are computed once per process, on first use.
+	// The class is stateless: the input is a complete random-access buffer, like a memory-mapped file, so any slice of the output can be computed independently.
+	class Resampler
+	{
+		// Resampling ratio is up / down, reduced by GCD
+		uint32_t up = 0, down = 0;
+		// Count of input samples per output sample; multiple of 8 for AVX
+		uint32_t taps = 0;
+		// [ up ][ taps ] matrix of filter coefficients, each row is one phase of the polyphase filter, with reversed order of the taps
+		std::vector<float> coefficients;
+
+		void build( uint32_t sourceRate );
+
+	public:
+		// Get the filter bank for the specified source sample rate, or nullptr when the rate is not supported
+		static const Resampler* get( uint32_t sourceRate );
+
+		// Count of output samples for the specified count of input samples
+		uint64_t outputLength( uint64_t inputLength ) const
+		{
+			return ( inputLength * up ) / down;
+		}
+
+		// Range of input samples [ begin, end ) required to compute the output samples [ offset, offset + count )
+		// The begin can be negative, and the end can be after the end of the input; these samples are treated as zeros.
+		void inputRange( uint64_t offset, size_t count, int64_t& begin, int64_t& end ) const;
+
+		// Compute output samples [ offset, offset + count ) of a single channel.
+		// The source points to the input sample at the position `begin` returned by inputRange method.
+		void process( const float* source, uint64_t offset, size_t count, float* rdi ) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "stdafx.h"
+#include "WaveFile.h"
+#include "../Whisper/audioConstants.h"
+#include <mmreg.h>
+#include <shlwapi.h>
+#pragma comment(lib, "Shlwapi.lib")
+using namespace Whisper;
+
+namespace
+{
+	constexpr uint32_t fourCC( char a, char b, char c, char d )
+	{
+		return (uint32_t)(uint8_t)a | ( (uint32_t)(uint8_t)b << 8 ) | ( (uint32_t)(uint8_t)c << 16 ) | ( (uint32_t)(uint8_t)d << 24 );
+	}
+
+	struct sChunkHeader
+	{
+		uint32_t id;
+		uint32_t size;
+	};
+
+	// Headerless files with these extensions are assumed to contain 16 kHz mono PCM16
+	bool isRawPcmPath( LPCTSTR path )
+	{
+		const wchar_t* ext = PathFindExtensionW( path );
+		return 0 == _wcsicmp( ext, L".pcm" ) || 0 == _wcsicmp( ext, L".raw" );
+	}
+
+	constexpr float mulFloatFromInt16 = 1.0f / 32768.0f;
+
+	// Convert PCM16 samples to FP32, 8 samples per iteration
+	void convertInt16( const int16_t* rsi, float* rdi, size_t count )
+	{
+		const int16_t* const rsiEnd = rsi + count;
+		const int16_t* const rsiEndAligned = rsi + ( count & ~(size_t)7 );
+		const __m128 mul = _mm_set1_ps( mulFloatFromInt16 );
+		for( ; rsi < rsiEndAligned; rsi += 8, rdi += 8 )
+		{
+			const __m128i i16 = _mm_loadu_si128( ( const __m128i* )rsi );
+			const __m128i i32Low = _mm_cvtepi16_epi32( i16 );
+			const __m128i i32High = _mm_cvtepi16_epi32( _mm_unpackhi_epi64( i16, i16 ) );
+			_mm_storeu_ps( rdi, _mm_mul_ps( _mm_cvtepi32_ps( i32Low ), mul ) );
+			_mm_storeu_ps( rdi + 4, _mm_mul_ps( _mm_cvtepi32_ps( i32High ), mul ) );
+		}
+#pragma loop (no_vector)
+		for( ; rsi < rsiEnd; rsi++, rdi++ )
+			*rdi = (float)*rsi * mulFloatFromInt16;
+	}
+}
+
+HRESULT WaveFile::parseRiff( const uint8_t* rsi, size_t length )
+{
+	if( length < 12 )
+		return S_FALSE;
+	const uint32_t* header = (const uint32_t*)rsi;
+	if( header[ 0 ] != fourCC( 'R', 'I', 'F', 'F' ) || header[ 2 ] != fourCC( 'W', 'A', 'V', 'E' ) )
+		return S_FALSE;
+
+	const WAVEFORMATEX* fmt = nullptr;
+	size_t fmtSize = 0;
+	const uint8_t* data = nullptr;
+	size_t dataLength = 0;
+
+	size_t offset = 12;
+	while( offset + sizeof( sChunkHeader ) <= length )
+	{
+		const sChunkHeader& chunk = *(const sChunkHeader*)( rsi + offset );
+		offset += sizeof( sChunkHeader );
+		const size_t available = length - offset;
+
+		if( chunk.id == fourCC( 'f', 'm', 't', ' ' ) )
+		{
+			if( chunk.size < sizeof( PCMWAVEFORMAT ) || chunk.size > available )
+				return S_FALSE;
+			fmt = (const WAVEFORMATEX*)( rsi + offset );
+			fmtSize = chunk.size;
+		}
+		else if( chunk.id == fourCC( 'd', 'a', 't', 'a' ) )
+		{
+			// Streaming encoders sometimes write 0 or 0xFFFFFFFF there, because they don't know the length upfront
+			data = rsi + offset;
+			dataLength = ( chunk.size == 0 || chunk.size > available ) ? available : chunk.size;
+			break;
+		}
+
+		// Chunks are padded to 2 bytes
+		offset += ( (size_t)chunk.size + 1 ) & ~(size_t)1;
+	}
+
+	if( nullptr == fmt || nullptr == data )
+		return S_FALSE;
+
+	uint16_t tag = fmt->wFormatTag;
+	if( tag == WAVE_FORMAT_EXTENSIBLE )
+	{
+		// The plain PCM format chunk can be 16 bytes, without the cbSize field; the extensible one must contain the complete structure
+		if( fmtSize < sizeof( WAVEFORMATEXTENSIBLE ) )
+			return S_FALSE;
+		if( fmt->cbSize < 22 )
+			return S_FALSE;
+		// The first 2 bytes of SubFormat GUID are the format tag
+		tag = *(const uint16_t*)( &( (const WAVEFORMATEXTENSIBLE*)fmt )->SubFormat );
+	}
+
+	if( tag == WAVE_FORMAT_PCM && fmt->wBitsPerSample == 16 )
+		waveFormat.format = ePcmFormat::Int16;
+	else if( tag == WAVE_FORMAT_IEEE_FLOAT && fmt->wBitsPerSample == 32 )
+		waveFormat.format = ePcmFormat::Float32;
+	else
+		return S_FALSE;
+
+	if( fmt->nChannels < 1 || fmt->nChannels > 2 )
+		return S_FALSE;
+	if( fmt->nSamplesPerSec != SAMPLE_RATE )
+	{
+		resampler = Resampler::get( fmt->nSamplesPerSec );
+		if( nullptr == resampler )
+			return S_FALSE;
+	}
+
+	waveFormat.channels = fmt->nChannels;
+	waveFormat.sampleRate = fmt->nSamplesPerSec;
+	const size_t bytesPerSample = (size_t)waveFormat.channels * ( fmt->wBitsPerSample / 8 );
+	waveFormat.sourceSamples = dataLength / bytesPerSample;
+	waveFormat.countSamples = ( nullptr != resampler ) ? resampler->outputLength( waveFormat.sourceSamples ) : waveFormat.sourceSamples;
+	payload = data;
+	return S_OK;
+}
+
+HRESULT WaveFile::open( LPCTSTR path )
+{
+	if( nullptr == path )
+		return E_POINTER;
+
+	// Media Foundation also accepts URLs, and files locked by other processes in weird sharing modes.
+	// When we can't open the file, return S_FALSE so the caller falls back to Media Foundation, which will report errors if any.
+	HRESULT hr = file.Create( path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN );
+	if( FAILED( hr ) )
+		return S_FALSE;
+
+	ULONGLONG cb;
+	CHECK( file.GetSize( cb ) );
+	if( cb < 2 )
+		return S_FALSE;
+	CHECK( mapping.MapFile( file, 0, 0, PAGE_READONLY, FILE_MAP_READ ) );
+	const uint8_t* const rsi = mapping;
+
+	if( isRawPcmPath( path ) )
+	{
+		waveFormat.sampleRate = SAMPLE_RATE;
+		waveFormat.channels = 1;
+		waveFormat.format = ePcmFormat::Int16;
+		waveFormat.sourceSamples = cb / 2;
+		waveFormat.countSamples = cb / 2;
+		payload = rsi;
+		hr = S_OK;
+	}
+	else
+	{
+		hr = parseRiff( rsi, (size_t)cb );
+		CHECK( hr );
+	}
+
+	if( S_OK != hr || 0 == waveFormat.countSamples )
+	{
+		mapping.Unmap();
+		file.Close();
+		payload = nullptr;
+		return S_FALSE;
+	}
+
+	logDebug16( L"Mapped audio file \"%s\": %i channels, %s samples at %i Hz, %g seconds", path, (int)waveFormat.channels,
+		waveFormat.format == ePcmFormat::Int16 ? L"PCM16" : L"FP32", (int)waveFormat.sampleRate,
+		(double)(int64_t)waveFormat.sourceSamples / waveFormat.sampleRate );
+	return S_OK;
+}
+
+void WaveFile::decodeSource( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const
+{
+	assert( offset + count <= waveFormat.sourceSamples );
+	const uint32_t channels = waveFormat.channels;
+	const AudioBuffer::pfnAppendSamples pfnAppend = AudioBuffer::appendSamplesFunc( channels < 2, wantStereo );
+
+	if( isAlignedFloat() )
+	{
+		// FP32 samples are used directly from the mapped memory
+		const float* rsi = (const float*)payload + offset * channels;
+		( rdi.*pfnAppend )( rsi, count * channels );
+		return;
+	}
+
+	constexpr size_t blockSamples = 1024;
+	alignas( 32 ) std::array<float, blockSamples * 2> block;
+	if( waveFormat.format == ePcmFormat::Float32 )
+	{
+		// Misaligned FP32 samples: copy blocks into the aligned buffer
+		const uint8_t* rsi = payload + offset * channels * 4;
+		size_t remaining = count * channels;
+		const size_t blockFloats = block.size() / channels * channels;
+		while( remaining > 0 )
+		{
+			const size_t len = std::min( remaining, blockFloats );
+			memcpy( block.data(), rsi, len * 4 );
+			( rdi.*pfnAppend )( block.data(), len );
+			rsi += len * 4;
+			remaining -= len;
+		}
+		return;
+	}
+
+	const int16_t* rsi = (const int16_t*)payload + offset * channels;
+	if( channels == 1 )
+	{
+		// Mono PCM16 is converted straight into the destination vector
+		const size_t oldLength = rdi.mono.size();
+		rdi.mono.resize( oldLength + count );
+		convertInt16( rsi, rdi.mono.data() + oldLength, count );
+		return;
+	}
+
+	// Stereo PCM16: convert blocks into a small FP32 buffer, then downmix with the SIMD code in AudioBuffer
+	while( count > 0 )
+	{
+		const size_t len = std::min( count, blockSamples );
+		convertInt16( rsi, block.data(), len * 2 );
+		( rdi.*pfnAppend )( block.data(), len * 2 );
+		rsi += len * 2;
+		count -= len;
+	}
+}
+
+void WaveFile::decodeResampled( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const
+{
+	// Source samples needed for that slice of the output, including the filter's margins
+	int64_t begin, end;
+	resampler->inputRange( offset, count, begin, end );
+	const size_t length = (size_t)( end - begin );
+
+	// Convert these source samples to FP32; downmixing is linear, it's done before the filter so mono only needs a single pass of the resampler.
+	// The margins before the start and after the end of the file are zeros.
+	const int64_t validBegin = std::max( begin, (int64_t)0 );
+	const int64_t validEnd = std::min( end, (int64_t)waveFormat.sourceSamples );
+	AudioBuffer source;
+	if( validBegin > begin )
+	{
+		source.mono.resize( (size_t)( validBegin - begin ) );
+		if( wantStereo )
+			source.stereo.resize( source.mono.size() * 2 );
+	}
+	if( validEnd > validBegin )
+		decodeSource( (uint64_t)validBegin, (size_t)( validEnd - validBegin ), source, wantStereo );
+	source.mono.resize( length );
+	if( !source.stereo.empty() )
+		source.stereo.resize( length * 2 );
+
+	const size_t oldLength = rdi.mono.size();
+	rdi.mono.resize( oldLength + count );
+	resampler->process( source.mono.data(), offset, count, rdi.mono.data() + oldLength );
+
+	if( source.stereo.empty() )
+		return;
+
+	// Resample both channels of the stereo separately, the output is interleaved
+	std::vector<float> planar( length );
+	std::vector<float> resampled( count );
+	rdi.stereo.resize( ( oldLength + count ) * 2 );
+	for( size_t ch = 0; ch < 2; ch++ )
+	{
+		for( size_t i = 0; i < length; i++ )
+			planar[ i ] = source.stereo[ i * 2 + ch ];
+		resampler->process( planar.data(), offset, count, resampled.data() );
+		float* const dest = &rdi.stereo[ oldLength * 2 + ch ];
+		for( size_t i = 0; i < count; i++ )
+			dest[ i * 2 ] = resampled[ i ];
+	}
+}
+
+void WaveFile::decode( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const
+{
+	assert( offset + count <= waveFormat.countSamples );
+	wantStereo = wantStereo && waveFormat.channels > 1;
+	if( nullptr == resampler )
+		decodeSource( offset, count, rdi, wantStereo );
+	else
+		decodeResampled( offset, count, rdi, wantStereo );
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <atlfile.h>
+#include "AudioBuffer.h"
+#include "Resampler.h"
+
+namespace Whisper
+{
+	enum struct ePcmFormat : uint8_t
+	{
+		Int16 = 1,
+		Float32 = 2,
+	};
+
+	struct sWaveFormat
+	{
+		// Sample rate of the file
+		uint32_t sampleRate = 0;
+		uint16_t channels = 0;
+		ePcmFormat format = ePcmFormat::Int16;
+		// Count of samples per channel in the file
+		uint64_t sourceSamples = 0;
+		// Count of samples per channel delivered by this class, at 16 kHz
+		uint64_t countSamples = 0;
+	};
+
+	// Read-only memory mapping of an uncompressed audio file: RIFF WAVE with PCM16 or FP32 samples, or headerless 16 kHz mono PCM16.
+	// Converts the samples to FP32 with SIMD, and when needed resamples to 16 kHz, without going through Media Foundation.
+	class WaveFile
+	{
+		CAtlFile file;
+		CAtlFileMapping<uint8_t> mapping;
+		const uint8_t* payload = nullptr;
+		sWaveFormat waveFormat;
+		// Polyphase filter bank when the sample rate of the file is not 16 kHz
+		const Resampler* resampler = nullptr;
+
+		HRESULT parseRiff( const uint8_t* rsi, size_t length );
+
+		// Convert the specified slice of the samples from the file to FP32, without resampling
+		void decodeSource( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const;
+		void decodeResampled( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const;
+
+	public:
+		// Map the file and parse the header.
+		// Returns S_FALSE when the file is not in the format supported by this class, the caller should then use Media Foundation to decode it.
+		HRESULT open( LPCTSTR path );
+
+		const sWaveFormat& format() const { return waveFormat; }
+
+		// True when the samples of the file are FP32 aligned by 4 bytes.
+		// The data chunk of IEEE float files with 18-byte fmt chunk, or with a fact chunk, starts at misaligned offset.
+		bool isAlignedFloat() const
+		{
+			return waveFormat.format == ePcmFormat::Float32 && 0 == ( (uintptr_t)payload & 3 );
+		}
+
+		// True when the samples are aligned FP32 mono at 16 kHz, i.e. the mapped memory can be used directly as the mono PCM
+		bool isMonoFloat() const
+		{
+			return waveFormat.channels == 1 && isAlignedFloat() && nullptr == resampler;
+		}
+		const float* monoFloat() const
+		{
+			return isMonoFloat() ? (const float*)payload : nullptr;
+		}
+
+		// Decode the specified slice of samples, and append to the buffer. The offset and count are in 16 kHz samples.
+		// Mono is always produced, downmixing the stereo source. When wantStereo is true and the source is stereo, the interleaved stereo is appended as well.
+		void decode( uint64_t offset, size_t count, AudioBuffer& rdi, bool wantStereo ) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "WaveFileAudio.h"
+#include "WaveFile.h"
+#include "iPcmSource.h"
+#include "../Whisper/audioConstants.h"
+#include "../ComLightLib/comLightServer.h"
+using namespace Whisper;
+
+namespace
+{
+	// iAudioBuffer implementation for the uncompressed audio files.
+	// When the file contains FP32 mono samples, getPcmMono() returns the pointer into the mapped file, no copies at all.
+	class WaveFileBuffer : public ComLight::ObjectRoot<iAudioBuffer>
+	{
+		WaveFile file;
+		AudioBuffer pcm;
+		const float* mono = nullptr;
+		uint32_t samples = 0;
+
+		uint32_t COMLIGHTCALL countSamples() const noexcept override final
+		{
+			return samples;
+		}
+		const float* COMLIGHTCALL getPcmMono() const noexcept override final
+		{
+			return mono;
+		}
+		const float* COMLIGHTCALL getPcmStereo() const noexcept override final
+		{
+			if( !pcm.stereo.empty() )
+				return pcm.stereo.data();
+			return nullptr;
+		}
+		HRESULT COMLIGHTCALL getTime( int64_t& rdi ) const noexcept override final
+		{
+			rdi = 0;
+			return S_OK;
+		}
+
+	public:
+		HRESULT load( LPCTSTR path, bool stereo );
+	};
+
+	HRESULT WaveFileBuffer::load( LPCTSTR path, bool stereo )
+	{
+		HRESULT hr = file.open( path );
+		CHECK( hr );
+		if( S_OK != hr )
+			return S_FALSE;
+
+		const uint64_t len = file.format().countSamples;
+		if( len > UINT_MAX )
+			return S_FALSE;
+		samples = (uint32_t)len;
+
+		if( file.isMonoFloat() )
+		{
+			mono = file.monoFloat();
+			return S_OK;
+		}
+
+		try
+		{
+			file.decode( 0, samples, pcm, stereo );
+		}
+		catch( const std::bad_alloc& )
+		{
+			return E_OUTOFMEMORY;
+		}
+		mono = pcm.mono.data();
+		return S_OK;
+	}
+
+	// iAudioReader implementation for the uncompressed audio files.
+	// Doesn't have IMFSourceReader; PcmReader pulls the samples through the internal iPcmSource interface instead.
+	class WaveFileReader : public ComLight::ObjectRoot<iAudioReader>,
+		public iPcmSource
+	{
+		WaveFile file;
+		bool wantStereo = false;
+
+		HRESULT COMLIGHTCALL getReader( IMFSourceReader** pp ) const noexcept override final
+		{
+			return E_NOTIMPL;
+		}
+		HRESULT COMLIGHTCALL requestedStereo() const noexcept override final
+		{
+			return wantStereo ? S_OK : S_FALSE;
+		}
+		HRESULT COMLIGHTCALL getDuration( int64_t& rdi ) const noexcept override final
+		{
+			const sWaveFormat& wf = file.format();
+			rdi = ( (int64_t)wf.countSamples * 10'000'000 ) / SAMPLE_RATE;
+			return S_OK;
+		}
+
+		uint32_t COMLIGHTCALL sourceChannels() const noexcept override final
+		{
+			return file.format().channels;
+		}
+		uint64_t COMLIGHTCALL sourceSamples() const noexcept override final
+		{
+			return file.format().countSamples;
+		}
+		HRESULT COMLIGHTCALL decode( uint64_t offset, size_t count, AudioBuffer& rdi, bool stereo ) const noexcept override final
+		{
+			if( offset + count > file.format().countSamples )
+				return E_BOUNDS;
+			try
+			{
+				file.decode( offset, count, rdi, stereo );
+				return S_OK;
+			}
+			catch( const std::bad_alloc& )
+			{
+				return E_OUTOFMEMORY;
+			}
+		}
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iAudioReader )
+			COM_INTERFACE_ENTRY( iPcmSource )
+		END_COM_MAP()
+
+	public:
+		HRESULT open( LPCTSTR path, bool stereo )
+		{
+			wantStereo = stereo;
+			return file.open( path );
+		}
+	};
+}
+
+HRESULT Whisper::tryLoadWaveFile( LPCTSTR path, bool stereo, iAudioBuffer** pp )
+{
+	if( nullptr == path || nullptr == pp )
+		return E_POINTER;
+
+	ComLight::CComPtr<ComLight::Object<WaveFileBuffer>> obj;
+	CHECK( ComLight::Object<WaveFileBuffer>::create( obj ) );
+	const HRESULT hr = obj->load( path, stereo );
+	CHECK( hr );
+	if( S_OK != hr )
+		return S_FALSE;
+
+	obj.detach( pp );
+	return S_OK;
+}
+
+HRESULT Whisper::tryOpenWaveFile( LPCTSTR path, bool stereo, iAudioReader** pp )
+{
+	if( nullptr == path || nullptr == pp )
+		return E_POINTER;
+
+	ComLight::CComPtr<ComLight::Object<WaveFileReader>> obj;
+	CHECK( ComLight::Object<WaveFileReader>::create( obj ) );
+	const HRESULT hr = obj->open( path, stereo );
+	CHECK( hr );
+	if( S_OK != hr )
+		return S_FALSE;
+
+	obj.detach( pp );
+	return S_OK;
+}
\ No newline at end of file
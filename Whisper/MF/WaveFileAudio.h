@@ -0,0 +1,13 @@
+#pragma once
+#include "../API/iMediaFoundation.cl.h"
+
+namespace Whisper
+{
+	// Load uncompressed WAV or raw PCM file, without Media Foundation; resamples common sample rates to 16 kHz.
+	// Returns S_FALSE when the format of the file is not supported by the native reader.
+	HRESULT tryLoadWaveFile( LPCTSTR path, bool stereo, iAudioBuffer** pp );
+
+	// Open uncompressed WAV or raw PCM file for streaming, without Media Foundation; resamples common sample rates to 16 kHz.
+	// Returns S_FALSE when the format of the file is not supported by the native reader.
+	HRESULT tryOpenWaveFile( LPCTSTR path, bool stereo, iAudioReader** pp );
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include "../../ComLightLib/comLightCommon.h"
+
+namespace Whisper
+{
+	struct AudioBuffer;
+
+	// Internal interface implemented by audio readers which decode samples without Media Foundation.
+	// PcmReader queries iAudioReader objects for this interface, and when supported, pulls the samples from there instead of IMFSourceReader.
+	struct DECLSPEC_NOVTABLE iPcmSource : public ComLight::IUnknown
+	{
+		DEFINE_INTERFACE_ID( "{ac63e92e-5eab-4f90-a2e2-342ccfe5189b}" );
+
+		// Count of channels in the source audio, 1 or 2
+		virtual uint32_t COMLIGHTCALL sourceChannels() const = 0;
+
+		// Count of samples in the source audio, at 16 kHz sample rate
+		virtual uint64_t COMLIGHTCALL sourceSamples() const = 0;
+
+		// Decode the specified slice of samples, and append to the buffer.
+		// Mono is always produced, when stereo is true the interleaved stereo samples are appended as well.
+		virtual HRESULT COMLIGHTCALL decode( uint64_t offset, size_t count, AudioBuffer& rdi, bool stereo ) const = 0;
+	};
+}
\ No newline at end of file
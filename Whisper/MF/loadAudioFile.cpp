@@ -3,6 +3,7 @@
 #include "loadAudioFile.h"
 #include "mfUtils.h"
 #include "AudioBuffer.h"
+#include "WaveFileAudio.h"
 #include <mfidl.h>
 #include <mfreadwrite.h>
 #include <mfapi.h>
@@ -143,6 +144,12 @@ HRESULT COMLIGHTCALL Whisper::loadAudioFile( LPCTSTR path, bool stereo, iAudioBu
 	if( nullptr == path || nullptr == pp )
 		return E_POINTER;
 
+	// Uncompressed PCM files are memory-mapped and decoded without Media Foundation
+	const HRESULT hr = tryLoadWaveFile( path, stereo, pp );
+	CHECK( hr );
+	if( S_OK == hr )
+		return S_OK;
+
 	ComLight::CComPtr<ComLight::Object<MediaFileBuffer>> obj;
 	CHECK( ComLight::Object<MediaFileBuffer>::create( obj ) );
 	CHECK( obj->load( path, stereo ) );
@@ -154,6 +154,32 @@ HRESULT Tensor::createImmutable( eDataType type, const std::array<int, 4>& size,
 	return S_OK;
 }
 
+HRESULT Tensor::createImmutable( eDataType type, const TensorShape& shape, size_t countElements, const void* rsi )
+{
+	DXGI_FORMAT format;
+	size_t cbElement;
+	switch( type )
+	{
+	case eDataType::FP16:
+		format = DXGI_FORMAT_R16_FLOAT;
+		cbElement = 2;
+		break;
+	case eDataType::FP32:
+		format = DXGI_FORMAT_R32_FLOAT;
+		cbElement = 4;
+		break;
+	default:
+		return E_NOTIMPL;
+	}
+
+	CComPtr<ID3D11Buffer> buffer;
+	CHECK( createBuffer( eBufferUse::Immutable, cbElement * countElements, &buffer, rsi, nullptr ) );
+	CHECK( TensorGpuViews::create( buffer, format, countElements, false ) );
+	ne = shape.ne;
+	nb = shape.nb;
+	return S_OK;
+}
+
 HRESULT Tensor::create( eDataType type, std::initializer_list<uint32_t> sizeElements, eBufferUse usage, CComPtr<ID3D11Buffer>& buffer, const void* rsi, ID3D11Buffer** ppStagingBuffer, bool shared )
 {
 	TensorGpuViews::clear();
@@ -326,6 +352,32 @@ void Tensor::download( std::vector<uint16_t>& vec ) const
 	downloadImpl( viewDesc, countElements, 2, vec.data() );
 }
 
+HRESULT Tensor::downloadView( std::vector<uint8_t>& vec ) const
+{
+	ID3D11ShaderResourceView* const srv = *this;
+	if( nullptr == srv )
+		return OLE_E_BLANK;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	srv->GetDesc( &viewDesc );
+	try
+	{
+		const uint32_t cbElement = dxgiSizeof( viewDesc.Format );
+		const uint32_t countElements = viewDesc.Buffer.NumElements;
+		vec.resize( (size_t)cbElement * countElements );
+		downloadImpl( viewDesc, countElements, cbElement, vec.data() );
+	}
+	catch( HRESULT hr )
+	{
+		return hr;
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+	return S_OK;
+}
+
 Tensor Tensor::reshape3d( uint32_t ne0, uint32_t ne1, uint32_t ne2 ) const
 {
 	if( !isContinuous() )
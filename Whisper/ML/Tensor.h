@@ -50,6 +50,8 @@ namespace DirectCompute
 		HRESULT create( eDataType type, std::initializer_list<uint32_t> sizeElements, bool shared = false );
 		HRESULT create( eDataType type, const std::array<uint32_t, 4>& sizeElements, bool shared = false );
 		HRESULT createImmutable( eDataType type, const std::array<int, 4>& size, const void* rsi );
+		// Create an immutable tensor with the specified shape and strides, from the data produced by downloadView() method
+		HRESULT createImmutable( eDataType type, const TensorShape& shape, size_t countElements, const void* rsi );
 
 		eDataType getType() const;
 
@@ -58,6 +60,9 @@ namespace DirectCompute
 		void download( std::vector<float>& vec ) const;
 		void download( std::vector<uint16_t>& vec ) const;
 
+		// Download the complete view of this tensor as raw bytes, in the layout it has in VRAM, reshaped panels included
+		HRESULT downloadView( std::vector<uint8_t>& vec ) const;
+
 		// ggml_reshape_3d
 		Tensor reshape3d( uint32_t ne0, uint32_t ne1, uint32_t ne2 ) const;
 
@@ -182,12 +182,16 @@ void GpuProfiler::BlockState::haveTimestamp( eEvent evt, uint16_t cs, uint16_t t
 		timeStart = (int64_t)time;
 		if( nullptr != parentBlock )
 			parentBlock->completePrevShader( time, profiler );
+		else
+			profiler.traceAnchorGpu = time;
 		return;
 	case eEvent::BlockEnd:
 		assert( -1 != timeStart );
 		assert( cs == EmptyShader );
 		completePrevShader( time, profiler );
 		destBlock->addPending( (int64_t)time - timeStart );
+		if( nullptr != profiler.trace )
+			profiler.traceFrame.push_back( { timeStart, (int64_t)time, (uint16_t)id } );
 		timeStart = -1;
 		return;
 	case eEvent::Shader:
@@ -218,6 +222,9 @@ void GpuProfiler::blockStart( eProfilerBlock which )
 	{
 		context()->Begin( disjoint );
 		parentBlock = nullptr;
+		trace = dest.gpuTrace();
+		if( nullptr != trace )
+			traceAnchorTsc = Whisper::tscNow();
 	}
 	else
 		parentBlock = *stack.rbegin();
@@ -231,6 +238,7 @@ void GpuProfiler::blockStart( eProfilerBlock which )
 		BlockState& block = blockStates[ which ];
 		block.destBlock = &results[ (uint16_t)which ];
 		block.destBlock->dest = &dest.measure( which );
+		block.id = which;
 		bs = &block;
 	}
 	bs->parentBlock = parentBlock;
@@ -258,6 +266,7 @@ void GpuProfiler::blockEnd()
 		// On nVidia 1080Ti, that frequency is 1E+9 = 1 GHz
 		const uint64_t freq = dtsd.Frequency;
 		resultsMakeTime( freq );
+		traceFlush( freq );
 	}
 	else
 	{
@@ -266,6 +275,23 @@ void GpuProfiler::blockEnd()
 		// The timestamp returned by ID3D11DeviceContext::GetData for a timestamp query is only reliable if Disjoint is FALSE.
 		resultsDropPending();
 	}
+	traceFrame.clear();
+	trace = nullptr;
+}
+
+// The GPU and CPU clocks are only aligned at the start of the top-level block.
+// GPU runs behind the CPU which submits the work, the GPU blocks on the timeline are shifted to the left by that latency.
+void GpuProfiler::traceFlush( uint64_t freq )
+{
+	if( nullptr == trace )
+		return;
+	const int64_t anchor = dest.traceTicks( traceAnchorTsc );
+	for( const auto& e : traceFrame )
+	{
+		const int64_t begin = anchor + (int64_t)::makeTime( (uint64_t)e.begin - traceAnchorGpu, freq );
+		const int64_t end = anchor + (int64_t)::makeTime( (uint64_t)e.end - traceAnchorGpu, freq );
+		trace->push( e.block, begin, end );
+	}
 }
 
 void GpuProfiler::computeShader( eComputeShader cs )
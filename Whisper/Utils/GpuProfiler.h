@@ -78,6 +78,7 @@ namespace DirectCompute
 			uint16_t prevShader = EmptyShader;
 			uint16_t prevShaderTag = 0;
 			BlockState* parentBlock = nullptr;
+			eProfilerBlock id;
 			void haveTimestamp( eEvent evt, uint16_t cs, uint16_t tag, uint64_t time, GpuProfiler& profiler );
 		private:
 			void completePrevShader( uint64_t time, GpuProfiler& profiler );
@@ -116,6 +117,14 @@ namespace DirectCompute
 		void blockStart( eProfilerBlock which );
 		void blockEnd();
 
+		// When recording the timeline, GPU blocks of the current top-level block, in GPU ticks
+		Whisper::ProfileCollection::TraceRing* trace = nullptr;
+		std::vector<Whisper::ProfileCollection::TraceEvent> traceFrame;
+		// CPU timestamp when the top-level block was submitted, and GPU timestamp when it started
+		int64_t traceAnchorTsc = 0;
+		uint64_t traceAnchorGpu = 0;
+		void traceFlush( uint64_t freq );
+
 		Whisper::ProfileCollection& dest;
 #if PROFILER_COLLECT_TAGS
 		uint16_t m_nextTag = 0;
@@ -0,0 +1,102 @@
+#pragma once
+#include "../ComLightLib/streams.h"
+#include "../ComLightLib/comLightServer.h"
+#define WIN32_LEAN_AND_MEAN
+#include <atlfile.h>
+#include <memory>
+
+// Read-only memory mapping of a complete file
+struct MappedFile
+{
+	CAtlFile file;
+	CAtlFileMapping<uint8_t> mapping;
+
+	const uint8_t* data() const { return mapping.GetData(); }
+	size_t size() const { return mapping.GetMappingSize(); }
+};
+
+// Readonly stream implemented over the memory mapping of the file.
+// Besides the stream interface, the loaders can get pointers straight into the mapped file, avoiding the copies.
+class MappedStream : public ComLight::ObjectRoot<ComLight::iReadStream>
+{
+	std::shared_ptr<MappedFile> mapped;
+	const uint8_t* begin = nullptr;
+	int64_t length = 0;
+	int64_t position = 0;
+
+	HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int& lpNumberOfBytesRead ) override final
+	{
+		if( nNumberOfBytesToRead < 0 )
+			return E_INVALIDARG;
+		const int64_t available = std::max( length - position, (int64_t)0 );
+		const int cb = (int)std::min( (int64_t)nNumberOfBytesToRead, available );
+		memcpy( lpBuffer, begin + position, (size_t)cb );
+		position += cb;
+		lpNumberOfBytesRead = cb;
+		return S_OK;
+	}
+	HRESULT COMLIGHTCALL seek( int64_t offset, ComLight::eSeekOrigin origin ) override final
+	{
+		int64_t pos;
+		switch( origin )
+		{
+		case ComLight::eSeekOrigin::Begin:
+			pos = offset;
+			break;
+		case ComLight::eSeekOrigin::Current:
+			pos = position + offset;
+			break;
+		case ComLight::eSeekOrigin::End:
+			pos = length + offset;
+			break;
+		default:
+			return E_INVALIDARG;
+		}
+		if( pos < 0 )
+			return HRESULT_FROM_WIN32( ERROR_NEGATIVE_SEEK );
+		position = pos;
+		return S_OK;
+	}
+	HRESULT COMLIGHTCALL getPosition( int64_t& pos ) override final
+	{
+		pos = position;
+		return S_OK;
+	}
+	HRESULT COMLIGHTCALL getLength( int64_t& len ) override final
+	{
+		len = length;
+		return S_OK;
+	}
+
+public:
+
+	HRESULT open( const wchar_t* path )
+	{
+		if( mapped )
+			return HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+		std::shared_ptr<MappedFile> mf = std::make_shared<MappedFile>();
+		CHECK( mf->file.Create( path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL ) );
+		CHECK( mf->mapping.MapFile( mf->file, 0, 0, PAGE_READONLY, FILE_MAP_READ ) );
+		begin = mf->data();
+		length = (int64_t)mf->size();
+		position = 0;
+		mapped = std::move( mf );
+		return S_OK;
+	}
+
+	// Get pointer to the next `cb` bytes of the file, and advance the stream position past them
+	HRESULT view( size_t cb, const uint8_t*& rsi )
+	{
+		if( position + (int64_t)cb > length )
+			return E_EOF;
+		rsi = begin + position;
+		position += (int64_t)cb;
+		return S_OK;
+	}
+
+	// Pointer to the start of the mapped file
+	const uint8_t* data() const { return begin; }
+
+	// The objects which keep pointers into the mapped file should also keep the mapping alive
+	const std::shared_ptr<MappedFile>& getMapping() const { return mapped; }
+};
\ No newline at end of file
@@ -19,12 +19,96 @@ ProfileCollection::Measure& ProfileCollection::measure( DirectCompute::eComputeS
 	return measures[ key ];
 }
 
-ProfileCollection::Measure& ProfileCollection::measure( eCpuBlock which )
+namespace
 {
-	uint32_t key = (uint8_t)which;
-	key |= 0x10000;
-	CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
-	return measures[ key ];
+	// The slots of the ProfileCollection used last by the thread
+	struct CachedSlots
+	{
+		uint64_t instance = 0;
+		void* slots = nullptr;
+	};
+	thread_local CachedSlots ts_slots;
+
+	std::atomic<uint64_t> s_nextInstance = 1;
+}
+
+ProfileCollection::ThreadSlots& ProfileCollection::threadSlots()
+{
+	const CachedSlots& cached = ts_slots;
+	if( cached.instance == instanceId )
+		return *(ThreadSlots*)cached.slots;
+	return threadSlotsSlow();
+}
+
+ProfileCollection::ThreadSlots& __declspec( noinline ) ProfileCollection::threadSlotsSlow()
+{
+	const DWORD tid = GetCurrentThreadId();
+	ThreadSlots* slots = nullptr;
+	{
+		CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
+		for( const auto& t : threads )
+		{
+			// Thread IDs are reused by the OS, but the previous owner of the slots has exited by then
+			if( t->threadId == tid )
+			{
+				slots = t.get();
+				break;
+			}
+		}
+		if( nullptr == slots )
+		{
+			slots = threads.emplace_back( std::make_unique<ThreadSlots>() ).get();
+			slots->threadId = tid;
+			for( CpuCounter& c : slots->blocks )
+				c.reset();
+			slots->trace.store( nullptr, std::memory_order_relaxed );
+			if( tracing )
+				traceRingStart( slots->traceStorage, slots->trace );
+		}
+	}
+
+	CachedSlots& cached = ts_slots;
+	cached.instance = instanceId;
+	cached.slots = slots;
+	return *slots;
+}
+
+void ProfileCollection::CpuCounter::reset()
+{
+	count.store( 0, std::memory_order_relaxed );
+	totalTicks.store( 0, std::memory_order_relaxed );
+	for( auto& h : histogram )
+		h.store( 0, std::memory_order_relaxed );
+}
+
+uint64_t ProfileCollection::Histogram::bucketStart( size_t i )
+{
+	if( i < 4 )
+		return i;
+	const size_t e = i / 4 + 1;
+	return (uint64_t)( 4 + ( i & 3 ) ) << ( e - 2 );
+}
+
+uint64_t ProfileCollection::Histogram::percentile( double p ) const
+{
+	uint64_t total = 0;
+	for( uint64_t c : buckets )
+		total += c;
+	if( 0 == total )
+		return 0;
+
+	const uint64_t target = std::max( (uint64_t)1, (uint64_t)( p * (double)(int64_t)total ) );
+	uint64_t cumulative = 0;
+	for( size_t i = 0; i < bucketsCount; i++ )
+	{
+		cumulative += buckets[ i ];
+		if( cumulative < target )
+			continue;
+		const uint64_t begin = bucketStart( i );
+		const uint64_t end = ( i + 1 < bucketsCount ) ? bucketStart( i + 1 ) : begin + 1;
+		return ( begin + end - 1 ) / 2;
+	}
+	return bucketStart( bucketsCount - 1 );
 }
 
 #if PROFILER_COLLECT_TAGS
@@ -154,16 +238,25 @@ namespace
 	};
 }
 
-void ProfileCollection::Measure::print( const char* name ) const
+void ProfileCollection::Measure::print( const char* name, const Histogram* hist ) const
 {
 	PrintedTime total{ totalTicks };
 	if( 1 == count )
 		logInfo( u8"%s\t%g %s", name, total.value, total.unit );
-	else
+	else if( nullptr == hist )
 	{
 		PrintedTime avg = (double)totalTicks / (double)(int64_t)count;
 		logInfo( u8"%s\t%g %s, %zu calls, %g %s average", name, total.value, total.unit, count, avg.value, avg.unit );
 	}
+	else
+	{
+		PrintedTime avg = (double)totalTicks / (double)(int64_t)count;
+		PrintedTime p50{ hist->percentile( 0.50 ) };
+		PrintedTime p95{ hist->percentile( 0.95 ) };
+		PrintedTime p99{ hist->percentile( 0.99 ) };
+		logInfo( u8"%s\t%g %s, %zu calls, %g %s average; p50 %g %s, p95 %g %s, p99 %g %s", name, total.value, total.unit, count, avg.value, avg.unit,
+			p50.value, p50.unit, p95.value, p95.unit, p99.value, p99.unit );
+	}
 }
 
 #if PROFILER_COLLECT_TAGS
@@ -192,8 +285,39 @@ void ProfileCollection::TaggedTemp::print() const
 }
 #endif
 
+void ProfileCollection::printCpuBlocks()
+{
+	CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
+	bool haveSection = false;
+	Histogram hist;
+	for( size_t i = 0; i < cpuBlocksCount; i++ )
+	{
+		Measure merged;
+		hist.buckets.fill( 0 );
+		for( const auto& t : threads )
+		{
+			const CpuCounter& c = t->blocks[ i ];
+			merged.count += c.count.load( std::memory_order_relaxed );
+			merged.totalTicks += c.totalTicks.load( std::memory_order_relaxed );
+			for( size_t j = 0; j < Histogram::bucketsCount; j++ )
+				hist.buckets[ j ] += c.histogram[ j ].load( std::memory_order_relaxed );
+		}
+		if( 0 == merged.count )
+			continue;
+
+		if( !haveSection )
+		{
+			printSectionStart( 1 );
+			haveSection = true;
+		}
+		merged.print( printCpuBlock( (uint16_t)i ), &hist );
+	}
+}
+
 void ProfileCollection::print()
 {
+	printCpuBlocks();
+
 	keysTemp.clear();
 	for( POSITION pos = measures.GetStartPosition(); nullptr != pos; )
 	{
@@ -294,14 +418,21 @@ void ProfileCollection::reset()
 {
 	for( POSITION pos = measures.GetStartPosition(); nullptr != pos; )
 		measures.GetNextValue( pos ).reset();
+
+	// The counters being updated concurrently may keep a few of the old values, good enough for the profiler
+	CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
+	for( const auto& t : threads )
+		for( CpuCounter& c : t->blocks )
+			c.reset();
 }
 
-ProfileCollection::ProfileCollection( const WhisperModel& model )
+ProfileCollection::ProfileCollection( const WhisperModel& model ) :
+	instanceId( s_nextInstance++ )
 {
 	const __m128i vals = model.getLoadTimes();
 
 	uint64_t s = (uint64_t)_mm_cvtsi128_si64( vals );
-	measure( eCpuBlock::LoadModel ).add( s );
+	cpuCounter( eCpuBlock::LoadModel ).add( s );
 
 	s = (uint64_t)_mm_extract_epi64( vals, 1 );
 	measure( DirectCompute::eProfilerBlock::LoadModel ).add( s );
@@ -312,6 +443,117 @@ ProfileCollection::ProfileCollection( const WhisperModel& model )
 #endif
 }
 
+void ProfileCollection::traceRingStart( std::unique_ptr<TraceRing>& storage, std::atomic<TraceRing*>& active )
+{
+	if( !storage )
+		storage = std::make_unique<TraceRing>();
+	storage->written.store( 0, std::memory_order_relaxed );
+	active.store( storage.get(), std::memory_order_release );
+}
+
+void ProfileCollection::traceStart()
+{
+	CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
+	traceOrigin = tscNow();
+	for( const auto& t : threads )
+		traceRingStart( t->traceStorage, t->trace );
+	traceRingStart( gpuTraceStorage, gpuTraceRing );
+	tracing = true;
+}
+
+namespace
+{
+	using TraceRing = ProfileCollection::TraceRing;
+	using TraceEvent = ProfileCollection::TraceEvent;
+
+	// Copy events from the ring in chronological order, returns count of the events lost to the overwrites
+	static size_t traceRingCopy( const TraceRing& ring, std::vector<TraceEvent>& rdi )
+	{
+		const size_t written = ring.written.load( std::memory_order_acquire );
+		const size_t count = std::min( written, TraceRing::capacity );
+		rdi.clear();
+		for( size_t i = written - count; i < written; i++ )
+			rdi.push_back( ring.events[ i % TraceRing::capacity ] );
+		return written - count;
+	}
+
+	// Trace event format wants microseconds; the input is in 100-nanosecond ticks
+	static void traceAppendEvent( CStringA& json, const char* name, const char* category, uint32_t tid, uint64_t begin, uint64_t duration )
+	{
+		json.AppendFormat( ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.1f,\"dur\":%.1f}",
+			name, category, GetCurrentProcessId(), tid, (double)(int64_t)begin * 0.1, (double)(int64_t)duration * 0.1 );
+	}
+
+	static void traceAppendThreadName( CStringA& json, uint32_t tid, const char* name )
+	{
+		json.AppendFormat( ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			GetCurrentProcessId(), tid, name );
+	}
+}
+
+HRESULT ProfileCollection::traceSave( const wchar_t* path )
+{
+	if( nullptr == path )
+		return E_POINTER;
+
+	CComCritSecLock<CComAutoCriticalSection> lock{ critSec };
+	if( !tracing )
+	{
+		logError( u8"The timeline recording wasn't started" );
+		return OLE_E_BLANK;
+	}
+	tracing = false;
+	for( const auto& t : threads )
+		t->trace.store( nullptr, std::memory_order_release );
+	gpuTraceRing.store( nullptr, std::memory_order_release );
+
+	CStringA json;
+	json.Format( "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"Whisper\"}}",
+		GetCurrentProcessId() );
+
+	std::vector<TraceEvent> events;
+	CStringA name;
+	for( const auto& t : threads )
+	{
+		if( !t->traceStorage )
+			continue;
+		const size_t lost = traceRingCopy( *t->traceStorage, events );
+		if( events.empty() )
+			continue;
+		if( 0 != lost )
+			logWarning( u8"Timeline of the thread %u overflowed, %zu oldest events were lost", t->threadId, lost );
+
+		name.Format( "CPU thread %u", t->threadId );
+		traceAppendThreadName( json, t->threadId, name );
+		for( const TraceEvent& e : events )
+		{
+			const uint64_t begin = ticksFromTsc( (uint64_t)( e.begin - traceOrigin ) );
+			const uint64_t duration = ticksFromTsc( (uint64_t)( e.end - e.begin ) );
+			traceAppendEvent( json, printCpuBlock( e.block ), "cpu", t->threadId, begin, duration );
+		}
+	}
+
+	if( gpuTraceStorage )
+	{
+		const size_t lost = traceRingCopy( *gpuTraceStorage, events );
+		if( 0 != lost )
+			logWarning( u8"GPU timeline overflowed, %zu oldest events were lost", lost );
+		if( !events.empty() )
+		{
+			// Thread IDs are never zero, using that one for the GPU queue
+			traceAppendThreadName( json, 0, "GPU" );
+			for( const TraceEvent& e : events )
+				traceAppendEvent( json, printGpuBlock( e.block ), "gpu", 0, (uint64_t)e.begin, (uint64_t)( e.end - e.begin ) );
+		}
+	}
+	json += "\n],\n\"displayTimeUnit\":\"ms\"}\n";
+
+	CAtlFile file;
+	CHECK( file.Create( path, GENERIC_WRITE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL ) );
+	CHECK( file.Write( json.GetString(), (DWORD)json.GetLength() ) );
+	return S_OK;
+}
+
 uint16_t ProfileCollection::makeTagId( const char* tag )
 {
 #if PROFILER_COLLECT_TAGS
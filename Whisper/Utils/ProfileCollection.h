@@ -1,5 +1,7 @@
 #pragma once
 #include <atlcoll.h>
+#include <atomic>
+#include <memory>
 #include "CpuProfiler.h"
 
 namespace DirectCompute
@@ -26,12 +28,37 @@ namespace Whisper
 		DecodeStep,
 		DecodeLayer,
 	};
+	constexpr size_t cpuBlocksCount = (size_t)eCpuBlock::DecodeLayer + 1;
 
 	class ProfileCollection
 	{
 	public:
 		ProfileCollection( const WhisperModel& model );
 
+		// Latency histogram with logarithmic buckets, 4 buckets per octave of the 100-nanosecond ticks
+		struct Histogram
+		{
+			// The last bucket also collects everything above 2^41 ticks, about 61 hours
+			static constexpr size_t bucketsCount = 160;
+			std::array<uint64_t, bucketsCount> buckets;
+
+			static inline size_t bucket( uint64_t ticks )
+			{
+				if( ticks < 4 )
+					return (size_t)ticks;
+				unsigned long e;
+				_BitScanReverse64( &e, ticks );
+				const size_t i = ( e - 1 ) * 4 + (size_t)( ( ticks >> ( e - 2 ) ) & 3 );
+				return std::min( i, bucketsCount - 1 );
+			}
+
+			// The smallest value which goes into the bucket
+			static uint64_t bucketStart( size_t i );
+
+			// Approximate value of the percentile, p in [ 0 .. 1 ], at the middle of the bucket
+			uint64_t percentile( double p ) const;
+		};
+
 		struct Measure
 		{
 			size_t count = 0;
@@ -44,7 +71,7 @@ namespace Whisper
 				totalTicks = 0;
 			}
 
-			void print( const char* name ) const;
+			void print( const char* name, const Histogram* hist = nullptr ) const;
 
 			void add( uint64_t val )
 			{
@@ -55,7 +82,6 @@ namespace Whisper
 
 		Measure& measure( DirectCompute::eProfilerBlock which );
 		Measure& measure( DirectCompute::eComputeShader which );
-		Measure& measure( eCpuBlock which );
 #if PROFILER_COLLECT_TAGS
 		Measure& measure( DirectCompute::eComputeShader which, uint16_t tag );
 #endif
@@ -63,19 +89,73 @@ namespace Whisper
 
 		void reset();
 
+		// Counters of a CPU block in the slots of a single thread.
+		// Only the owning thread writes them, the relaxed atomics are for the concurrent reads by print() and reset()
+		struct CpuCounter
+		{
+			std::atomic<uint64_t> count;
+			std::atomic<uint64_t> totalTicks;
+			std::array<std::atomic<uint32_t>, Histogram::bucketsCount> histogram;
+
+			void add( uint64_t ticks )
+			{
+				count.store( count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+				totalTicks.store( totalTicks.load( std::memory_order_relaxed ) + ticks, std::memory_order_relaxed );
+				auto& h = histogram[ Histogram::bucket( ticks ) ];
+				h.store( h.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+			}
+			void reset();
+		};
+
+		// Counters of the calling thread, created on the first use
+		CpuCounter& cpuCounter( eCpuBlock which )
+		{
+			return threadSlots().blocks[ (uint8_t)which ];
+		}
+
+		// A begin/end pair of the timeline
+		struct TraceEvent
+		{
+			// CPU blocks are in TSC clock; GPU blocks are in 100-nanosecond ticks since traceStart()
+			int64_t begin, end;
+			uint16_t block;
+		};
+
+		// Fixed-size ring of the timeline events, when full the oldest ones are overwritten
+		// Only the owning thread writes into the ring, the release store of the counter is for traceSave()
+		struct TraceRing
+		{
+			static constexpr size_t capacity = 0x4000;
+			std::array<TraceEvent, capacity> events;
+			std::atomic<size_t> written;
+
+			void push( uint16_t block, int64_t begin, int64_t end )
+			{
+				const size_t i = written.load( std::memory_order_relaxed );
+				TraceEvent& e = events[ i % capacity ];
+				e.begin = begin;
+				e.end = end;
+				e.block = block;
+				written.store( i + 1, std::memory_order_release );
+			}
+		};
+
 		class CpuRaii
 		{
-			Measure* dest;
+			CpuCounter* dest;
+			TraceRing* trace;
 			const int64_t tsc;
+			const eCpuBlock block;
 
 		public:
-			CpuRaii( Measure& m ) : dest( &m ), tsc( tscNow() )
+			CpuRaii( CpuCounter& m, TraceRing* tr, eCpuBlock which ) : dest( &m ), trace( tr ), tsc( tscNow() ), block( which )
 			{ }
 			CpuRaii( const CpuRaii& ) = delete;
 			CpuRaii( CpuRaii&& that ) noexcept :
-				tsc( that.tsc )
+				tsc( that.tsc ), block( that.block )
 			{
 				dest = that.dest;
+				trace = that.trace;
 				that.dest = nullptr;
 			}
 
@@ -83,20 +163,68 @@ namespace Whisper
 			{
 				if( nullptr != dest )
 				{
-					const int64_t elapsed = tscNow() - tsc;
-					dest->add( ticksFromTsc( elapsed ) );
+					const int64_t now = tscNow();
+					dest->add( ticksFromTsc( now - tsc ) );
+					if( nullptr != trace )
+						trace->push( (uint16_t)block, tsc, now );
 				}
 			}
 		};
 
 		decltype( auto ) cpuBlock( eCpuBlock which )
 		{
-			return CpuRaii{ measure( which ) };
+			ThreadSlots& slots = threadSlots();
+			return CpuRaii{ slots.blocks[ (uint8_t)which ], slots.trace.load( std::memory_order_acquire ), which };
+		}
+
+		// Start recording the timeline of CPU blocks on all threads, and GPU blocks when the GPU profiler is used.
+		// Discards the events recorded by the previous trace.
+		void traceStart();
+
+		// Stop recording, and save the timeline in Chrome trace event JSON format, for chrome://tracing or ui.perfetto.dev
+		// Should be called after the transcribe methods have returned, the events still being recorded may come out garbled.
+		HRESULT traceSave( const wchar_t* path );
+
+		// The ring for GPU blocks, or nullptr when not recording
+		TraceRing* gpuTrace() const
+		{
+			return gpuTraceRing.load( std::memory_order_acquire );
+		}
+
+		// Convert CPU timestamp into 100-nanosecond ticks since traceStart(), for GPU blocks
+		int64_t traceTicks( int64_t tsc ) const
+		{
+			return (int64_t)ticksFromTsc( (uint64_t)( tsc - traceOrigin ) );
 		}
 
 		uint16_t makeTagId( const char* tag );
 
 	private:
+		// Cache-line aligned, so the threads never write into the same cache line
+		struct alignas( 64 ) ThreadSlots
+		{
+			std::array<CpuCounter, cpuBlocksCount> blocks;
+			DWORD threadId;
+			// Non-empty while recording the timeline
+			std::atomic<TraceRing*> trace;
+			std::unique_ptr<TraceRing> traceStorage;
+		};
+		// Unique for the process, unlike the address of the collection. The thread-local cache of the slots is keyed by this ID.
+		const uint64_t instanceId;
+		// Slots of all threads which used this collection, guarded by critSec; merged only when printing
+		std::vector<std::unique_ptr<ThreadSlots>> threads;
+
+		ThreadSlots& threadSlots();
+		ThreadSlots& threadSlotsSlow();
+		void printCpuBlocks();
+
+		// The timeline state is guarded by critSec
+		bool tracing = false;
+		int64_t traceOrigin = 0;
+		std::atomic<TraceRing*> gpuTraceRing = nullptr;
+		std::unique_ptr<TraceRing> gpuTraceStorage;
+		static void traceRingStart( std::unique_ptr<TraceRing>& storage, std::atomic<TraceRing*>& active );
+
 		CAtlMap<uint32_t, Measure> measures;
 		CComAutoCriticalSection critSec;
 #if PROFILER_COLLECT_TAGS
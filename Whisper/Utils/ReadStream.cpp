@@ -0,0 +1,191 @@
+#include "stdafx.h"
+#include "ReadStream.h"
+using Lock = CComCritSecLock<CComAutoCriticalSection>;
+
+ReadStream::ReadStream()
+{
+	InitializeConditionVariable( &wakeConsumer );
+	InitializeConditionVariable( &wakePrefetch );
+}
+
+HRESULT ReadStream::open( const wchar_t* path )
+{
+	if( file )
+		return HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+	CHECK( file.Create( path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN ) );
+
+	ULONGLONG cb;
+	CHECK( file.GetSize( cb ) );
+	length = (int64_t)cb;
+	totalBlocks = ( length + (int64_t)blockSize - 1 ) / (int64_t)blockSize;
+
+	try
+	{
+		buffer = std::make_unique<uint8_t[]>( countBlocks * blockSize );
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	const HANDLE h = CreateThread( nullptr, 0, &threadProcStatic, this, 0, nullptr );
+	if( nullptr == h )
+		return getLastHr();
+	threadHandle.Attach( h );
+	return S_OK;
+}
+
+ReadStream::~ReadStream()
+{
+	if( !threadHandle )
+		return;
+	{
+		Lock lock( m_cs );
+		shuttingDown = true;
+	}
+	WakeAllConditionVariable( &wakePrefetch );
+	WaitForSingleObject( threadHandle, INFINITE );
+}
+
+DWORD __stdcall ReadStream::threadProcStatic( void* lpParameter )
+{
+	setCurrentThreadName( "Whisper.dll Read-ahead Thread" );
+	ReadStream* p = (ReadStream*)lpParameter;
+	p->threadMain();
+	return 0;
+}
+
+void ReadStream::threadMain()
+{
+	EnterCriticalSection( &m_cs.m_sec );
+	while( true )
+	{
+		if( shuttingDown )
+			break;
+
+		const int64_t idx = nextPrefetch;
+		if( idx >= totalBlocks || idx >= windowStart + (int64_t)countBlocks )
+		{
+			// The ring buffer is full, or we have reached the end of the file
+			SleepConditionVariableCS( &wakePrefetch, &m_cs.m_sec, INFINITE );
+			continue;
+		}
+		nextPrefetch = idx + 1;
+
+		Block& block = blocks[ (size_t)( idx % (int64_t)countBlocks ) ];
+		if( block.index == idx )
+			continue;	// Already loaded before the window was moved by a seek
+
+		// The consumer never touches slots outside of the window, safe to write the data without the lock
+		block.index = idx;
+		block.ready = false;
+		LeaveCriticalSection( &m_cs.m_sec );
+
+		const int64_t offset = idx * (int64_t)blockSize;
+		const DWORD cb = (DWORD)std::min( (int64_t)blockSize, length - offset );
+		uint8_t* const rdi = buffer.get() + ( idx % (int64_t)countBlocks ) * blockSize;
+
+		OVERLAPPED ov;
+		memset( &ov, 0, sizeof( ov ) );
+		ov.Offset = (DWORD)offset;
+		ov.OffsetHigh = (DWORD)( offset >> 32 );
+		DWORD bytesRead = 0;
+		HRESULT hr = S_OK;
+		if( !ReadFile( file, rdi, cb, &bytesRead, &ov ) )
+			hr = getLastHr();
+		else if( bytesRead != cb )
+			hr = E_EOF;
+
+		EnterCriticalSection( &m_cs.m_sec );
+		if( block.index == idx )
+		{
+			block.bytes = bytesRead;
+			block.status = hr;
+			block.ready = true;
+		}
+		WakeAllConditionVariable( &wakeConsumer );
+	}
+	LeaveCriticalSection( &m_cs.m_sec );
+}
+
+HRESULT ReadStream::waitForBlock( int64_t index, const Block*& rdi )
+{
+	Lock lock( m_cs );
+	if( index < windowStart || index >= windowStart + (int64_t)countBlocks )
+	{
+		// Seek outside of the window, restart the read-ahead from the new position
+		windowStart = index;
+		nextPrefetch = index;
+		WakeAllConditionVariable( &wakePrefetch );
+	}
+	else if( index > windowStart )
+	{
+		// Release the blocks before this one, the background thread can reuse these slots
+		windowStart = index;
+		nextPrefetch = std::max( nextPrefetch, index );
+		WakeAllConditionVariable( &wakePrefetch );
+	}
+
+	const Block& block = blocks[ (size_t)( index % (int64_t)countBlocks ) ];
+	while( !( block.index == index && block.ready ) )
+		SleepConditionVariableCS( &wakeConsumer, &m_cs.m_sec, INFINITE );
+
+	CHECK( block.status );
+	rdi = &block;
+	return S_OK;
+}
+
+HRESULT COMLIGHTCALL ReadStream::read( void* lpBuffer, int nNumberOfBytesToRead, int& lpNumberOfBytesRead )
+{
+	lpNumberOfBytesRead = 0;
+	if( nNumberOfBytesToRead < 0 )
+		return E_INVALIDARG;
+	if( !file )
+		return OLE_E_BLANK;
+
+	uint8_t* rdi = (uint8_t*)lpBuffer;
+	int64_t remaining = std::min( (int64_t)nNumberOfBytesToRead, std::max( length - position, (int64_t)0 ) );
+	while( remaining > 0 )
+	{
+		const int64_t index = position / (int64_t)blockSize;
+		const Block* block;
+		CHECK( waitForBlock( index, block ) );
+
+		// Copy from the ring buffer, without the lock: the background thread never writes slots in the window
+		const size_t offsetInBlock = (size_t)( position % (int64_t)blockSize );
+		if( offsetInBlock >= block->bytes )
+			return E_EOF;
+		const size_t cb = (size_t)std::min( (int64_t)( block->bytes - offsetInBlock ), remaining );
+		memcpy( rdi, buffer.get() + ( index % (int64_t)countBlocks ) * blockSize + offsetInBlock, cb );
+
+		rdi += cb;
+		position += (int64_t)cb;
+		remaining -= (int64_t)cb;
+		lpNumberOfBytesRead += (int)cb;
+	}
+	return S_OK;
+}
+
+HRESULT COMLIGHTCALL ReadStream::seek( int64_t offset, ComLight::eSeekOrigin origin )
+{
+	int64_t pos;
+	switch( origin )
+	{
+	case ComLight::eSeekOrigin::Begin:
+		pos = offset;
+		break;
+	case ComLight::eSeekOrigin::Current:
+		pos = position + offset;
+		break;
+	case ComLight::eSeekOrigin::End:
+		pos = length + offset;
+		break;
+	default:
+		return E_INVALIDARG;
+	}
+	if( pos < 0 )
+		return HRESULT_FROM_WIN32( ERROR_NEGATIVE_SEEK );
+	// The ring buffer is only moved by the next read
+	position = pos;
+	return S_OK;
+}
\ No newline at end of file
@@ -3,35 +3,71 @@
 #include "../ComLightLib/comLightServer.h"
 #define WIN32_LEAN_AND_MEAN
 #include <atlfile.h>
+#include <atlbase.h>
+#include <array>
+#include <memory>
 
+// Readonly file stream with a read-ahead buffer.
+// A background thread keeps the next few megabytes of the file in flight, while the loaders parse these small header fields from memory.
 class ReadStream : public ComLight::ObjectRoot<ComLight::iReadStream>
 {
 	CAtlFile file;
-	// TODO: implement a buffer in this class, at least 256kb
+	int64_t length = 0;
+	int64_t position = 0;
 
-	HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int& lpNumberOfBytesRead ) override final
-	{
-		return file.Read( lpBuffer, (DWORD)nNumberOfBytesToRead, *(DWORD*)&lpNumberOfBytesRead );
-	}
-	HRESULT COMLIGHTCALL seek( int64_t offset, ComLight::eSeekOrigin origin ) override final
+	static constexpr size_t blockSize = 1u << 20;
+	static constexpr size_t countBlocks = 8;
+
+	// A slot of the ring buffer
+	struct Block
 	{
-		return file.Seek( offset, (uint8_t)origin );
-	}
-	HRESULT COMLIGHTCALL getPosition( int64_t& position ) override final
+		// Index of the file block in this slot, or -1 when the slot is empty
+		int64_t index = -1;
+		// Count of valid bytes in the slot, less than blockSize for the last block of the file
+		uint32_t bytes = 0;
+		// True when the background thread has completed the read
+		bool ready = false;
+		// Status of the read operation
+		HRESULT status = S_OK;
+	};
+	std::array<Block, countBlocks> blocks;
+	// countBlocks * blockSize bytes, block with index `i` is in the slot `i % countBlocks`
+	std::unique_ptr<uint8_t[]> buffer;
+
+	// Index of the first block the consumer still needs; the background thread reads up to countBlocks blocks starting there
+	int64_t windowStart = 0;
+	// Index of the next block to read on the background thread
+	int64_t nextPrefetch = 0;
+	int64_t totalBlocks = 0;
+
+	CComAutoCriticalSection m_cs;
+	CONDITION_VARIABLE wakeConsumer, wakePrefetch;
+	bool shuttingDown = false;
+	CHandle threadHandle;
+
+	static DWORD __stdcall threadProcStatic( void* lpParameter );
+	void threadMain();
+
+	// Move the window of the ring buffer to the specified block, and wait for that block to arrive
+	HRESULT waitForBlock( int64_t index, const Block*& rdi );
+
+	HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int& lpNumberOfBytesRead ) override final;
+	HRESULT COMLIGHTCALL seek( int64_t offset, ComLight::eSeekOrigin origin ) override final;
+	HRESULT COMLIGHTCALL getPosition( int64_t& pos ) override final
 	{
-		return file.GetPosition( *(ULONGLONG*)&position );
+		pos = position;
+		return S_OK;
 	}
-	HRESULT COMLIGHTCALL getLength( int64_t& length ) override final
+	HRESULT COMLIGHTCALL getLength( int64_t& len ) override final
 	{
-		return file.GetSize( *(ULONGLONG*)&length );
+		len = length;
+		return S_OK;
 	}
 
 public:
 
-	HRESULT open( const wchar_t* path )
-	{
-		if( file )
-			return HRESULT_CODE( ERROR_ALREADY_INITIALIZED );
-		return file.Create( path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN );
-	}
+	ReadStream();
+	~ReadStream();
+
+	HRESULT open( const wchar_t* path );
 };
\ No newline at end of file
@@ -11,13 +11,17 @@ namespace Tracing
 	struct sFileHeader
 	{
 		static constexpr uint32_t correctMagic = 0xE6B4A12Du;	// random.org
+		// Version 0 has uncompressed payload, version 1 splits the payload into LZ4-compressed blocks
+		static constexpr uint8_t currentVersion = 1;
 
 		uint32_t magic;
 		uint8_t formatVersion;
 		uint8_t zzPadding;
 		uint16_t cbItem;
 		uint32_t countItems;
-		uint32_t zzPadding2;
+		// Uncompressed size of the payload blocks, all of them except the last one. Zero in version 0.
+		uint32_t cbPayloadBlock;
+		// Size of the payload in the file, in version 1 that's the compressed size including the block headers
 		uint64_t bytesPayload;
 		uint32_t countStrings, bytesStrings;
 	};
@@ -29,6 +33,15 @@ namespace Tracing
 	// These traces can grow large, we can’t afford memory keeping the payload data in memory.
 	// Metadata is tiny compared to payload, we accumulate that in memory, and write to the end of the file when closed.
 
+	// In version 1, the payload is a sequence of blocks, each one starts with this header.
+	// The payloadOffset and payloadSize fields of the items are in the uncompressed stream, the block index is payloadOffset / cbPayloadBlock.
+	struct sPayloadBlock
+	{
+		// When equal to cbUncompressed, the block is stored without compression
+		uint32_t cbCompressed;
+		uint32_t cbUncompressed;
+	};
+
 	enum struct eItemType : uint8_t
 	{
 		Buffer = 1,
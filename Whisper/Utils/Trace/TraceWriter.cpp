@@ -4,6 +4,7 @@
 #include <atlcoll.h>
 #include <atlstr.h>
 #include "TraceStructures.h"
+#include "../LZ4/lz4.h"
 #include "../../ML/Tensor.h"
 #include "../../CPU/Tensor.h"
 #include <Shlobj.h>
@@ -27,9 +28,128 @@ namespace
 		return HRESULT_FROM_WIN32( status );
 	}
 
+	// Double-buffered LZ4 compressor of the payload stream.
+	// The compute thread only copies the payload into one buffer, while a thread pool callback compresses the other one and appends it to the file.
+	class PayloadWriter
+	{
+		CAtlFile* file = nullptr;
+		// Filled by the compute thread
+		std::vector<uint8_t> staging;
+		// Owned by the work callback while it's running
+		std::vector<uint8_t> pending;
+		std::vector<char> compressed;
+		PTP_WORK work = nullptr;
+		// These two fields are written by the callback, the compute thread only reads them after WaitForThreadpoolWorkCallbacks
+		HRESULT status = S_OK;
+		uint64_t bytesWritten = 0;
+
+		static void __stdcall workCallbackStatic( PTP_CALLBACK_INSTANCE Instance, PVOID pv, PTP_WORK Work )
+		{
+			PayloadWriter& pw = *(PayloadWriter*)pv;
+			if( FAILED( pw.status ) )
+				return;
+			pw.status = pw.writePending();
+		}
+
+		HRESULT writePending()
+		{
+			const int cbSource = (int)pending.size();
+			int cb = LZ4_compress_default( (const char*)pending.data(), compressed.data(), cbSource, (int)compressed.size() );
+			if( cb <= 0 )
+				return E_FAIL;
+
+			sPayloadBlock block;
+			block.cbUncompressed = (uint32_t)cbSource;
+			const void* rsi = compressed.data();
+			if( cb >= cbSource )
+			{
+				// Incompressible data, store the block as is
+				cb = cbSource;
+				rsi = pending.data();
+			}
+			block.cbCompressed = (uint32_t)cb;
+
+			CHECK( file->Write( &block, (DWORD)sizeof( block ) ) );
+			CHECK( file->Write( rsi, (DWORD)cb ) );
+			bytesWritten += sizeof( block ) + (uint32_t)cb;
+			return S_OK;
+		}
+
+		// Wait for the previous block, and submit the staging buffer to the thread pool
+		HRESULT flushStaging()
+		{
+			WaitForThreadpoolWorkCallbacks( work, FALSE );
+			CHECK( status );
+			pending.swap( staging );
+			staging.clear();
+			SubmitThreadpoolWork( work );
+			return S_OK;
+		}
+
+	public:
+
+		~PayloadWriter()
+		{
+			if( nullptr != work )
+			{
+				WaitForThreadpoolWorkCallbacks( work, FALSE );
+				CloseThreadpoolWork( work );
+			}
+		}
+
+		HRESULT create( CAtlFile& dest )
+		{
+			file = &dest;
+			staging.reserve( blockSize );
+			pending.reserve( blockSize );
+			compressed.resize( LZ4_COMPRESSBOUND( blockSize ) );
+			work = CreateThreadpoolWork( &workCallbackStatic, this, nullptr );
+			if( nullptr == work )
+				return getLastHr();
+			return S_OK;
+		}
+
+		HRESULT write( const void* rsi, size_t length )
+		{
+			const uint8_t* source = (const uint8_t*)rsi;
+			while( length > 0 )
+			{
+				const size_t cb = std::min( length, blockSize - staging.size() );
+				staging.insert( staging.end(), source, source + cb );
+				source += cb;
+				length -= cb;
+				if( staging.size() == blockSize )
+					CHECK( flushStaging() );
+			}
+			return S_OK;
+		}
+
+		// Write the incomplete last block, and wait for the background work to complete
+		HRESULT close()
+		{
+			if( nullptr == work )
+				return S_FALSE;
+			if( !staging.empty() )
+				CHECK( flushStaging() );
+			WaitForThreadpoolWorkCallbacks( work, FALSE );
+			CloseThreadpoolWork( work );
+			work = nullptr;
+			return status;
+		}
+
+		uint64_t bytesPayload() const
+		{
+			return bytesWritten;
+		}
+
+		// Uncompressed size of the blocks
+		static constexpr uint32_t blockSize = 4 << 20;
+	};
+
 	class TraceFileWriter
 	{
 		CAtlFile file;
+		PayloadWriter payload;
 		// Concatenated strings, including the 0 terminators
 		std::vector<char> stringsData;
 		// Index = string ID, value = start offset into stringsData
@@ -75,7 +195,7 @@ namespace
 			CHECK( file.Seek( 0, SEEK_END ) );
 			offset = 0;
 
-			return S_OK;
+			return payload.create( file );
 		}
 
 		HRESULT buffer( const ItemName& name, const void* rsi, size_t length, eDataType dt )
@@ -83,8 +203,7 @@ namespace
 			sTraceItem& rdi = items.emplace_back();
 			const uint64_t cb = rdi.buffer( offset, length, dt );
 			addString( rdi, name );
-			assert( cb <= UINT_MAX );
-			CHECK( file.Write( rsi, (DWORD)cb ) );
+			CHECK( payload.write( rsi, cb ) );
 			offset += cb;
 			return S_OK;
 		}
@@ -94,8 +213,7 @@ namespace
 			sTraceItem& rdi = items.emplace_back();
 			const uint64_t cb = rdi.tensor( offset, size, strides, dt );
 			addString( rdi, name );
-			assert( cb <= UINT_MAX );
-			CHECK( file.Write( rsi, (DWORD)cb ) );
+			CHECK( payload.write( rsi, cb ) );
 			offset += cb;
 			return S_OK;
 		}
@@ -104,6 +222,7 @@ namespace
 		{
 			if( !file )
 				return S_FALSE;
+			CHECK( payload.close() );
 
 			const uint32_t cbStringsData = (uint32_t)stringsData.size();
 			const uint32_t cbStringsIndex = (uint32_t)( stringsIndex.size() * 4 );
@@ -120,9 +239,11 @@ namespace
 			sFileHeader header;
 			memset( &header, 0, sizeof( header ) );
 			header.magic = header.correctMagic;
+			header.formatVersion = header.currentVersion;
 			header.cbItem = sizeof( sTraceItem );
 			header.countItems = (uint32_t)items.size();
-			header.bytesPayload = offset;
+			header.cbPayloadBlock = PayloadWriter::blockSize;
+			header.bytesPayload = payload.bytesPayload();
 			header.countStrings = (uint32_t)stringsIndex.size();
 			header.bytesStrings = cbStringsData + cbStringsIndex;
 			CHECK( file.Write( &header, sizeof( header ) ) );
@@ -6,7 +6,7 @@
 #include <mfidl.h>
 #include <mfapi.h>
 #include <mfreadwrite.h>
-#include "voiceActivityDetection.h"
+#include "iVoiceDetector.h"
 
 namespace
 {
@@ -86,7 +86,7 @@ namespace
 		AudioBuffer::pfnAppendSamples pfnAppendSamples = nullptr;
 		int64_t pcmStartTime = 0;
 		int64_t nextSampleTime = 0;
-		VAD vad;
+		std::unique_ptr<iVoiceDetector> vad;
 		sFullParams fullParams;
 		ProfileCollection& profiler;
 		iContext* const whisperContext;
@@ -142,7 +142,7 @@ namespace
 			SubmitThreadpoolWork( work );
 			pcmStartTime = nextSampleTime;
 			pcm.clear();
-			vad.clear();
+			vad->clear();
 			return S_OK;
 		}
 
@@ -182,6 +182,7 @@ namespace
 	{
 		// Initialize the MF source reader
 		CHECK( ac->getReader( &reader ) );
+		CHECK( createVoiceDetector( ac->getParams(), vad ) );
 		work = CreateThreadpoolWork( &callbackStatic, this, nullptr );
 		if( nullptr == work )
 			return HRESULT_FROM_WIN32( GetLastError() );
@@ -243,7 +244,7 @@ namespace
 				return S_OK;
 
 			pcm.clear();
-			vad.clear();
+			vad->clear();
 			pcmStartTime = nextSampleTime;
 			return S_OK;
 		}
@@ -391,7 +392,7 @@ namespace
 	size_t Capture::detectVoice()
 	{
 		auto pf = profiler.cpuBlock( eCpuBlock::VAD );
-		return vad.detect( pcm.mono.data(), pcm.mono.size() );
+		return vad->detect( pcm.mono.data(), pcm.mono.size() );
 	}
 }
 
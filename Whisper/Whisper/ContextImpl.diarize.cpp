@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "ContextImpl.h"
+#include "stereoEnergy.h"
 using namespace Whisper;
 
 namespace
@@ -12,45 +13,6 @@ namespace
 		return ( time * 100 ) / 10'000'000;
 	}
 
-	// Compute per-channel sum of std::absf( pcm ) in the specified buffer,
-	// and return left / right numbers in the lower 2 lanes of the SSE vector
-	inline __m128 __vectorcall computeChannelsEnergy( const std::vector<StereoSample>& sourceVector )
-	{
-		// Might be possible to implement way more sophisticated, and precise, version of this function.
-		// For example, compute these 3 metrics with VAD code, and cluster the numbers somehow.
-		// Not doing that currently; instead, replicating the simple version from the whisper.cpp original version.
-
-		const StereoSample* rsi = sourceVector.data();
-		const StereoSample* const rsiEnd = rsi + sourceVector.size();
-		const StereoSample* const rsiEndAligned = rsi + ( sourceVector.size() & ( ~(size_t)1 ) );
-
-		// Move 0x7FFFFFFF to lowest lane of the int32 vector;
-		// unlike float scalars or all vectors, integer scalar constants are in the instruction stream
-		__m128i absMaskInt = _mm_cvtsi32_si128( (int)0x7FFFFFFFu );
-		// Broadcast over the complete vector
-		absMaskInt = _mm_shuffle_epi32( absMaskInt, 0 );
-		// Bitcast to FP32 vector, for _mm_and_ps instruction
-		const __m128 absMask = _mm_castsi128_ps( absMaskInt );
-
-		__m128 acc = _mm_setzero_ps();
-		for( ; rsi < rsiEndAligned; rsi += 2 )
-		{
-			__m128 v = _mm_loadu_ps( (const float*)rsi );
-			v = _mm_and_ps( v, absMask );
-			acc = _mm_add_ps( acc, v );
-		}
-		if( rsi != rsiEnd )
-		{
-			__m128 v = _mm_castpd_ps( _mm_load_sd( (const double*)rsi ) );
-			v = _mm_and_ps( v, absMask );
-			acc = _mm_add_ps( acc, v );
-		}
-
-		// Return acc.xy + acc.zw
-		acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
-		return acc;
-	}
-
 	inline eSpeakerChannel produceResult( const __m128 ev )
 	{
 		// Original code did following:
@@ -93,16 +55,16 @@ HRESULT COMLIGHTCALL ContextImpl::detectSpeaker( const sTimeInterval& time, eSpe
 		return S_OK;
 	}
 
-	// Extract the slice of stereo PCM data
-	HRESULT hr = currentSpectrogram->copyStereoPcm( (size_t)begin, (size_t)len, diarizeBuffer );
-	if( hr == OLE_E_BLANK )
+	// Per-channel energy of the slice, from the prefix sums computed along with the spectrogram
+	const StereoEnergy* const energy = currentSpectrogram->getStereoEnergy();
+	if( nullptr == energy )
 	{
 		result = eSpeakerChannel::NoStereoData;
 		return S_OK;
 	}
-	CHECK( hr );
 
-	const __m128 energyVec = computeChannelsEnergy( diarizeBuffer );
+	__m128 energyVec;
+	CHECK( energy->query( (size_t)begin, (size_t)len, energyVec ) );
 	result = produceResult( energyVec );
 	return S_OK;
 }
\ No newline at end of file
@@ -24,6 +24,8 @@ namespace Whisper
 		HRESULT COMLIGHTCALL getModel( iModel** pp ) override final;
 		HRESULT COMLIGHTCALL timingsPrint() override final;
 		HRESULT COMLIGHTCALL timingsReset() override final;
+		HRESULT COMLIGHTCALL timingsTraceStart() override final;
+		HRESULT COMLIGHTCALL timingsTraceSave( const wchar_t* path ) override final;
 		HRESULT COMLIGHTCALL fullDefaultParams( eSamplingStrategy strategy, sFullParams* rdi ) override final;
 		HRESULT COMLIGHTCALL runFullImpl( const sFullParams& params, const sProgressSink& progress, iSpectrogram& mel );
 		HRESULT COMLIGHTCALL runFull( const sFullParams& params, const iAudioBuffer* buffer ) override final;
@@ -72,7 +74,6 @@ namespace Whisper
 		int defaultThreadsCount() const;
 
 		__m128i getMemoryUse() const;
-		mutable std::vector<StereoSample> diarizeBuffer;
 
 	public:
 
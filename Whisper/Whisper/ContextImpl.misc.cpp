@@ -2,6 +2,7 @@
 #include "ContextImpl.h"
 #include <mfapi.h>
 #include "MelStreamer.h"
+#include "MelCache.h"
 #include "../API/iMediaFoundation.cl.h"
 #include "../Utils/Trace/tracing.h"
 using namespace Whisper;
@@ -187,6 +188,35 @@ HRESULT COMLIGHTCALL ContextImpl::timingsReset()
 	return S_OK;
 }
 
+HRESULT COMLIGHTCALL ContextImpl::timingsTraceStart()
+{
+	try
+	{
+		profiler.traceStart();
+		return S_OK;
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+}
+
+HRESULT COMLIGHTCALL ContextImpl::timingsTraceSave( const wchar_t* path )
+{
+	try
+	{
+		return profiler.traceSave( path );
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+	catch( const CAtlException& ex )
+	{
+		return ex;
+	}
+}
+
 HRESULT COMLIGHTCALL ContextImpl::getResults( eResultFlags flags, iTranscribeResult** pp ) const noexcept
 {
 	if( nullptr == pp )
@@ -364,9 +394,27 @@ HRESULT COMLIGHTCALL ContextImpl::runFull( const sFullParams& params, const iAud
 	CHECK( buffer->getTime( mediaTimeOffset ) );
 
 	auto profCompleteCpu = profiler.cpuBlock( eCpuBlock::RunComplete );
+	MelCache melCache;
+	bool cachedMel = false;
 	{
 		auto p = profiler.cpuBlock( eCpuBlock::Spectrogram );
-		CHECK( spectrogram.pcmToMel( buffer, model.shared->filters, params.cpuThreads ) );
+		if( params.flag( eFullParamsFlags::MelCache ) )
+		{
+			HRESULT hr = melCache.open( buffer, model.shared->filters );
+			if( FAILED( hr ) )
+				logWarningHr( hr, u8"MelCache.open" );
+			cachedMel = ( hr == S_OK );
+		}
+		if( !cachedMel )
+		{
+			CHECK( spectrogram.pcmToMel( buffer, model.shared->filters, params.cpuThreads ) );
+			if( params.flag( eFullParamsFlags::MelCache ) )
+			{
+				HRESULT hr = melCache.store( spectrogram );
+				if( FAILED( hr ) )
+					logWarningHr( hr, u8"MelCache.store" );
+			}
+		}
 	}
 
 	if( params.flag( eFullParamsFlags::TokenTimestamps ) )
@@ -380,6 +428,8 @@ HRESULT COMLIGHTCALL ContextImpl::runFull( const sFullParams& params, const iAud
 	try
 	{
 		sProgressSink progressSink{ nullptr, nullptr };
+		if( cachedMel )
+			return runFullImpl( params, progressSink, melCache );
 		return runFullImpl( params, progressSink, spectrogram );
 	}
 	catch( HRESULT hr )
@@ -0,0 +1,365 @@
+#include "stdafx.h"
+#include "GgufReader.h"
+#include "loaderUtils.h"
+#include "../source/gguf.h"
+using namespace Whisper;
+using ComLight::eSeekOrigin;
+
+namespace
+{
+	// Sanity limits, to fail early on corrupt files instead of allocating gigabytes
+	constexpr uint64_t maxString = 1 << 20;
+	constexpr int64_t maxCount = 1 << 20;
+
+	// Size of the scalar types of GGUF values, 0 for strings and arrays
+	inline size_t scalarSize( uint32_t type )
+	{
+		switch( type )
+		{
+		case GGUF_TYPE_UINT8:
+		case GGUF_TYPE_INT8:
+		case GGUF_TYPE_BOOL:
+			return 1;
+		case GGUF_TYPE_UINT16:
+		case GGUF_TYPE_INT16:
+			return 2;
+		case GGUF_TYPE_UINT32:
+		case GGUF_TYPE_INT32:
+		case GGUF_TYPE_FLOAT32:
+			return 4;
+		case GGUF_TYPE_UINT64:
+		case GGUF_TYPE_INT64:
+		case GGUF_TYPE_FLOAT64:
+			return 8;
+		}
+		return 0;
+	}
+
+	HRESULT readString( ComLight::iReadStream* stm, CStringA& rdi )
+	{
+		uint64_t len;
+		CHECK( readStruct( stm, len ) );
+		if( len > maxString )
+			return E_INVALIDARG;
+		char* const buffer = rdi.GetBufferSetLength( (int)len );
+		const HRESULT hr = readBytes( stm, buffer, (size_t)len );
+		rdi.ReleaseBufferSetLength( (int)len );
+		return FAILED( hr ) ? hr : S_OK;
+	}
+
+	HRESULT skipString( ComLight::iReadStream* stm )
+	{
+		uint64_t len;
+		CHECK( readStruct( stm, len ) );
+		if( len > maxString )
+			return E_INVALIDARG;
+		return stm->seek( (int64_t)len, eSeekOrigin::Current );
+	}
+
+	HRESULT skipArray( ComLight::iReadStream* stm, uint32_t type, uint64_t count )
+	{
+		if( count > (uint64_t)maxCount )
+			return E_INVALIDARG;
+		if( type == GGUF_TYPE_STRING )
+		{
+			for( uint64_t i = 0; i < count; i++ )
+				CHECK( skipString( stm ) );
+			return S_OK;
+		}
+		const size_t cb = scalarSize( type );
+		if( 0 == cb )
+		{
+			logError( u8"GGUF arrays of type %u are not supported", type );
+			return E_INVALIDARG;
+		}
+		return stm->seek( (int64_t)( count * cb ), eSeekOrigin::Current );
+	}
+
+	template<typename T, typename R>
+	inline HRESULT readAs( ComLight::iReadStream* stm, R& rdi )
+	{
+		T val;
+		CHECK( readStruct( stm, val ) );
+		rdi = (R)val;
+		return S_OK;
+	}
+}
+
+HRESULT GgufReader::readKeyValue( ComLight::iReadStream* stm )
+{
+	CStringA key;
+	CHECK( readString( stm, key ) );
+	uint32_t type;
+	CHECK( readStruct( stm, type ) );
+
+	Value v;
+	v.type = type;
+	v.u = 0;
+	HRESULT hr;
+	switch( type )
+	{
+	case GGUF_TYPE_STRING:
+		// None of the string values are used by this library
+		return skipString( stm );
+	case GGUF_TYPE_ARRAY:
+	{
+		uint32_t itemType;
+		uint64_t count;
+		CHECK( readStruct( stm, itemType ) );
+		CHECK( readStruct( stm, count ) );
+		if( key == "tokenizer.ggml.tokens" )
+			return readTokens( stm, itemType, count );
+		return skipArray( stm, itemType, count );
+	}
+	case GGUF_TYPE_UINT8:
+	case GGUF_TYPE_BOOL:
+		hr = readAs<uint8_t>( stm, v.u );
+		break;
+	case GGUF_TYPE_INT8:
+		hr = readAs<int8_t>( stm, v.i );
+		break;
+	case GGUF_TYPE_UINT16:
+		hr = readAs<uint16_t>( stm, v.u );
+		break;
+	case GGUF_TYPE_INT16:
+		hr = readAs<int16_t>( stm, v.i );
+		break;
+	case GGUF_TYPE_UINT32:
+		hr = readAs<uint32_t>( stm, v.u );
+		break;
+	case GGUF_TYPE_INT32:
+		hr = readAs<int32_t>( stm, v.i );
+		break;
+	case GGUF_TYPE_UINT64:
+		hr = readAs<uint64_t>( stm, v.u );
+		break;
+	case GGUF_TYPE_INT64:
+		hr = readAs<int64_t>( stm, v.i );
+		break;
+	case GGUF_TYPE_FLOAT32:
+		hr = readAs<float>( stm, v.f );
+		break;
+	case GGUF_TYPE_FLOAT64:
+		hr = readAs<double>( stm, v.f );
+		break;
+	default:
+		logError( u8"GGUF value \"%s\" has unknown type %u", key.operator LPCSTR(), type );
+		return E_INVALIDARG;
+	}
+	CHECK( hr );
+	values.SetAt( key, v );
+	return S_OK;
+}
+
+HRESULT GgufReader::readTokens( ComLight::iReadStream* stm, uint32_t type, uint64_t count )
+{
+	if( type != GGUF_TYPE_STRING || 0 == count || count > INT_MAX )
+	{
+		logError( u8"GGUF array tokenizer.ggml.tokens is invalid" );
+		return E_INVALIDARG;
+	}
+
+	tokensTable.clear();
+	for( uint64_t i = 0; i < count; i++ )
+	{
+		uint64_t len;
+		CHECK( readStruct( stm, len ) );
+		if( len > maxString )
+			return E_INVALIDARG;
+		const size_t offset = tokensTable.size();
+		tokensTable.resize( offset + (size_t)len + 1 );
+		CHECK( readBytes( stm, &tokensTable[ offset ], (size_t)len ) );
+		tokensTable.back() = '\0';
+	}
+	countTokens = (int)count;
+	return S_OK;
+}
+
+HRESULT GgufReader::readTensorInfo( ComLight::iReadStream* stm, GgufTensorInfo& rdi )
+{
+	CHECK( readString( stm, rdi.name ) );
+
+	uint32_t n_dims;
+	CHECK( readStruct( stm, n_dims ) );
+	if( n_dims < 1 || n_dims > 4 )
+		return E_INVALIDARG;
+	rdi.n_dims = (int)n_dims;
+
+	rdi.ne = { 1, 1, 1, 1 };
+	for( uint32_t i = 0; i < n_dims; i++ )
+	{
+		int64_t ne;
+		CHECK( readStruct( stm, ne ) );
+		if( ne <= 0 || ne > INT_MAX )
+			return E_INVALIDARG;
+		rdi.ne[ i ] = (int)ne;
+	}
+	// GGUF allows 4D tensors, the loaders only handle 3 dimensions; accept the 4-th one when it's trivial
+	if( 1 != rdi.ne[ 3 ] )
+	{
+		logError( u8"Tensor \"%s\" has 4 dimensions, this is not supported", rdi.name.operator LPCSTR() );
+		return E_INVALIDARG;
+	}
+
+	int32_t type;
+	CHECK( readStruct( stm, type ) );
+	rdi.ftype = type;
+
+	uint64_t offset;
+	CHECK( readStruct( stm, offset ) );
+	if( offset > (uint64_t)INT64_MAX / 2 )
+		return E_INVALIDARG;
+	// Relative to the data blob, read() converts to the absolute position
+	rdi.offset = (int64_t)offset;
+	return S_OK;
+}
+
+HRESULT GgufReader::read( ComLight::iReadStream* stm )
+{
+	values.RemoveAll();
+	tensors.clear();
+	tokensTable.clear();
+	countTokens = 0;
+
+	CHECK( readStruct( stm, version ) );
+	// Version 1 had 32-bit counts and string lengths, llama.cpp no longer supports these files either
+	if( version < 2 || version > GGUF_VERSION )
+	{
+		logError( u8"Unsupported GGUF version %u", version );
+		return E_INVALIDARG;
+	}
+
+	int64_t countTensors, countValues;
+	CHECK( readStruct( stm, countTensors ) );
+	CHECK( readStruct( stm, countValues ) );
+	if( countTensors < 0 || countTensors > maxCount || countValues < 0 || countValues > maxCount )
+		return E_INVALIDARG;
+
+	for( int64_t i = 0; i < countValues; i++ )
+		CHECK( readKeyValue( stm ) );
+
+	int align;
+	const HRESULT hr = getInt( GGUF_KEY_GENERAL_ALIGNMENT, align );
+	CHECK( hr );
+	if( S_OK == hr )
+	{
+		if( align <= 0 || 0 != ( align & ( align - 1 ) ) )
+		{
+			logError( u8"GGUF alignment %i is not a power of 2", align );
+			return E_INVALIDARG;
+		}
+		alignment = (uint32_t)align;
+	}
+	else
+		alignment = GGUF_DEFAULT_ALIGNMENT;
+
+	tensors.resize( (size_t)countTensors );
+	for( auto& t : tensors )
+		CHECK( readTensorInfo( stm, t ) );
+
+	// The data blob starts at the next aligned position after the header
+	int64_t dataOffset;
+	CHECK( stm->getPosition( dataOffset ) );
+	const int64_t mask = (int64_t)alignment - 1;
+	dataOffset = ( dataOffset + mask ) & ~mask;
+
+	for( auto& t : tensors )
+	{
+		if( 0 != ( t.offset & mask ) )
+		{
+			logError( u8"GGUF tensor \"%s\" is misaligned", t.name.operator LPCSTR() );
+			return E_INVALIDARG;
+		}
+		t.offset += dataOffset;
+	}
+
+	CHECK( stm->seek( dataOffset, eSeekOrigin::Begin ) );
+	logDebug( u8"GGUF version %u, %zu tensors, %i tokens, alignment %u", version, tensors.size(), countTokens, alignment );
+	return S_OK;
+}
+
+HRESULT GgufReader::getInt( const char* key, int& rdi ) const
+{
+	auto p = values.Lookup( key );
+	if( nullptr == p )
+		return S_FALSE;
+
+	const Value& v = p->m_value;
+	switch( v.type )
+	{
+	case GGUF_TYPE_UINT8:
+	case GGUF_TYPE_BOOL:
+	case GGUF_TYPE_UINT16:
+	case GGUF_TYPE_UINT32:
+	case GGUF_TYPE_UINT64:
+		if( v.u > INT_MAX )
+			return DISP_E_OVERFLOW;
+		rdi = (int)v.u;
+		return S_OK;
+	case GGUF_TYPE_INT8:
+	case GGUF_TYPE_INT16:
+	case GGUF_TYPE_INT32:
+	case GGUF_TYPE_INT64:
+		if( v.i < INT_MIN || v.i > INT_MAX )
+			return DISP_E_OVERFLOW;
+		rdi = (int)v.i;
+		return S_OK;
+	}
+	logError( u8"GGUF value \"%s\" is not an integer", key );
+	return DISP_E_TYPEMISMATCH;
+}
+
+HRESULT GgufReader::getModelParams( sModelParams& rdi ) const
+{
+	struct Entry
+	{
+		const char* key;
+		int sModelParams::* field;
+	};
+	static const Entry entries[] =
+	{
+		{ "whisper.vocab_size", &sModelParams::n_vocab },
+		{ "whisper.audio.context_length", &sModelParams::n_audio_ctx },
+		{ "whisper.audio.embedding_length", &sModelParams::n_audio_state },
+		{ "whisper.audio.head_count", &sModelParams::n_audio_head },
+		{ "whisper.audio.block_count", &sModelParams::n_audio_layer },
+		{ "whisper.audio.mel_count", &sModelParams::n_mels },
+		{ "whisper.text.context_length", &sModelParams::n_text_ctx },
+		{ "whisper.text.embedding_length", &sModelParams::n_text_state },
+		{ "whisper.text.head_count", &sModelParams::n_text_head },
+		{ "whisper.text.block_count", &sModelParams::n_text_layer },
+	};
+
+	for( const Entry& e : entries )
+	{
+		int val;
+		const HRESULT hr = getInt( e.key, val );
+		CHECK( hr );
+		if( S_FALSE == hr || val <= 0 )
+		{
+			logError( u8"GGUF metadata lacks the hyperparameter \"%s\"", e.key );
+			return E_INVALIDARG;
+		}
+		rdi.*e.field = val;
+	}
+
+	// Optional, only used to print the model type
+	int ft;
+	const HRESULT hr = getInt( "general.file_type", ft );
+	CHECK( hr );
+	rdi.f16 = ( S_OK == hr ) ? ft : 1;
+	return S_OK;
+}
+
+HRESULT GgufReader::extractTensor( const char* name, GgufTensorInfo& rdi )
+{
+	for( auto it = tensors.begin(); it != tensors.end(); it++ )
+	{
+		if( it->name != name )
+			continue;
+		rdi = std::move( *it );
+		tensors.erase( it );
+		return S_OK;
+	}
+	return S_FALSE;
+}
\ No newline at end of file
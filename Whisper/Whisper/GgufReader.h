@@ -0,0 +1,69 @@
+#pragma once
+#include <atlstr.h>
+#include <atlcoll.h>
+#include "../../ComLightLib/streams.h"
+#include "sModelParams.h"
+
+namespace Whisper
+{
+	// A tensor from the header of a GGUF file
+	struct GgufTensorInfo
+	{
+		CStringA name;
+		int n_dims = 0;
+		// ggml_type, same values as ftype field of the legacy GGML files
+		int ftype = 0;
+		std::array<int, 4> ne = { 1, 1, 1, 1 };
+		// Absolute position of the payload in the file, aligned by the alignment of that file
+		int64_t offset = 0;
+	};
+
+	// Parser for the header of GGUF model files.
+	// The tensors have the same names as in the legacy GGML files; the hyperparameters and the vocabulary are in the metadata:
+	// whisper.vocab_size, whisper.audio.{ context_length, embedding_length, head_count, block_count, mel_count },
+	// whisper.text.{ context_length, embedding_length, head_count, block_count }, general.file_type, and tokenizer.ggml.tokens array of strings.
+	// The MEL filters are in the FP32 tensor "mel_filters" of shape [ n_fft, n_mel ].
+	class GgufReader
+	{
+		struct Value
+		{
+			uint32_t type = 0;
+			union
+			{
+				uint64_t u;
+				int64_t i;
+				double f;
+			};
+		};
+		CAtlMap<CStringA, Value> values;
+
+		HRESULT readKeyValue( ComLight::iReadStream* stm );
+		HRESULT readTensorInfo( ComLight::iReadStream* stm, GgufTensorInfo& rdi );
+		HRESULT readTokens( ComLight::iReadStream* stm, uint32_t type, uint64_t count );
+
+	public:
+		// "GGUF" in little-endian, the first 4 bytes of these files
+		static constexpr uint32_t magic = 0x46554747;
+
+		uint32_t version = 0;
+		uint32_t alignment = 32;
+		std::vector<GgufTensorInfo> tensors;
+
+		// The tokenizer.ggml.tokens array, as a sequence of NUL-terminated strings
+		std::vector<char> tokensTable;
+		int countTokens = 0;
+
+		// Parse the header of the file; the stream must be positioned right after the magic number.
+		// On success, the stream is positioned at the start of the aligned tensor data blob.
+		HRESULT read( ComLight::iReadStream* stm );
+
+		// Get an integer value from the metadata; returns S_FALSE when the key is missing
+		HRESULT getInt( const char* key, int& rdi ) const;
+
+		// Produce the hyperparameters of the model from the metadata
+		HRESULT getModelParams( sModelParams& rdi ) const;
+
+		// Find the tensor with the specified name, and remove it from the tensors vector; returns S_FALSE if not found
+		HRESULT extractTensor( const char* name, GgufTensorInfo& rdi );
+	};
+}
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "MelCache.h"
+#include "../API/iMediaFoundation.cl.h"
+#include "../Utils/MurmurHash3.h"
+using namespace Whisper;
+
+namespace
+{
+	// "WMEL" in little-endian
+	constexpr uint32_t cacheMagic = 0x4C454D57;
+	// Increment when the layout of the file, or the math of the spectrogram, changes
+	constexpr uint32_t cacheVersion = 1;
+
+	struct alignas( 64 ) sCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		std::array<uint64_t, 2> key;
+		uint32_t countSamples;
+		uint32_t length;
+		uint32_t n_mel;
+	};
+	// The payload is aligned by cache line
+	constexpr size_t dataOffset = sizeof( sCacheHeader );
+	static_assert( dataOffset == 64 );
+
+	// MurmurHash3 API takes int length, hash large buffers in blocks of 256MB and combine
+	constexpr size_t hashBlockBytes = 1u << 28;
+
+	void hashBytes( const void* rsi, size_t cb, uint32_t seed, std::array<uint64_t, 2>& result )
+	{
+		if( cb <= hashBlockBytes )
+		{
+			MurmurHash3_x64_128( rsi, (int)cb, seed, result.data() );
+			return;
+		}
+
+		std::vector<std::array<uint64_t, 2>> blocks;
+		blocks.resize( ( cb + hashBlockBytes - 1 ) / hashBlockBytes );
+		const uint8_t* p = (const uint8_t*)rsi;
+		for( auto& b : blocks )
+		{
+			const size_t len = std::min( cb, hashBlockBytes );
+			MurmurHash3_x64_128( p, (int)len, seed, b.data() );
+			p += len;
+			cb -= len;
+		}
+		MurmurHash3_x64_128( blocks.data(), (int)( blocks.size() * 16 ), seed, result.data() );
+	}
+
+	HRESULT cacheDirectory( CString& dir )
+	{
+		wchar_t buffer[ MAX_PATH + 1 ];
+		const DWORD len = GetTempPathW( MAX_PATH + 1, buffer );
+		if( 0 == len )
+			return getLastHr();
+		dir = buffer;
+		dir += L"WhisperMelCache\\";
+		if( CreateDirectoryW( dir, nullptr ) )
+			return S_OK;
+		const DWORD err = GetLastError();
+		if( err == ERROR_ALREADY_EXISTS )
+			return S_OK;
+		return HRESULT_FROM_WIN32( err );
+	}
+}
+
+HRESULT MelCache::makePath( CString& path ) const
+{
+	CHECK( cacheDirectory( path ) );
+	path.AppendFormat( L"%016llx%016llx.mel", key[ 1 ], key[ 0 ] );
+	return S_OK;
+}
+
+HRESULT MelCache::open( const iAudioBuffer* buffer, const Filters& filters )
+{
+	if( nullptr == buffer )
+		return E_POINTER;
+	const uint32_t samples = buffer->countSamples();
+	if( 0 == samples )
+		return OLE_E_BLANK;
+	countSamples = samples;
+
+	// Spectrogram depends on the PCM and MEL filters of the model; hash both
+	std::array<uint64_t, 2> hashFilters;
+	hashBytes( filters.data, filters.size() * 4, 0, hashFilters );
+	hashBytes( buffer->getPcmMono(), (size_t)samples * 4, (uint32_t)hashFilters[ 0 ], key );
+	key[ 1 ] ^= hashFilters[ 1 ];
+
+	CString path;
+	CHECK( makePath( path ) );
+
+	HRESULT hr = file.Create( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL );
+	if( hr == HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND ) )
+		return S_FALSE;
+	CHECK( hr );
+
+	ULONGLONG cbFile;
+	CHECK( file.GetSize( cbFile ) );
+	if( cbFile < dataOffset )
+	{
+		file.Close();
+		return S_FALSE;
+	}
+
+	CHECK( mapping.MapFile( file, 0, 0, PAGE_READONLY, FILE_MAP_READ ) );
+	const sCacheHeader& header = *(const sCacheHeader*)mapping.GetData();
+	const uint64_t expectedSize = dataOffset + (uint64_t)header.length * N_MEL * 4;
+	if( header.magic != cacheMagic || header.version != cacheVersion || header.n_mel != N_MEL ||
+		header.key != key || header.countSamples != samples || header.length != samples / FFT_STEP ||
+		cbFile != expectedSize )
+	{
+		logWarning16( L"MEL cache file \"%s\" is stale or corrupt, ignoring", path.operator LPCWSTR() );
+		mapping.Unmap();
+		file.Close();
+		return S_FALSE;
+	}
+
+	length = header.length;
+	data = (const float*)( mapping.GetData() + dataOffset );
+
+	const float* const pcmStereo = buffer->getPcmStereo();
+	if( nullptr != pcmStereo )
+		CHECK( stereo.build( pcmStereo, samples ) );
+	else
+		stereo.clear();
+	logDebug16( L"Mapped MEL spectrogram from the cache \"%s\"", path.operator LPCWSTR() );
+	return S_OK;
+}
+
+HRESULT MelCache::store( iSpectrogram& mel ) const
+{
+	if( 0 == countSamples )
+		return OLE_E_BLANK;
+	const size_t len = mel.getLength();
+	if( len > UINT_MAX / ( N_MEL * 4 ) )
+		return DISP_E_OVERFLOW;
+
+	// Spectrogram class has stride = length, i.e. the complete buffer is continuous
+	const float* rsi;
+	size_t stride;
+	CHECK( mel.makeBuffer( 0, len, &rsi, stride ) );
+	if( stride != len )
+		return E_UNEXPECTED;
+
+	sCacheHeader header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = cacheMagic;
+	header.version = cacheVersion;
+	header.key = key;
+	header.countSamples = countSamples;
+	header.length = (uint32_t)len;
+	header.n_mel = N_MEL;
+
+	CString path;
+	CHECK( makePath( path ) );
+	CString tempPath = path;
+	tempPath.AppendFormat( L".%u.tmp", GetCurrentProcessId() );
+
+	{
+		CAtlFile tempFile;
+		CHECK( tempFile.Create( tempPath, GENERIC_WRITE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN ) );
+		HRESULT hr = tempFile.Write( &header, (DWORD)sizeof( header ) );
+		if( SUCCEEDED( hr ) )
+			hr = tempFile.Write( rsi, (DWORD)( len * N_MEL * 4 ) );
+		if( FAILED( hr ) )
+		{
+			tempFile.Close();
+			DeleteFileW( tempPath );
+			return hr;
+		}
+	}
+
+	if( !MoveFileExW( tempPath, path, MOVEFILE_REPLACE_EXISTING ) )
+	{
+		const HRESULT hr = getLastHr();
+		DeleteFileW( tempPath );
+		return hr;
+	}
+	logDebug16( L"Saved MEL spectrogram to the cache \"%s\"", path.operator LPCWSTR() );
+	return S_OK;
+}
\ No newline at end of file
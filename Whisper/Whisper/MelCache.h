@@ -0,0 +1,62 @@
+#pragma once
+#include <atlfile.h>
+#include <atlstr.h>
+#include "iSpectrogram.h"
+#include "WhisperModel.h"
+#include "stereoEnergy.h"
+
+namespace Whisper
+{
+	struct iAudioBuffer;
+
+	// Persistent on-disk cache of normalized MEL spectrograms.
+	// The cache files are keyed by the content hash of the mono PCM, and the hash of the model's MEL filters.
+	// When the file is found, this class implements iSpectrogram directly over the read-only memory mapping of that file, so the runFull method skips the complete frontend.
+	// Used by iContext.runFull method when eFullParamsFlags.MelCache flag is set.
+	class MelCache : public iSpectrogram
+	{
+		// 128-bit key of the cache entry
+		std::array<uint64_t, 2> key = {};
+		// Count of mono samples in the source audio
+		uint32_t countSamples = 0;
+		// Count of MEL columns in the mapped file, 10ms each
+		uint32_t length = 0;
+		// Per-channel energy of the source audio, for the diarization
+		StereoEnergy stereo;
+
+		CAtlFile file;
+		CAtlFileMapping<uint8_t> mapping;
+		const float* data = nullptr;
+
+		HRESULT makeBuffer( size_t off, size_t len, const float** buffer, size_t& stride ) noexcept override final
+		{
+			if( off + len > length )
+				return E_BOUNDS;
+			*buffer = data + off;
+			stride = length;
+			return S_OK;
+		}
+
+		const StereoEnergy* getStereoEnergy() const noexcept override final
+		{
+			return stereo.empty() ? nullptr : &stereo;
+		}
+
+		// Compose the path of the cache file for the current key
+		HRESULT makePath( CString& path ) const;
+
+	public:
+		size_t getLength() const noexcept override final
+		{
+			return length;
+		}
+
+		// Hash the PCM data, and try to map the cached spectrogram
+		// Returns S_OK when the cache entry was found and mapped, S_FALSE when not found.
+		HRESULT open( const iAudioBuffer* buffer, const Filters& filters );
+
+		// Save the spectrogram into the cache, using the key computed by the open() method.
+		// Writes into a temporary file, then renames; that way concurrent processes never map incomplete files.
+		HRESULT store( iSpectrogram& mel ) const;
+	};
+}
\ No newline at end of file
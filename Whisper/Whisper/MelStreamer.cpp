@@ -3,72 +3,91 @@
 #include "../Utils/parallelFor.h"
 using namespace Whisper;
 
+namespace
+{
+	// When the reader doesn't know the length of the stream, diarization is limited to the first hour of the audio
+	constexpr size_t unknownLengthChunks = 100 * 60 * 60;
+	// The length reported by the reader is an estimate; a few extra chunks for the incomplete last one, and the rounding errors
+	constexpr size_t lengthSlackChunks = 64;
+}
+
 MelStreamer::MelStreamer( const Filters& filters, ProfileCollection& prof, const iAudioReader* iar ) :
 	reader( iar ),
 	melContext( filters ),
 	profiler( prof )
-{ }
+{
+	// MelStreamerThread appends these sums on the background thread, while the main thread may query them from the callbacks.
+	// Allocate the fixed-size buffer upfront, it's never reallocated; the chunks which don't fit are not summed.
+	if( reader.outputsStereo() )
+	{
+		const size_t length = reader.getLength();
+		check( stereoEnergy.allocate( ( 0 != length ) ? length + lengthSlackChunks : unknownLengthChunks ) );
+	}
+}
 
 void MelStreamer::dropOldChunks( size_t off )
 {
-	const bool stereo = reader.outputsStereo();
 	for( size_t i = streamStartOffset; i < off; i++ )
-	{
-		queuePcmMono.pop_front();
 		queueMel.pop_front();
-		if( stereo )
-			queuePcmStereo.pop_front();
-	}
 	streamStartOffset = off;
 }
 
-HRESULT MelStreamer::ensurePcmChunks( size_t len )
+HRESULT MelStreamer::loadPcm( size_t first, size_t len, const float*& pcm, size_t& available )
 {
-	if( readerEof )
-		return queuePcmMono.empty() ? E_EOF : S_FALSE;
-
-	const bool loadStereo = reader.outputsStereo();
+	// Drop the PCM we no longer need, MEL chunks before the `first` one are already computed
+	assert( first >= pcmStartOffset );
+	size_t loadedChunks = pcmMono.size() / FFT_STEP;
+	const size_t drop = first - pcmStartOffset;
+	assert( drop <= loadedChunks || readerEof );
+	if( drop > 0 )
+	{
+		const size_t dropChunks = std::min( drop, loadedChunks );
+		pcmMono.erase( pcmMono.begin(), pcmMono.begin() + dropChunks * FFT_STEP );
+		pcmStartOffset = first;
+		loadedChunks -= dropChunks;
+	}
 
 	const size_t neededChunks = len + FFT_SIZE / FFT_STEP;
-	while( true )
+	if( loadedChunks < neededChunks && !readerEof )
 	{
-		if( queuePcmMono.size() >= neededChunks )
-			return S_OK;
-
-		PcmMonoChunk& mono = queuePcmMono.emplace_back();
-		PcmStereoChunk* stereo = loadStereo ? &queuePcmStereo.emplace_back() : nullptr;
-		HRESULT hr = reader.readChunk( mono, stereo );
-		if( SUCCEEDED( hr ) )
-			continue;
-
-		queuePcmMono.pop_back();
-		if( loadStereo )
-			queuePcmStereo.pop_back();
+		// Read all the missing chunks with a single call
+		const size_t missing = neededChunks - loadedChunks;
+		pcmMono.resize( neededChunks * FFT_STEP );
+		float* stereo = nullptr;
+		if( reader.outputsStereo() )
+		{
+			pcmStereo.resize( missing * FFT_STEP * 2 );
+			stereo = pcmStereo.data();
+		}
 
-		if( hr == E_EOF )
+		size_t loaded = 0;
+		const HRESULT hr = reader.readChunks( missing, pcmMono.data() + loadedChunks * FFT_STEP, stereo, loaded );
+		if( FAILED( hr ) && hr != E_EOF )
 		{
-			readerEof = true;
-			return S_FALSE;
+			pcmMono.resize( loadedChunks * FFT_STEP );
+			return hr;
 		}
+		if( loaded < missing )
+			readerEof = true;
 
-		return hr;
+		pcmMono.resize( ( loadedChunks + loaded ) * FFT_STEP );
+		if( nullptr != stereo )
+			for( size_t i = 0; i < loaded; i++ )
+				if( !stereoEnergy.appendChunk( stereo + i * FFT_STEP * 2 ) )
+				{
+					if( !stereoEnergyFull )
+					{
+						stereoEnergyFull = true;
+						logWarning( u8"Stereo energy buffer is full at chunk %zu, diarization is disabled for the rest of the audio", pcmStartOffset + loadedChunks + i );
+					}
+					break;
+				}
+		loadedChunks += loaded;
 	}
-}
-
-size_t MelStreamer::serializePcm( size_t startOffset )
-{
-	const ptrdiff_t chunks = (ptrdiff_t)queuePcmMono.size() - (ptrdiff_t)startOffset;
-	assert( chunks > 0 );
-
-	tempPcm.resize( chunks * FFT_STEP );
-	float* rdi = tempPcm.data();
 
-	for( auto it = queuePcmMono.begin() + startOffset; it != queuePcmMono.end(); it++ )
-	{
-		memcpy( rdi, it->mono.data(), FFT_STEP * 4 );
-		rdi += FFT_STEP;
-	}
-	return chunks;
+	pcm = pcmMono.data();
+	available = loadedChunks;
+	return ( loadedChunks >= neededChunks ) ? S_OK : S_FALSE;
 }
 
 namespace
@@ -198,9 +217,10 @@ HRESULT MelStreamerSimple::makeBuffer( size_t off, size_t len, const float** buf
 	const size_t availableMel = queueMel.size();
 	if( availableMel < len )
 	{
-		CHECK( ensurePcmChunks( len ) );
+		const float* pcm;
+		size_t pcmChunks;
+		CHECK( loadPcm( streamStartOffset + availableMel, len - availableMel, pcm, pcmChunks ) );
 
-		const size_t pcmChunks = serializePcm( availableMel );
 		const size_t missingMelChunks = len - availableMel;
 		size_t i;
 		const size_t loop1 = std::min( missingMelChunks, pcmChunks );
@@ -210,7 +230,7 @@ HRESULT MelStreamerSimple::makeBuffer( size_t off, size_t len, const float** buf
 			{
 				// if( readerEof && i + 1 == loop1 ) __debugbreak();
 				auto& arr = queueMel.emplace_back();
-				const float* sourcePcm = tempPcm.data() + i * FFT_STEP;
+				const float* sourcePcm = pcm + i * FFT_STEP;
 				size_t availableChunks = pcmChunks - i;
 				size_t availableFloats = availableChunks * FFT_STEP;
 				melContext.fft( arr, sourcePcm, availableFloats );
@@ -285,6 +305,8 @@ HRESULT MelStreamerThread::threadMain()
 		// Count of MEL chunks remaining in the whole stream
 		// availableMel of them are already on the queue
 		const ptrdiff_t remainingMel = (ptrdiff_t)getLength() - (ptrdiff_t)streamStartOffset;
+		// Absolute index of the first MEL chunk to compute
+		const size_t firstChunk = streamStartOffset + availableMel;
 		LeaveCriticalSection( &m_cs.m_sec );
 
 		const ptrdiff_t missingChunks = prebufferChunks - availableMel;
@@ -293,8 +315,9 @@ HRESULT MelStreamerThread::threadMain()
 		if( chunks <= 0 )
 			return S_OK; // This thread has produced all chunks of the stream
 
-		CHECK( ensurePcmChunks( availableMel + chunks ) );
-		const size_t pcmChunks = serializePcm( availableMel );
+		const float* pcm;
+		size_t pcmChunks;
+		CHECK( loadPcm( firstChunk, chunks, pcm, pcmChunks ) );
 		if( 0 == pcmChunks )
 			return S_OK;
 
@@ -310,7 +333,7 @@ HRESULT MelStreamerThread::threadMain()
 				for( ptrdiff_t i = 0; i < chunks; i++ )
 				{
 					MelChunk& arr = pendingChunks.emplace_back();
-					const float* sourcePcm = tempPcm.data() + i * FFT_STEP;
+					const float* sourcePcm = pcm + i * FFT_STEP;
 					size_t availableChunks = pcmChunks - i;
 					size_t availableFloats = availableChunks * FFT_STEP;
 					melContext.fft( arr, sourcePcm, availableFloats );
@@ -323,6 +346,8 @@ HRESULT MelStreamerThread::threadMain()
 				int nth = (int)( ( chunks + minChunksPerThread - 1 ) / minChunksPerThread );
 				nth = std::min( nth, this->workerThreads );
 				assert( nth > 1 );
+				this->fftPcm = pcm;
+				this->fftPcmChunks = pcmChunks;
 				this->fftChunks = (int)chunks;
 				this->fftThreads = nth;
 				CHECK( ThreadPoolWork::parallelFor( nth ) );
@@ -359,11 +384,11 @@ HRESULT MelStreamerThread::threadPoolCallback( int ith ) noexcept
 	const int i1 = ( ( ith + 1 ) * chunks ) / nth;
 
 	// Run these FFTs
-	const size_t pcmChunks = tempPcm.size() / FFT_STEP;
+	const size_t pcmChunks = fftPcmChunks;
 	for( int i = i0; i < i1; i++ )
 	{
 		MelChunk& arr = pendingChunks[ i ];
-		const float* sourcePcm = tempPcm.data() + i * FFT_STEP;
+		const float* sourcePcm = fftPcm + i * FFT_STEP;
 		size_t availableChunks = pcmChunks - i;
 		size_t availableFloats = availableChunks * FFT_STEP;
 		ctx.fft( arr, sourcePcm, availableFloats );
@@ -490,45 +515,4 @@ MelStreamerThread::~MelStreamerThread()
 	if( res == WAIT_OBJECT_0 )
 		return;
 	// TODO: log a warning
-}
-
-HRESULT MelStreamer::copyStereoPcm( size_t offset, size_t length, std::vector<StereoSample>& buffer ) const
-{
-	if( queuePcmStereo.empty() )
-		return OLE_E_BLANK;
-
-	if( offset < streamStartOffset )
-	{
-		logError( u8"MelStreamer doesn't support backwards seek" );
-		return E_UNEXPECTED;
-	}
-
-	// Offset relative to the first chunk on the queue
-	const size_t off = offset - streamStartOffset;
-	if( off >= queuePcmStereo.size() )
-		return E_BOUNDS;
-
-	// Resize the output buffer
-	try
-	{
-		buffer.resize( length * FFT_STEP );
-	}
-	catch( const std::bad_alloc& )
-	{
-		return E_OUTOFMEMORY;
-	}
-	StereoSample* rdi = buffer.data();
-
-	// Copy PCM chunks from the queue
-	const size_t lengthToCopy = std::min( length, queuePcmStereo.size() - off );
-	for( size_t i = 0; i < lengthToCopy; i++, rdi += FFT_STEP )
-	{
-		const float* rsi = queuePcmStereo[ i + off ].stereo.data();
-		memcpy( rdi, rsi, 8 * FFT_STEP );
-	}
-	// If needed, write zeros to the tail
-	if( lengthToCopy == length )
-		return S_OK;
-	memset( rdi, 0, ( length - lengthToCopy ) * FFT_STEP );
-	return S_OK;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../MF/PcmReader.h"
 #include "melSpectrogram.h"
 #include "iSpectrogram.h"
+#include "stereoEnergy.h"
 #include <atlbase.h>
 #include "../Utils/parallelFor.h"
 #include "../Utils/ProfileCollection.h"
@@ -16,28 +17,32 @@ namespace Whisper
 	{
 	protected:
 		PcmReader reader;
-		std::deque<PcmMonoChunk> queuePcmMono;
 		using MelChunk = std::array<float, N_MEL>;
 		std::deque<MelChunk> queueMel;
 		size_t streamStartOffset = 0;
-		std::vector<float> tempPcm;
+		// Continuous mono PCM, starting at the chunk pcmStartOffset; the FFT reads straight from this vector.
+		// Only accessed by the thread which produces MEL chunks.
+		std::vector<float> pcmMono;
+		size_t pcmStartOffset = 0;
 		std::vector<float> outputMel;
 		SpectrogramContext melContext;
 		bool readerEof = false;
 		ProfileCollection& profiler;
-		std::deque<PcmStereoChunk> queuePcmStereo;
+		// Temporary buffer for stereo PCM; the stereo audio is only used for the diarization, we only keep per-channel energy of the chunks
+		std::vector<float> pcmStereo;
+		StereoEnergy stereoEnergy;
+		// Set after the stereo energy buffer filled up, and the warning was logged
+		bool stereoEnergyFull = false;
 
 		// If the streamStartOffset value is less than the argument,
-		// remove ( off - streamStartOffset ) chunks from the start of all 3 queues, and advance streamStartOffset to the `off` argument
+		// remove ( off - streamStartOffset ) chunks from the start of the MEL queue, and advance streamStartOffset to the `off` argument
 		void dropOldChunks( size_t off );
 
-		// Ensure PCM queues have enough chunks to generate specified count of MEL chunks
+		// Make continuous mono PCM available for computing `len` MEL chunks, starting at the absolute chunk index `first`.
+		// Discards PCM before the `first` chunk, and reads missing chunks from the reader in bulk.
+		// On output, `pcm` points to the chunk `first`, and `available` is the count of the loaded chunks starting there.
 		// At the end of the stream, the method delivers less chunks then requested and returns S_FALSE
-		HRESULT ensurePcmChunks( size_t len );
-
-		// Copy mono PCM chunks from the queue (starting at the specified element index) into the continuous tempPcm vector
-		// Returns count of chunks copied there.
-		size_t serializePcm( size_t startOffset );
+		HRESULT loadPcm( size_t first, size_t len, const float*& pcm, size_t& available );
 
 		size_t lastBufferEnd = ~(size_t)0;
 		float lastBufferMax = 0.0f;
@@ -45,7 +50,10 @@ namespace Whisper
 
 		size_t getLength() const noexcept override final { return reader.getLength(); }
 
-		HRESULT copyStereoPcm( size_t offset, size_t length, std::vector<StereoSample>& buffer ) const override final;
+		const StereoEnergy* getStereoEnergy() const noexcept override final
+		{
+			return stereoEnergy.empty() ? nullptr : &stereoEnergy;
+		}
 
 	public:
 		MelStreamer( const Filters& filters, ProfileCollection& profiler, const iAudioReader* reader );
@@ -76,6 +84,8 @@ namespace Whisper
 		HRESULT threadMain();
 
 		std::vector<MelChunk> pendingChunks;
+		const float* fftPcm = nullptr;
+		size_t fftPcmChunks = 0;
 		int fftChunks = 0;
 		int fftThreads = 0;
 		std::vector<SpectrogramContext> melContextsWorkers;
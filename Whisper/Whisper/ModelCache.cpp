@@ -0,0 +1,500 @@
+#include "stdafx.h"
+#include "ModelCache.h"
+#include <intrin.h>
+#include "../Utils/MappedStream.h"
+#include "../Utils/MurmurHash3.h"
+#include "../Utils/CpuProfiler.h"
+#include "../D3D/device.h"
+using namespace Whisper;
+
+namespace
+{
+	// "WMDL" in little-endian
+	constexpr uint32_t cacheMagic = 0x4C444D57;
+	// Increment when the layout of the file, or the layout of any tensors, changes
+	constexpr uint32_t cacheVersion = 1;
+
+	// All payloads in the file are aligned by cache line
+	constexpr size_t payloadAlignment = 64;
+
+	// The fingerprint includes the hash of that many bytes at the start of the model file: hyperparameters, MEL filters, and the vocabulary
+	constexpr size_t fingerprintBytes = 1u << 20;
+
+	enum eCacheFlags : uint32_t
+	{
+		// The file has decoder tensors for the hybrid model
+		Hybrid = 1,
+		// The GPU matrices are reshaped into panels
+		ReshapedMatMul = 2,
+	};
+
+	struct alignas( 64 ) sCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		std::array<uint64_t, 2> key;
+		uint64_t cpuFeatures;
+		uint32_t flags;
+		uint32_t countTensors;
+		uint32_t countCpuTensors;
+		uint32_t n_mel, n_fft;
+		int countTokens;
+		sModelParams params;
+		uint64_t filtersOffset;
+		uint64_t vocabOffset;
+		uint64_t vocabBytes;
+		uint64_t tensorsOffset;
+		uint64_t fileSize;
+	};
+
+	// The table of tensors is at the end of the file, the GPU tensors are followed by the CPU tensors of the hybrid model
+	struct sTensorRecord
+	{
+		std::array<uint32_t, 4> ne;
+		std::array<uint32_t, 4> nb;
+		uint32_t dataType;
+		uint32_t countElements;
+		uint64_t offset;
+		uint64_t bytes;
+	};
+
+	// CPUID bits: leaf 1 ECX in the lower half, leaf 7 EBX in the higher half
+	uint64_t getCpuFeatures()
+	{
+		int info[ 4 ];
+		__cpuid( info, 1 );
+		uint64_t res = (uint32_t)info[ 2 ];
+		__cpuidex( info, 7, 0 );
+		res |= (uint64_t)(uint32_t)info[ 1 ] << 32;
+		return res;
+	}
+
+	HRESULT cacheDirectory( CString& dir )
+	{
+		wchar_t buffer[ MAX_PATH + 1 ];
+		const DWORD len = GetTempPathW( MAX_PATH + 1, buffer );
+		if( 0 == len )
+			return getLastHr();
+		dir = buffer;
+		dir += L"WhisperModelCache\\";
+		if( CreateDirectoryW( dir, nullptr ) )
+			return S_OK;
+		const DWORD err = GetLastError();
+		if( err == ERROR_ALREADY_EXISTS )
+			return S_OK;
+		return HRESULT_FROM_WIN32( err );
+	}
+
+	size_t cbElement( DirectCompute::eDataType dt )
+	{
+		switch( dt )
+		{
+		case DirectCompute::eDataType::FP16:
+			return 2;
+		case DirectCompute::eDataType::FP32:
+			return 4;
+		}
+		return 0;
+	}
+
+	inline uint64_t alignUp( uint64_t off )
+	{
+		return ( off + payloadAlignment - 1 ) & ~(uint64_t)( payloadAlignment - 1 );
+	}
+
+	// Enumerate VRAM tensors of the model, in the order they're stored in the cache file.
+	// The set of tensors is the same as populateTensorsMap() in WhisperModel.cpp
+	template<class Buffers, class Fn>
+	HRESULT forEachGpuTensor( Buffers& m, bool hybrid, Fn&& fn )
+	{
+		auto pair = [ & ]( auto& p ) -> HRESULT
+		{
+			CHECK( fn( p.w ) );
+			return fn( p.b );
+		};
+
+		auto& enc = m.enc;
+		CHECK( fn( enc.positionalEmbedding ) );
+		CHECK( pair( enc.conv1 ) );
+		CHECK( pair( enc.conv2 ) );
+		CHECK( pair( enc.lnPost ) );
+		for( auto& layer : enc.layers )
+		{
+			CHECK( pair( layer.mlpLn ) );
+			CHECK( pair( layer.mlp0 ) );
+			CHECK( pair( layer.mlp1 ) );
+			CHECK( pair( layer.attnLn0 ) );
+			CHECK( pair( layer.attnQuery ) );
+			CHECK( fn( layer.attnKey ) );
+			CHECK( pair( layer.attnValue ) );
+			CHECK( pair( layer.attnLn1 ) );
+		}
+
+		auto& dec = m.dec;
+		if( !hybrid )
+		{
+			CHECK( fn( dec.positionalEmbedding ) );
+			CHECK( fn( dec.tokenEmbedding ) );
+			CHECK( pair( dec.ln ) );
+		}
+		for( auto& layer : dec.layers )
+		{
+			CHECK( fn( layer.crossAttnKey ) );
+			CHECK( pair( layer.crossAttnValue ) );
+			if( hybrid )
+				continue;
+			CHECK( pair( layer.mlpLn ) );
+			CHECK( pair( layer.mlp0 ) );
+			CHECK( pair( layer.mlp1 ) );
+			CHECK( pair( layer.attnLn0 ) );
+			CHECK( pair( layer.attnQuery ) );
+			CHECK( fn( layer.attnKey ) );
+			CHECK( pair( layer.attnValue ) );
+			CHECK( pair( layer.attnLn1 ) );
+			CHECK( pair( layer.crossAttnLn0 ) );
+			CHECK( pair( layer.crossAttnQuery ) );
+			CHECK( pair( layer.crossAttnLn1 ) );
+		}
+		return S_OK;
+	}
+
+	// Sequential writer of the cache file, keeps track of the offset
+	class CacheWriter
+	{
+		CAtlFile& file;
+		uint64_t offset = 0;
+		static constexpr size_t maxWrite = 1u << 30;
+
+	public:
+		CacheWriter( CAtlFile& f ) : file( f ) { }
+
+		uint64_t position() const { return offset; }
+
+		HRESULT write( const void* rsi, size_t cb )
+		{
+			const uint8_t* p = (const uint8_t*)rsi;
+			while( cb > 0 )
+			{
+				const size_t chunk = std::min( cb, maxWrite );
+				CHECK( file.Write( p, (DWORD)chunk ) );
+				p += chunk;
+				cb -= chunk;
+				offset += chunk;
+			}
+			return S_OK;
+		}
+
+		// Pad with zeros to the alignment of the payloads
+		HRESULT align()
+		{
+			const size_t padding = (size_t)( alignUp( offset ) - offset );
+			if( 0 == padding )
+				return S_OK;
+			const std::array<uint8_t, payloadAlignment> zeros = {};
+			return write( zeros.data(), padding );
+		}
+	};
+}
+
+HRESULT ModelCache::makePath( CString& path ) const
+{
+	CHECK( cacheDirectory( path ) );
+	path.AppendFormat( L"%016llx%016llx.wmodel", key[ 1 ], key[ 0 ] );
+	return S_OK;
+}
+
+HRESULT Whisper::modelFingerprint( const wchar_t* modelPath, std::array<uint64_t, 2>& hash )
+{
+	CAtlFile file;
+	CHECK( file.Create( modelPath, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING ) );
+
+	struct Fingerprint
+	{
+		ULONGLONG size;
+		FILETIME lastWrite;
+		std::array<uint64_t, 2> hash;
+	};
+	Fingerprint fp;
+	memset( &fp, 0, sizeof( fp ) );
+	CHECK( file.GetSize( fp.size ) );
+	if( !GetFileTime( file, nullptr, nullptr, &fp.lastWrite ) )
+		return getLastHr();
+
+	std::vector<uint8_t> buffer;
+	buffer.resize( (size_t)std::min( fp.size, (ULONGLONG)fingerprintBytes ) );
+	CHECK( file.Read( buffer.data(), (DWORD)buffer.size() ) );
+	MurmurHash3_x64_128( buffer.data(), (int)buffer.size(), 0, fp.hash.data() );
+
+	MurmurHash3_x64_128( &fp, (int)sizeof( fp ), 0, hash.data() );
+	return S_OK;
+}
+
+HRESULT ModelCache::initialize( const wchar_t* modelPath, bool hybridModel )
+{
+	hybrid = hybridModel;
+	return modelFingerprint( modelPath, modelHash );
+}
+
+HRESULT ModelCache::open()
+{
+	mapped = nullptr;
+	cpuFeatures = getCpuFeatures();
+	flags = hybrid ? eCacheFlags::Hybrid : 0;
+	if( DirectCompute::gpuInfo().useReshapedMatMul() )
+		flags |= eCacheFlags::ReshapedMatMul;
+
+	struct KeySource
+	{
+		std::array<uint64_t, 2> modelHash;
+		uint64_t cpuFeatures;
+		uint32_t flags;
+		uint32_t version;
+	};
+	const KeySource ks{ modelHash, cpuFeatures, flags, cacheVersion };
+	MurmurHash3_x64_128( &ks, (int)sizeof( ks ), 0, key.data() );
+
+	CString path;
+	CHECK( makePath( path ) );
+
+	std::shared_ptr<MappedFile> mf = std::make_shared<MappedFile>();
+	HRESULT hr = mf->file.Create( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL );
+	if( hr == HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND ) )
+		return S_FALSE;
+	CHECK( hr );
+
+	ULONGLONG cbFile;
+	CHECK( mf->file.GetSize( cbFile ) );
+	if( cbFile < sizeof( sCacheHeader ) )
+		return S_FALSE;
+
+	CHECK( mf->mapping.MapFile( mf->file, 0, 0, PAGE_READONLY, FILE_MAP_READ ) );
+	const sCacheHeader& header = *(const sCacheHeader*)mf->data();
+	const uint64_t countRecords = (uint64_t)header.countTensors + header.countCpuTensors;
+	const sModelParams& mp = header.params;
+	const bool valid = header.magic == cacheMagic && header.version == cacheVersion &&
+		header.key == key && header.cpuFeatures == cpuFeatures && header.flags == flags &&
+		header.fileSize == cbFile &&
+		mp.n_audio_layer > 0 && mp.n_audio_layer < 0x100 && mp.n_text_layer > 0 && mp.n_text_layer < 0x100 &&
+		header.filtersOffset + (uint64_t)header.n_mel * header.n_fft * 4 <= cbFile &&
+		header.vocabOffset + header.vocabBytes <= cbFile &&
+		header.tensorsOffset + countRecords * sizeof( sTensorRecord ) <= cbFile;
+	if( !valid )
+	{
+		logWarning16( L"Compiled model cache \"%s\" is stale or corrupt, ignoring", path.operator LPCWSTR() );
+		return S_FALSE;
+	}
+
+	mapped = std::move( mf );
+	logDebug16( L"Mapped compiled model from the cache \"%s\"", path.operator LPCWSTR() );
+	return S_OK;
+}
+
+HRESULT ModelCache::load( WhisperModel& model, sLoadModelTimes& times ) const
+{
+	if( !mapped )
+		return OLE_E_BLANK;
+	const uint8_t* const base = mapped->data();
+	const sCacheHeader& header = *(const sCacheHeader*)base;
+	const uint64_t fileSize = header.fileSize;
+
+	CpuProfiler perf;
+	model.parameters = header.params;
+	model.shared = std::make_shared<ModelShared>();
+	ModelShared& shared = *model.shared;
+	shared.mapping = mapped;
+
+	shared.filters.n_mel = header.n_mel;
+	shared.filters.n_fft = header.n_fft;
+	shared.filters.data = (const float*)( base + header.filtersOffset );
+
+	CHECK( shared.vocab.loadTable( (const char*)( base + header.vocabOffset ), (size_t)header.vocabBytes, header.countTokens, header.params.n_vocab ) );
+	times.convert += perf.elapsed();
+
+	const sTensorRecord* rec = (const sTensorRecord*)( base + header.tensorsOffset );
+	auto validate = [ & ]( const sTensorRecord& r ) -> HRESULT
+	{
+		const size_t cb = cbElement( (DirectCompute::eDataType)r.dataType );
+		if( 0 == cb || r.bytes != (uint64_t)cb * r.countElements || r.offset + r.bytes > fileSize )
+		{
+			logError( u8"Compiled model cache is corrupt" );
+			return E_INVALIDARG;
+		}
+		return S_OK;
+	};
+
+	const CpuProfiler perfUpload;
+	const sModelParams& mp = model.parameters;
+	model.tensors.enc.layers.resize( (uint32_t)mp.n_audio_layer );
+	model.tensors.dec.layers.resize( (uint32_t)mp.n_text_layer );
+	uint32_t countTensors = 0;
+	CHECK( forEachGpuTensor( model.tensors, hybrid, [ & ]( DirectCompute::Tensor& t ) -> HRESULT
+		{
+			if( countTensors >= header.countTensors )
+				return E_INVALIDARG;
+			const sTensorRecord& r = rec[ countTensors ];
+			CHECK( validate( r ) );
+			DirectCompute::TensorShape shape;
+			shape.ne = r.ne;
+			shape.nb = r.nb;
+			CHECK( t.createImmutable( (DirectCompute::eDataType)r.dataType, shape, r.countElements, base + r.offset ) );
+			countTensors++;
+			return S_OK;
+		} ) );
+	if( countTensors != header.countTensors )
+		return E_INVALIDARG;
+	times.upload += perfUpload.elapsed();
+
+#if BUILD_HYBRID_VERSION
+	if( hybrid )
+	{
+		CpuCompute::DecoderTensors& dec = shared.hybridTensors;
+		dec.layers.resize( (uint32_t)mp.n_text_layer );
+		uint32_t countCpu = 0;
+		rec += header.countTensors;
+		CHECK( CpuCompute::forEachTensor( dec, [ & ]( CpuCompute::Tensor& t ) -> HRESULT
+			{
+				if( countCpu >= header.countCpuTensors )
+					return E_INVALIDARG;
+				const sTensorRecord& r = rec[ countCpu ];
+				CHECK( validate( r ) );
+				t.ne = r.ne;
+				t.nb = r.nb;
+				t.setType( (DirectCompute::eDataType)r.dataType );
+				// The mapping is read-only, same as the memory protection of the buffer HybridLoader creates
+				t.setDataPointer( const_cast<uint8_t*>( base + r.offset ) );
+				countCpu++;
+				return S_OK;
+			} ) );
+		if( countCpu != header.countCpuTensors )
+			return E_INVALIDARG;
+		dec.setMemoryBuffer( CpuCompute::LargeBuffer{} );
+	}
+#else
+	if( hybrid )
+		return E_NOTIMPL;
+#endif
+
+	constexpr double mulMb = 1.0 / ( 1 << 20 );
+	logDebug( u8"Loaded %u tensors from the compiled model cache, %g MB mapped", header.countTensors + header.countCpuTensors, mulMb * (double)(int64_t)fileSize );
+	return S_OK;
+}
+
+HRESULT ModelCache::store( const WhisperModel& model ) const
+{
+	const ModelShared& shared = *model.shared;
+	std::vector<char> vocab;
+	CHECK( shared.vocab.saveTable( vocab ) );
+
+	sCacheHeader header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = cacheMagic;
+	header.version = cacheVersion;
+	header.key = key;
+	header.cpuFeatures = cpuFeatures;
+	header.flags = flags;
+	header.n_mel = shared.filters.n_mel;
+	header.n_fft = shared.filters.n_fft;
+	header.countTokens = (int)shared.vocab.size();
+	header.params = model.parameters;
+
+	CString path;
+	CHECK( makePath( path ) );
+	CString tempPath = path;
+	tempPath.AppendFormat( L".%u.tmp", GetCurrentProcessId() );
+
+	std::vector<sTensorRecord> records;
+	HRESULT hr;
+	{
+		CAtlFile tempFile;
+		CHECK( tempFile.Create( tempPath, GENERIC_WRITE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN ) );
+		CacheWriter writer{ tempFile };
+
+		// The header is written twice, the second time with the offsets
+		auto writeContent = [ & ]() -> HRESULT
+		{
+			CHECK( writer.write( &header, sizeof( header ) ) );
+
+			header.filtersOffset = writer.position();
+			CHECK( writer.write( shared.filters.data, shared.filters.size() * 4 ) );
+			CHECK( writer.align() );
+
+			header.vocabOffset = writer.position();
+			header.vocabBytes = vocab.size();
+			CHECK( writer.write( vocab.data(), vocab.size() ) );
+			CHECK( writer.align() );
+
+			// GPU tensors are downloaded from VRAM, after the reshape
+			std::vector<uint8_t> payload;
+			CHECK( forEachGpuTensor( model.tensors, hybrid, [ & ]( const DirectCompute::Tensor& t ) -> HRESULT
+				{
+					sTensorRecord& r = records.emplace_back();
+					try
+					{
+						r.dataType = (uint32_t)t.getType();
+					}
+					catch( HRESULT code )
+					{
+						return code;
+					}
+					const size_t cb = cbElement( (DirectCompute::eDataType)r.dataType );
+					if( 0 == cb )
+						return E_NOTIMPL;
+					CHECK( t.downloadView( payload ) );
+					r.ne = t.ne;
+					r.nb = t.nb;
+					r.countElements = (uint32_t)( payload.size() / cb );
+					r.offset = writer.position();
+					r.bytes = payload.size();
+					CHECK( writer.write( payload.data(), payload.size() ) );
+					return writer.align();
+				} ) );
+			header.countTensors = (uint32_t)records.size();
+
+#if BUILD_HYBRID_VERSION
+			if( hybrid )
+			{
+				CHECK( CpuCompute::forEachTensor( shared.hybridTensors, [ & ]( const CpuCompute::Tensor& t ) -> HRESULT
+					{
+						sTensorRecord& r = records.emplace_back();
+						r.dataType = (uint32_t)t.type();
+						const size_t cb = cbElement( t.type() );
+						if( 0 == cb )
+							return E_NOTIMPL;
+						r.ne = t.ne;
+						r.nb = t.nb;
+						r.countElements = t.countElements();
+						r.offset = writer.position();
+						r.bytes = (uint64_t)cb * r.countElements;
+						CHECK( writer.write( t.data(), (size_t)r.bytes ) );
+						return writer.align();
+					} ) );
+				header.countCpuTensors = (uint32_t)( records.size() - header.countTensors );
+			}
+#endif
+
+			header.tensorsOffset = writer.position();
+			CHECK( writer.write( records.data(), records.size() * sizeof( sTensorRecord ) ) );
+			header.fileSize = writer.position();
+
+			CHECK( tempFile.Seek( 0, FILE_BEGIN ) );
+			return tempFile.Write( &header, (DWORD)sizeof( header ) );
+		};
+
+		hr = writeContent();
+		if( FAILED( hr ) )
+		{
+			tempFile.Close();
+			DeleteFileW( tempPath );
+			return hr;
+		}
+	}
+
+	if( !MoveFileExW( tempPath, path, MOVEFILE_REPLACE_EXISTING ) )
+	{
+		hr = getLastHr();
+		DeleteFileW( tempPath );
+		return hr;
+	}
+	logDebug16( L"Saved compiled model to the cache \"%s\"", path.operator LPCWSTR() );
+	return S_OK;
+}
\ No newline at end of file
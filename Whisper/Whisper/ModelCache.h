@@ -0,0 +1,49 @@
+#pragma once
+#include <atlstr.h>
+#include <memory>
+#include "WhisperModel.h"
+
+struct MappedFile;
+
+namespace Whisper
+{
+	// Compute 128-bit hash which identifies the model file.
+	// To keep that fast, only hashes the size, modification time, and the first megabyte of the file.
+	HRESULT modelFingerprint( const wchar_t* modelPath, std::array<uint64_t, 2>& hash );
+
+	// Persistent on-disk cache of compiled models.
+	// The cache file keeps everything in the layouts this DLL uses in memory: GPU tensors after the reshape into panels, decoder tensors of the hybrid model aligned for the CPU,
+	// MEL filters, and the complete vocabulary including the extra tokens. Loading from the cache is a memory mapping, validation of the header, and upload of the tensors.
+	// The files are keyed by the model file, CPU features, and the options which affect the layouts of the tensors.
+	// Used by loadGpuModel function when eGpuModelFlags.CompiledCache flag is set.
+	class ModelCache
+	{
+		// Hash of the model file, computed by initialize() method
+		std::array<uint64_t, 2> modelHash = {};
+		// 128-bit key of the cache entry, computed by open() method
+		std::array<uint64_t, 2> key = {};
+		uint64_t cpuFeatures = 0;
+		uint32_t flags = 0;
+		bool hybrid = false;
+		std::shared_ptr<MappedFile> mapped;
+
+		// Compose the path of the cache file for the current key
+		HRESULT makePath( CString& path ) const;
+
+	public:
+		// Compute fingerprint of the model file
+		HRESULT initialize( const wchar_t* modelPath, bool hybrid );
+
+		// Compute the key of the cache entry, and try to map the cache file.
+		// Depends on the options of the GPU, must be called after the device is created.
+		// Returns S_OK when the cache entry was found and mapped, S_FALSE when not found.
+		HRESULT open();
+
+		// Create the model from the mapped cache file
+		HRESULT load( WhisperModel& model, sLoadModelTimes& times ) const;
+
+		// Save the model into the cache, using the key computed by the open() method.
+		// Downloads the tensors from VRAM, writes into a temporary file, then renames.
+		HRESULT store( const WhisperModel& model ) const;
+	};
+}
\ No newline at end of file
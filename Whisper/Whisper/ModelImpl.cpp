@@ -3,7 +3,10 @@
 #include "ContextImpl.h"
 #include <intrin.h>
 #include "../Utils/ReadStream.h"
+#include "../Utils/MappedStream.h"
 #include "../modelFactory.h"
+#include "ModelCache.h"
+#include "SharedModelData.h"
 using namespace Whisper;
 
 void ModelImpl::FinalRelease()
@@ -59,11 +62,55 @@ HRESULT ModelImpl::createClone( const ModelImpl& source )
 	return model.createClone( source.model );
 }
 
-HRESULT ModelImpl::load( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks )
+HRESULT ModelImpl::load( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped, ModelCache* cache,
+	const std::shared_ptr<SharedModelData>& sharedData )
 {
 	auto ts = device.setForCurrentThread();
 	CHECK( device.create( gpuFlags, adapter ) );
-	return model.load( stm, hybrid, callbacks );
+	CHECK( loadImpl( stm, hybrid, callbacks, mapped, cache, sharedData.get() ) );
+
+	if( sharedData )
+	{
+		if( !sharedData->attached() )
+		{
+			HRESULT hr = sharedData->publish( *model.shared );
+			if( FAILED( hr ) )
+				logWarningHr( hr, u8"SharedModelData.publish" );
+		}
+		if( sharedData->attached() )
+			model.shared->segment = sharedData;
+	}
+
+	if( hybrid && 0 != ( gpuFlags & (uint32_t)eGpuModelFlags::LazyResidency ) )
+		CHECK( model.setupResidency() );
+	model.quantizedKvCache = hybrid && 0 != ( gpuFlags & (uint32_t)eGpuModelFlags::QuantizedKvCache );
+	return S_OK;
+}
+
+HRESULT ModelImpl::loadImpl( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped, ModelCache* cache, const SharedModelData* sharedData )
+{
+	if( nullptr == cache )
+		return model.load( stm, hybrid, callbacks, mapped, sharedData );
+
+	HRESULT hr = cache->open();
+	if( S_OK == hr )
+	{
+		hr = model.loadCompiled( *cache, callbacks );
+		if( SUCCEEDED( hr ) )
+			return S_OK;
+		// Discard whatever was loaded, and fall back to the original model file
+		logWarningHr( hr, u8"WhisperModel.loadCompiled" );
+		model = WhisperModel{};
+	}
+	else if( FAILED( hr ) )
+		logWarningHr( hr, u8"ModelCache.open" );
+
+	CHECK( model.load( stm, hybrid, callbacks, mapped ) );
+
+	hr = cache->store( model );
+	if( FAILED( hr ) )
+		logWarningHr( hr, u8"ModelCache.store" );
+	return S_OK;
 }
 
 inline bool hasSse41AndF16C()
@@ -137,8 +184,36 @@ HRESULT __stdcall Whisper::loadGpuModel( const wchar_t* path, const sModelSetup&
 		return ERROR_HV_CPUID_FEATURE_VALIDATION;
 	}
 
+	ModelCache cache;
+	bool compiledCache = 0 != ( setup.flags & (uint32_t)eGpuModelFlags::CompiledCache );
+	if( compiledCache )
+	{
+		HRESULT hr = cache.initialize( path, hybrid );
+		if( FAILED( hr ) )
+		{
+			logWarningHr( hr, u8"ModelCache.initialize" );
+			compiledCache = false;
+		}
+	}
+
+	std::shared_ptr<SharedModelData> sharedData;
+	if( !compiledCache && 0 != ( setup.flags & (uint32_t)eGpuModelFlags::SharedWeights ) )
+	{
+		sharedData = std::make_shared<SharedModelData>();
+		HRESULT hr = sharedData->attach( path, hybrid );
+		if( FAILED( hr ) )
+		{
+			logWarningHr( hr, u8"SharedModelData.attach" );
+			sharedData = nullptr;
+		}
+	}
+
+	bool memoryMapped = 0 != ( setup.flags & (uint32_t)eGpuModelFlags::MemoryMapped );
+	if( hybrid && 0 != ( setup.flags & (uint32_t)eGpuModelFlags::LazyResidency ) )
+		memoryMapped = true;
 	ComLight::Object<ReadStream> stream;
-	HRESULT hr = stream.open( path );
+	ComLight::Object<MappedStream> mappedStream;
+	HRESULT hr = memoryMapped ? mappedStream.open( path ) : stream.open( path );
 	if( FAILED( hr ) )
 	{
 		logError16( L"Unable to open model binary file \"%s\"", path );
@@ -147,7 +222,10 @@ HRESULT __stdcall Whisper::loadGpuModel( const wchar_t* path, const sModelSetup&
 
 	ComLight::CComPtr<ComLight::Object<ModelImpl>> obj;
 	CHECK( ComLight::Object<ModelImpl>::create( obj, setup ) );
-	hr = obj->load( &stream, hybrid, callbacks );
+	if( memoryMapped )
+		hr = obj->load( &mappedStream, hybrid, callbacks, &mappedStream, compiledCache ? &cache : nullptr, sharedData );
+	else
+		hr = obj->load( &stream, hybrid, callbacks, nullptr, compiledCache ? &cache : nullptr, sharedData );
 	if( FAILED( hr ) )
 	{
 		logError16( L"Error loading the model from \"%s\"", path );
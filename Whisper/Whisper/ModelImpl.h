@@ -8,6 +8,8 @@
 namespace Whisper
 {
 	using ComLight::iReadStream;
+	class ModelCache;
+	class SharedModelData;
 
 	class ModelImpl : public ComLight::ObjectRoot<iModel>
 	{
@@ -36,6 +38,23 @@ namespace Whisper
 			return model.shared->vocab.string( token );
 		}
 
+		HRESULT COMLIGHTCALL getWhisperContext( struct whisper_context** pp ) override final
+		{
+			logError( u8"iModel.getWhisperContext is only implemented by the reference CPU model" );
+			return E_NOTIMPL;
+		}
+
+		HRESULT COMLIGHTCALL getLoadStageTimes( sLoadModelTimes& rdi ) override final
+		{
+			rdi = model.getLoadStageTimes();
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL setResidentBudget( uint32_t megabytes ) override final
+		{
+			return model.setResidentBudget( (size_t)megabytes << 20 );
+		}
+
 		static inline std::wstring makeString( const wchar_t* p )
 		{
 			if( p == nullptr )
@@ -60,6 +79,12 @@ namespace Whisper
 
 		void FinalRelease();
 
-		HRESULT load( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks );
+		// When the cache is not nullptr, tries to load the compiled model from there; on cache miss, loads from the stream, and saves the compiled model into the cache
+		// When sharedData is not empty, attaches to the segment, or publishes the loaded model
+		HRESULT load( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped = nullptr, ModelCache* cache = nullptr,
+			const std::shared_ptr<SharedModelData>& sharedData = nullptr );
+
+	private:
+		HRESULT loadImpl( iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped, ModelCache* cache, const SharedModelData* sharedData );
 	};
 }
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "stdafx.h"
+#include "SharedModelData.h"
+#include "ModelCache.h"
+#include "../Utils/MurmurHash3.h"
+using namespace Whisper;
+
+namespace
+{
+	// "WSHM" in little-endian
+	constexpr uint32_t segmentMagic = 0x4D485357;
+	// Increment when the layout of the segment changes; the processes with different versions of the DLL use different segments
+	constexpr uint32_t segmentVersion = 1;
+
+	// Payloads in the segment are aligned by cache line
+	constexpr size_t payloadAlignment = 64;
+
+	struct alignas( 64 ) sSegmentHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		std::array<uint64_t, 2> key;
+		uint32_t n_mel, n_fft;
+		int countTokens;
+		int n_vocab;
+		uint32_t countTensors;
+		// Set to 1 after everything else is written
+		uint32_t ready;
+		uint64_t filtersOffset;
+		uint64_t vocabOffset;
+		uint64_t vocabBytes;
+		uint64_t tensorsOffset;
+		uint64_t totalSize;
+	};
+
+	struct sTensorRecord
+	{
+		std::array<uint32_t, 4> ne;
+		std::array<uint32_t, 4> nb;
+		uint32_t dataType;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t bytes;
+	};
+
+	inline uint64_t alignUp( uint64_t off )
+	{
+		return ( off + payloadAlignment - 1 ) & ~(uint64_t)( payloadAlignment - 1 );
+	}
+
+	inline const sSegmentHeader& header( const uint8_t* view )
+	{
+		return *(const sSegmentHeader*)view;
+	}
+
+	// True when the slice [ offset .. offset + bytes ) is within the size, without integer overflows
+	inline bool inRange( uint64_t offset, uint64_t bytes, uint64_t size )
+	{
+		return offset <= size && bytes <= size - offset;
+	}
+
+	// The section is a named object in the session namespace, any process in the session could have created it.
+	// Validate all offsets and sizes in the segment before using any of them.
+	static bool validateSegment( const uint8_t* view, size_t viewSize, const std::array<uint64_t, 2>& key )
+	{
+		if( viewSize < sizeof( sSegmentHeader ) )
+			return false;
+		const sSegmentHeader& sh = header( view );
+		if( sh.magic != segmentMagic || sh.version != segmentVersion || sh.key != key || 0 == sh.ready )
+			return false;
+
+		const uint64_t size = sh.totalSize;
+		if( size < sizeof( sSegmentHeader ) || size > viewSize )
+			return false;
+		if( !inRange( sh.filtersOffset, (uint64_t)sh.n_mel * sh.n_fft * 4, size ) )
+			return false;
+		if( !inRange( sh.vocabOffset, sh.vocabBytes, size ) )
+			return false;
+		if( !inRange( sh.tensorsOffset, (uint64_t)sh.countTensors * sizeof( sTensorRecord ), size ) )
+			return false;
+
+		const sTensorRecord* rec = (const sTensorRecord*)( view + sh.tensorsOffset );
+		for( uint32_t i = 0; i < sh.countTensors; i++ )
+			if( !inRange( rec[ i ].offset, rec[ i ].bytes, size ) )
+				return false;
+		return true;
+	}
+}
+
+SharedModelData::~SharedModelData()
+{
+	if( nullptr != view )
+	{
+		UnmapViewOfFile( view );
+		view = nullptr;
+	}
+	unlock();
+}
+
+void SharedModelData::unlock()
+{
+	if( mutexLocked )
+	{
+		ReleaseMutex( mutex );
+		mutexLocked = false;
+	}
+}
+
+HRESULT SharedModelData::makeName( CStringW& name, const wchar_t* prefix ) const
+{
+	// The Local\ namespace is per session, creating objects in the Global\ namespace requires SeCreateGlobalPrivilege
+	name.Format( L"Local\\%s-%016llx%016llx", prefix, key[ 1 ], key[ 0 ] );
+	return S_OK;
+}
+
+HRESULT SharedModelData::mapView()
+{
+	const void* pv = MapViewOfFile( section, FILE_MAP_READ, 0, 0, 0 );
+	if( nullptr == pv )
+		return getLastHr();
+
+	MEMORY_BASIC_INFORMATION mbi;
+	if( 0 == VirtualQuery( pv, &mbi, sizeof( mbi ) ) )
+	{
+		const HRESULT hr = getLastHr();
+		UnmapViewOfFile( pv );
+		return hr;
+	}
+	view = (const uint8_t*)pv;
+	viewSize = mbi.RegionSize;
+	return S_OK;
+}
+
+HRESULT SharedModelData::attach( const wchar_t* modelPath, bool hybrid )
+{
+	if( nullptr != view || mutexLocked )
+		return HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+
+	struct KeySource
+	{
+		std::array<uint64_t, 2> fingerprint;
+		uint32_t hybrid;
+		uint32_t version;
+	};
+	KeySource ks;
+	CHECK( modelFingerprint( modelPath, ks.fingerprint ) );
+	ks.hybrid = hybrid ? 1 : 0;
+	ks.version = segmentVersion;
+	MurmurHash3_x64_128( &ks, (int)sizeof( ks ), 0, key.data() );
+
+	CStringW name;
+	CHECK( makeName( name, L"WhisperModelLock" ) );
+	HANDLE h = CreateMutexW( nullptr, FALSE, name );
+	if( nullptr == h )
+		return getLastHr();
+	mutex.Attach( h );
+
+	// When another process is loading the same model, this waits for that process to publish the segment
+	const DWORD wait = WaitForSingleObject( mutex, INFINITE );
+	if( wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED )
+		return getLastHr();
+	mutexLocked = true;
+
+	CHECK( makeName( name, L"WhisperModel" ) );
+	h = OpenFileMappingW( FILE_MAP_READ, FALSE, name );
+	if( nullptr == h )
+	{
+		const DWORD err = GetLastError();
+		if( err == ERROR_FILE_NOT_FOUND )
+			return S_FALSE;	// Keep the mutex locked until publish()
+		unlock();
+		return HRESULT_FROM_WIN32( err );
+	}
+	section.Attach( h );
+	unlock();
+
+	CHECK( mapView() );
+	if( !validateSegment( view, viewSize, key ) )
+	{
+		logWarning16( L"Shared memory segment \"%s\" is incomplete, incompatible or corrupt, ignoring", name.operator LPCWSTR() );
+		UnmapViewOfFile( view );
+		view = nullptr;
+		viewSize = 0;
+		section.Close();
+		return S_FALSE;
+	}
+	logDebug16( L"Attached to the shared model data \"%s\"", name.operator LPCWSTR() );
+	return S_OK;
+}
+
+HRESULT SharedModelData::bindFiltersAndVocab( ModelShared& model ) const
+{
+	if( nullptr == view )
+		return OLE_E_BLANK;
+	const sSegmentHeader& sh = header( view );
+	if( sh.n_mel != model.filters.n_mel || sh.n_fft != model.filters.n_fft )
+		return E_INVALIDARG;
+
+	model.filters.data = (const float*)( view + sh.filtersOffset );
+	model.filters.storage.clear();
+	model.filters.storage.shrink_to_fit();
+
+	return model.vocab.loadTable( (const char*)( view + sh.vocabOffset ), (size_t)sh.vocabBytes, sh.countTokens, sh.n_vocab );
+}
+
+#if BUILD_HYBRID_VERSION
+HRESULT SharedModelData::bindTensors( CpuCompute::DecoderTensors& tensors ) const
+{
+	if( nullptr == view )
+		return OLE_E_BLANK;
+	const sSegmentHeader& sh = header( view );
+	if( 0 == sh.countTensors )
+		return S_FALSE;
+
+	const sTensorRecord* rec = (const sTensorRecord*)( view + sh.tensorsOffset );
+	uint32_t count = 0;
+	CHECK( CpuCompute::forEachTensor( tensors, [ & ]( CpuCompute::Tensor& t ) -> HRESULT
+		{
+			if( count >= sh.countTensors )
+				return E_INVALIDARG;
+			const sTensorRecord& r = rec[ count ];
+			if( r.ne != t.ne || r.dataType != (uint32_t)t.type() )
+			{
+				logError( u8"Shared model data doesn't match the model" );
+				return E_INVALIDARG;
+			}
+			// attach() verified the records are within the segment; also verify the strides don't address past the end of the record
+			const uint64_t cbElement = DirectCompute::elementSize( t.type() );
+			uint64_t lastElement = 0;
+			for( size_t i = 0; i < 4; i++ )
+				if( 0 != r.ne[ i ] )
+					lastElement += (uint64_t)( r.ne[ i ] - 1 ) * r.nb[ i ];
+			if( r.bytes != cbElement * t.countElements() || ( lastElement + 1 ) * cbElement > r.bytes )
+			{
+				logError( u8"Shared model data is corrupt" );
+				return E_INVALIDARG;
+			}
+			t.nb = r.nb;
+			// The view is read-only, same as the memory protection of the buffer HybridLoader creates
+			t.setDataPointer( const_cast<uint8_t*>( view + r.offset ) );
+			count++;
+			return S_OK;
+		} ) );
+	if( count != sh.countTensors )
+		return E_INVALIDARG;
+	tensors.setMemoryBuffer( CpuCompute::LargeBuffer{} );
+	return S_OK;
+}
+#endif
+
+HRESULT SharedModelData::publish( ModelShared& model )
+{
+	if( nullptr != view )
+		return HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+	if( !mutexLocked )
+		return E_UNEXPECTED;
+
+	// Other processes waiting in attach() are released as soon as the segment is complete, or when publishing failed
+	const HRESULT hr = publishImpl( model );
+	unlock();
+	return hr;
+}
+
+HRESULT SharedModelData::publishImpl( ModelShared& model )
+{
+	std::vector<char> vocab;
+	CHECK( model.vocab.saveTable( vocab ) );
+
+	sSegmentHeader sh;
+	memset( &sh, 0, sizeof( sh ) );
+	sh.magic = segmentMagic;
+	sh.version = segmentVersion;
+	sh.key = key;
+	sh.n_mel = model.filters.n_mel;
+	sh.n_fft = model.filters.n_fft;
+	sh.countTokens = (int)model.vocab.size();
+	sh.n_vocab = model.vocab.n_vocab;
+
+	// Compute the layout
+	uint64_t offset = sizeof( sSegmentHeader );
+	sh.filtersOffset = offset;
+	offset = alignUp( offset + model.filters.size() * 4 );
+	sh.vocabOffset = offset;
+	sh.vocabBytes = vocab.size();
+	offset = alignUp( offset + vocab.size() );
+
+	std::vector<sTensorRecord> records;
+#if BUILD_HYBRID_VERSION
+	// When the tensors are memory-mapped from the model file, the OS already shares these pages between processes
+	if( !model.hybridTensors.layers.empty() && !model.mapping )
+	{
+		CHECK( CpuCompute::forEachTensor( model.hybridTensors, [ & ]( const CpuCompute::Tensor& t ) -> HRESULT
+			{
+				sTensorRecord& r = records.emplace_back();
+				memset( &r, 0, sizeof( r ) );
+				r.ne = t.ne;
+				r.nb = t.nb;
+				r.dataType = (uint32_t)t.type();
+				r.bytes = (uint64_t)DirectCompute::elementSize( t.type() ) * t.countElements();
+				return S_OK;
+			} ) );
+		sh.countTensors = (uint32_t)records.size();
+		for( auto& r : records )
+		{
+			r.offset = offset;
+			offset = alignUp( offset + r.bytes );
+		}
+	}
+#endif
+	sh.tensorsOffset = offset;
+	offset += records.size() * sizeof( sTensorRecord );
+	sh.totalSize = offset;
+
+	CStringW name;
+	CHECK( makeName( name, L"WhisperModel" ) );
+	HANDLE h = CreateFileMappingW( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)( offset >> 32 ), (DWORD)offset, name );
+	if( nullptr == h )
+		return getLastHr();
+	section.Attach( h );
+	if( GetLastError() == ERROR_ALREADY_EXISTS )
+	{
+		// Only possible when another process has ignored the mutex
+		section.Close();
+		return HRESULT_FROM_WIN32( ERROR_ALREADY_EXISTS );
+	}
+
+	// Fill the segment with a temporary writable view
+	{
+		uint8_t* const rdi = (uint8_t*)MapViewOfFile( section, FILE_MAP_WRITE, 0, 0, 0 );
+		if( nullptr == rdi )
+		{
+			const HRESULT hr = getLastHr();
+			section.Close();
+			return hr;
+		}
+
+		memcpy( rdi + sh.filtersOffset, model.filters.data, model.filters.size() * 4 );
+		memcpy( rdi + sh.vocabOffset, vocab.data(), vocab.size() );
+#if BUILD_HYBRID_VERSION
+		if( 0 != sh.countTensors )
+		{
+			size_t i = 0;
+			CpuCompute::forEachTensor( model.hybridTensors, [ & ]( const CpuCompute::Tensor& t ) -> HRESULT
+				{
+					const sTensorRecord& r = records[ i++ ];
+					memcpy( rdi + r.offset, t.data(), (size_t)r.bytes );
+					return S_OK;
+				} );
+		}
+#endif
+		memcpy( rdi + sh.tensorsOffset, records.data(), records.size() * sizeof( sTensorRecord ) );
+		sh.ready = 1;
+		memcpy( rdi, &sh, sizeof( sh ) );
+		UnmapViewOfFile( rdi );
+	}
+
+	// Switch this process to the read-only view, and release the private copies
+	CHECK( mapView() );
+	CHECK( bindFiltersAndVocab( model ) );
+#if BUILD_HYBRID_VERSION
+	if( 0 != sh.countTensors )
+		CHECK( bindTensors( model.hybridTensors ) );
+#endif
+
+	constexpr double mulMb = 1.0 / ( 1 << 20 );
+	logDebug16( L"Published shared model data \"%s\", %g MB", name.operator LPCWSTR(), mulMb * (double)(int64_t)sh.totalSize );
+	return S_OK;
+}
\ No newline at end of file
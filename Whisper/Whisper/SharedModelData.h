@@ -0,0 +1,51 @@
+#pragma once
+#include <atlbase.h>
+#include <atlstr.h>
+#include "WhisperModel.h"
+
+namespace Whisper
+{
+	// Named shared memory segment with the immutable system memory data of a model: MEL filters, vocabulary, and the decoder tensors of the hybrid model.
+	// The first process which loads the model publishes the segment, the processes which load the same model later attach to it read-only.
+	// The segment is destroyed by the OS when the last process which uses it releases the model.
+	// Used by loadGpuModel function when eGpuModelFlags.SharedWeights flag is set.
+	class SharedModelData
+	{
+		std::array<uint64_t, 2> key = {};
+		// Named mutex which serializes publishing and attaching; locked from attach() until publish() or the destructor
+		CHandle mutex;
+		bool mutexLocked = false;
+		CHandle section;
+		// Read-only view of the segment
+		const uint8_t* view = nullptr;
+		// Size of the view in bytes, rounded up to pages
+		size_t viewSize = 0;
+
+		HRESULT makeName( CStringW& name, const wchar_t* prefix ) const;
+		void unlock();
+		HRESULT mapView();
+		HRESULT publishImpl( ModelShared& model );
+
+	public:
+		SharedModelData() = default;
+		SharedModelData( const SharedModelData& ) = delete;
+		~SharedModelData();
+
+		// Lock the named mutex for the model, and try to open the existing segment.
+		// Returns S_OK when attached, S_FALSE when the segment doesn't exist yet; in that case the caller should load the model, then call publish()
+		HRESULT attach( const wchar_t* modelPath, bool hybrid );
+
+		bool attached() const { return nullptr != view; }
+
+		// Replace MEL filters and vocabulary of the model with the shared ones
+		HRESULT bindFiltersAndVocab( ModelShared& model ) const;
+
+#if BUILD_HYBRID_VERSION
+		// Point the decoder tensors into the segment; returns S_FALSE if the segment doesn't have the tensors because they're memory-mapped from the model file
+		HRESULT bindTensors( CpuCompute::DecoderTensors& tensors ) const;
+#endif
+
+		// Create the segment with the data of the loaded model, then rebind that model to the segment and release the private copies
+		HRESULT publish( ModelShared& model );
+	};
+}
\ No newline at end of file
@@ -104,17 +104,7 @@ HRESULT Spectrogram::pcmToMel( const iAudioBuffer* buffer, const Filters& filter
 	// DirectCompute::dbgWriteBinaryFile( LR"(C:\Temp\2remove\ML\mel-my.bin)", data.data(), data.size() * 4 );
 	const float* const pcmStereo = buffer->getPcmStereo();
 	if( nullptr != pcmStereo )
-	{
-		try
-		{
-			stereo.resize( countSamples );
-		}
-		catch( const std::bad_alloc& )
-		{
-			return E_OUTOFMEMORY;
-		}
-		memcpy( stereo.data(), pcmStereo, countSamples * 8 );
-	}
+		CHECK( stereo.build( pcmStereo, countSamples ) );
 	else
 		stereo.clear();
 
@@ -137,32 +127,4 @@ void Whisper::computeSignalEnergy( std::vector<float>& result, const iAudioBuffe
 				sum += fabsf( samples[ i + j ] );
 		result[ i ] = sum / ( 2 * hw + 1 );
 	}
-}
-
-HRESULT Spectrogram::copyStereoPcm( size_t offset, size_t length, std::vector<StereoSample>& buffer ) const
-{
-	if( stereo.empty() )
-		return OLE_E_BLANK;
-
-	length *= FFT_STEP;
-	offset *= FFT_STEP;
-	if( offset >= stereo.size() )
-		return E_BOUNDS;
-
-	try
-	{
-		buffer.resize( length );
-	}
-	catch( const std::bad_alloc& )
-	{
-		return E_OUTOFMEMORY;
-	}
-
-	const size_t lengthToCopy = std::min( length, stereo.size() - offset );
-	memcpy( buffer.data(), &stereo[ offset ], lengthToCopy * 8 );
-	if( lengthToCopy == length )
-		return S_OK;
-
-	memset( &buffer[ lengthToCopy ], 0, ( buffer.size() - lengthToCopy ) * 8 );
-	return S_OK;
 }
\ No newline at end of file
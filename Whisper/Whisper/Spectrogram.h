@@ -2,6 +2,7 @@
 #include "WhisperModel.h"
 #include "iSpectrogram.h"
 #include "audioConstants.h"
+#include "stereoEnergy.h"
 
 namespace Whisper
 {
@@ -14,7 +15,7 @@ namespace Whisper
 		uint32_t length = 0;
 		static constexpr uint32_t mel = N_MEL;
 		std::vector<float> data;
-		std::vector<StereoSample> stereo;
+		StereoEnergy stereo;
 
 		HRESULT makeBuffer( size_t off, size_t len, const float** buffer, size_t& stride ) noexcept override final
 		{
@@ -27,7 +28,10 @@ namespace Whisper
 
 		class MelContext;
 
-		HRESULT copyStereoPcm( size_t offset, size_t length, std::vector<StereoSample>& buffer ) const override final;
+		const StereoEnergy* getStereoEnergy() const noexcept override final
+		{
+			return stereo.empty() ? nullptr : &stereo;
+		}
 
 	public:
 		size_t getLength() const noexcept override final
@@ -0,0 +1,247 @@
+#include "stdafx.h"
+#include "TensorReadAhead.h"
+#include "GgufReader.h"
+#include "loaderUtils.h"
+#include "../Utils/MappedStream.h"
+#include "../Utils/CpuProfiler.h"
+using namespace Whisper;
+
+namespace
+{
+	using Lock = CComCritSecLock<CComAutoCriticalSection>;
+
+	// When the queue has that many bytes of payload, the background thread waits for the consumer to catch up
+	constexpr size_t maxQueuedBytes = 64 << 20;
+
+	struct sTensorHeader
+	{
+		int n_dims, length, ftype;
+	};
+
+	// compare signed int32 lanes for a <= b
+	inline __m128i cmple( __m128i a, __m128i b )
+	{
+		__m128i i = _mm_min_epi32( a, b );
+		return _mm_cmpeq_epi32( a, i );
+	}
+
+	inline bool allPositive( const std::array<int, 4>& ne )
+	{
+		const __m128i v = _mm_loadu_si128( ( const __m128i* )ne.data() );
+		const __m128i le = cmple( v, _mm_setzero_si128() );
+		return (bool)_mm_testz_si128( le, le );
+	}
+
+	// Count of bytes the tensor holds in the queue; the memory-mapped payloads don't use any
+	inline size_t queuedSize( const LoadedTensor& t )
+	{
+		return ( t.payload == t.buffer.data() ) ? t.payloadBytes : 0;
+	}
+}
+
+TensorReadAhead::TensorReadAhead( ComLight::iReadStream* stm, MappedStream* mappedStream, Filter&& f, const int64_t* postponed ) :
+	stream( stm ),
+	mapped( mappedStream ),
+	filter( std::move( f ) ),
+	postponedBytes( postponed )
+{
+	InitializeConditionVariable( &wakeConsumer );
+	InitializeConditionVariable( &wakeProducer );
+}
+
+TensorReadAhead::~TensorReadAhead()
+{
+	join();
+}
+
+HRESULT TensorReadAhead::start()
+{
+	if( threadHandle )
+		return HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+	const HANDLE h = CreateThread( nullptr, 0, &threadProcStatic, this, 0, nullptr );
+	if( nullptr == h )
+		return getLastHr();
+	threadHandle.Attach( h );
+	return S_OK;
+}
+
+void TensorReadAhead::join()
+{
+	if( !threadHandle )
+		return;
+	{
+		Lock lock( m_cs );
+		shuttingDown = true;
+	}
+	WakeAllConditionVariable( &wakeProducer );
+	WaitForSingleObject( threadHandle, INFINITE );
+	threadHandle.Close();
+}
+
+DWORD __stdcall TensorReadAhead::threadProcStatic( void* lpParameter )
+{
+	setCurrentThreadName( "Whisper.dll Model Loader Thread" );
+	TensorReadAhead* p = (TensorReadAhead*)lpParameter;
+	HRESULT hr;
+	try
+	{
+		hr = p->threadMain();
+	}
+	catch( HRESULT code )
+	{
+		hr = code;
+	}
+	catch( const std::bad_alloc& )
+	{
+		hr = E_OUTOFMEMORY;
+	}
+	catch( const std::exception& )
+	{
+		hr = E_FAIL;
+	}
+
+	{
+		Lock lock( p->m_cs );
+		p->status = hr;
+		p->completed = true;
+	}
+	WakeAllConditionVariable( &p->wakeConsumer );
+	return (DWORD)hr;
+}
+
+HRESULT TensorReadAhead::readHeader( LoadedTensor& rdi )
+{
+	if( nullptr != tensorList )
+	{
+		if( nextTensor >= tensorList->size() )
+			return S_FALSE;
+		const GgufTensorInfo& info = ( *tensorList )[ nextTensor++ ];
+		rdi.name = info.name;
+		rdi.n_dims = info.n_dims;
+		rdi.ftype = info.ftype;
+		rdi.ne = info.ne;
+		// Seeking makes the rest of the pipeline, including HybridLoader and the memory-mapped views, work unchanged
+		return stream->seek( info.offset, ComLight::eSeekOrigin::Begin );
+	}
+
+	sTensorHeader header;
+	HRESULT hr = readStruct( stream, header );
+	if( hr == E_EOF )
+		return S_FALSE;
+	if( FAILED( hr ) )
+		return hr;
+	if( header.n_dims < 1 || header.n_dims > 3 )
+		return E_INVALIDARG;
+
+	rdi.n_dims = header.n_dims;
+	rdi.ftype = header.ftype;
+	rdi.ne = { 1, 1, 1, 1 };
+	CHECK( readBytes( stream, rdi.ne.data(), header.n_dims * 4 ) );
+	if( !allPositive( rdi.ne ) )
+		return E_INVALIDARG;
+
+	char* nameBuffer = rdi.name.GetBufferSetLength( header.length );
+	hr = readBytes( stream, nameBuffer, header.length );
+	rdi.name.ReleaseBuffer();
+	return FAILED( hr ) ? hr : S_OK;
+}
+
+HRESULT TensorReadAhead::readTensor( LoadedTensor& rdi )
+{
+	while( true )
+	{
+		HRESULT hr = readHeader( rdi );
+		CHECK( hr );
+		if( S_FALSE == hr )
+			return S_FALSE;
+
+		rdi.context = nullptr;
+		rdi.payloadBytes = 0;
+		hr = filter( rdi );
+		CHECK( hr );
+		if( S_FALSE == hr )
+			continue;	// The filter has consumed the payload
+		break;
+	}
+
+	if( nullptr != mapped )
+	{
+		const uint8_t* pointer;
+		CHECK( mapped->view( rdi.payloadBytes, pointer ) );
+		rdi.payload = pointer;
+	}
+	else
+	{
+		rdi.buffer.resize( rdi.payloadBytes );
+		CHECK( readBytes( stream, rdi.buffer.data(), rdi.payloadBytes ) );
+		rdi.payload = rdi.buffer.data();
+	}
+
+	int64_t pos;
+	CHECK( stream->getPosition( pos ) );
+	if( nullptr != postponedBytes )
+		pos -= *postponedBytes;
+	rdi.progressPosition = pos;
+	return S_OK;
+}
+
+HRESULT TensorReadAhead::threadMain()
+{
+	while( true )
+	{
+		std::unique_ptr<LoadedTensor> tensor;
+		{
+			Lock lock( m_cs );
+			while( !shuttingDown && queuedBytes >= maxQueuedBytes )
+				SleepConditionVariableCS( &wakeProducer, &m_cs.m_sec, INFINITE );
+			if( shuttingDown )
+				return S_FALSE;
+			if( !freeList.empty() )
+			{
+				tensor = std::move( freeList.back() );
+				freeList.pop_back();
+			}
+		}
+		if( !tensor )
+			tensor = std::make_unique<LoadedTensor>();
+
+		const CpuProfiler perf;
+		const HRESULT hr = readTensor( *tensor );
+		readTicks += perf.elapsed();
+		CHECK( hr );
+		if( S_FALSE == hr )
+			return S_OK;
+
+		{
+			Lock lock( m_cs );
+			queuedBytes += queuedSize( *tensor );
+			queue.push_back( std::move( tensor ) );
+		}
+		WakeAllConditionVariable( &wakeConsumer );
+	}
+}
+
+HRESULT TensorReadAhead::next( std::unique_ptr<LoadedTensor>& rdi )
+{
+	Lock lock( m_cs );
+	while( true )
+	{
+		if( !queue.empty() )
+		{
+			rdi = std::move( queue.front() );
+			queue.pop_front();
+			queuedBytes -= queuedSize( *rdi );
+			WakeAllConditionVariable( &wakeProducer );
+			return S_OK;
+		}
+		if( completed )
+			return FAILED( status ) ? status : S_FALSE;
+		SleepConditionVariableCS( &wakeConsumer, &m_cs.m_sec, INFINITE );
+	}
+}
+
+void TensorReadAhead::recycle( std::unique_ptr<LoadedTensor>&& tensor )
+{
+	Lock lock( m_cs );
+	freeList.emplace_back( std::move( tensor ) );
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atlstr.h>
+#include <atlbase.h>
+#include "../../ComLightLib/streams.h"
+
+class MappedStream;
+
+namespace Whisper
+{
+	struct GgufTensorInfo;
+
+	// A tensor parsed from the GGML model file
+	struct LoadedTensor
+	{
+		CStringA name;
+		int n_dims = 0;
+		int ftype = 0;
+		std::array<int, 4> ne = { 1, 1, 1, 1 };
+
+		// Set by the filter callback, on the background thread
+		const void* context = nullptr;
+		uint32_t dataType = 0;
+		size_t payloadBytes = 0;
+
+		// The payload points either into the memory-mapped model file, or into the buffer vector
+		const void* payload = nullptr;
+		std::vector<uint8_t> buffer;
+
+		// Stream position after the tensor, minus the postponed bytes; for the progress callback
+		int64_t progressPosition = 0;
+	};
+
+	// Parses the tensors of the model file on a background thread, and reads their payloads ahead of time.
+	// Meanwhile, the thread which created this object uploads the previously parsed tensors to VRAM.
+	class TensorReadAhead
+	{
+	public:
+		// Called on the background thread for every tensor header.
+		// Return S_OK to read the payload of tensor.payloadBytes bytes and queue the tensor,
+		// or S_FALSE when the filter has consumed the payload itself, like HybridLoader does.
+		using Filter = std::function<HRESULT( LoadedTensor& tensor )>;
+
+		TensorReadAhead( ComLight::iReadStream* stm, MappedStream* mapped, Filter&& filter, const int64_t* postponedBytes = nullptr );
+		~TensorReadAhead();
+
+		// GGUF files have the table of tensors in the header; when set, the payloads are located by their offsets instead of parsing the stream.
+		// Must be called before start(), the vector must stay alive until join().
+		void setTensorList( const std::vector<GgufTensorInfo>& list ) { tensorList = &list; }
+
+		HRESULT start();
+
+		// Wait for the next tensor; returns S_FALSE at the end of the stream, or the error status of the background thread
+		HRESULT next( std::unique_ptr<LoadedTensor>& rdi );
+
+		// Give the tensor back, to reuse the memory of the payload buffer
+		void recycle( std::unique_ptr<LoadedTensor>&& tensor );
+
+		// Stop and join the background thread, the caller can then use the stream again
+		void join();
+
+		// Time spent on the background thread parsing and reading, in 100-nanosecond ticks
+		uint64_t readTime() const { return readTicks; }
+
+	private:
+		ComLight::iReadStream* const stream;
+		MappedStream* const mapped;
+		const Filter filter;
+		const int64_t* const postponedBytes;
+		const std::vector<GgufTensorInfo>* tensorList = nullptr;
+		size_t nextTensor = 0;
+
+		CComAutoCriticalSection m_cs;
+		CONDITION_VARIABLE wakeConsumer, wakeProducer;
+		std::deque<std::unique_ptr<LoadedTensor>> queue;
+		std::vector<std::unique_ptr<LoadedTensor>> freeList;
+		// Bytes of payload buffers in the queue
+		size_t queuedBytes = 0;
+		bool completed = false;
+		bool shuttingDown = false;
+		HRESULT status = S_OK;
+		CHandle threadHandle;
+		uint64_t readTicks = 0;
+
+		static DWORD __stdcall threadProcStatic( void* lpParameter );
+		HRESULT threadMain();
+		// Parse the header of the next tensor, leaving the stream at the start of the payload; returns S_FALSE at the end of the stream
+		HRESULT readHeader( LoadedTensor& rdi );
+		// Parse the next tensor; returns S_FALSE at the end of the stream
+		HRESULT readTensor( LoadedTensor& rdi );
+	};
+}
\ No newline at end of file
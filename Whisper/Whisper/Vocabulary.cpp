@@ -105,39 +105,117 @@ HRESULT Vocabulary::load( ComLight::iReadStream* stm, int lengthInHeader )
 		tokens[ i ] = reinterpret_cast<const char*>( offset );
 	}
 
-	n_vocab = lengthInHeader;
+	setLength( lengthInHeader );
+	addMissingTokens( countWords, lengthInHeader );
+	completeBuild();
+	return S_OK;
+}
 
-	if( is_multilingual() )
+void Vocabulary::addMissingTokens( int countWords, int lengthInHeader )
+{
+	for( int i = countWords; i < lengthInHeader; i++ )
 	{
-		token_eot++;
-		token_sot++;
-		token_prev++;
-		token_solm++;
-		token_not++;
-		token_beg++;
-	};
-
-	if( countWords < lengthInHeader )
+		if( i > token_beg )
+			addExtra( i, "[_TT_%i]", i - token_beg );
+		else if( i == token_eot )
+			tokens[ i ] = "[_EOT_]";
+		else if( i == token_sot )
+			tokens[ i ] = "[_SOT_]";
+		else if( i == token_prev )
+			tokens[ i ] = "[_PREV_]";
+		else if( i == token_not )
+			tokens[ i ] = "[_NOT_]";
+		else if( i == token_beg )
+			tokens[ i ] = "[_BEG_]";
+		else
+			addExtra( i, "[_extra_token_%i]", i );
+	}
+}
+
+void Vocabulary::setLength( int lengthInHeader )
+{
+	n_vocab = lengthInHeader;
+
+	// The multilingual models have one more token before the special ones.
+	// Computed from the defaults rather than incremented, this method is also called when the vocabulary is rebound to shared memory.
+	const int offset = is_multilingual() ? 1 : 0;
+	token_eot = 50256 + offset;
+	token_sot = 50257 + offset;
+	token_prev = 50360 + offset;
+	token_solm = 50361 + offset;
+	token_not = 50362 + offset;
+	token_beg = 50363 + offset;
+}
+
+HRESULT Vocabulary::saveTable( std::vector<char>& rdi ) const
+{
+	rdi.clear();
+	try
 	{
-		for( int i = countWords; i < lengthInHeader; i++ )
+		for( const char* s : tokens )
 		{
-			if( i > token_beg )
-				addExtra( i, "[_TT_%i]", i - token_beg );
-			else if( i == token_eot )
-				tokens[ i ] = "[_EOT_]";
-			else if( i == token_sot )
-				tokens[ i ] = "[_SOT_]";
-			else if( i == token_prev )
-				tokens[ i ] = "[_PREV_]";
-			else if( i == token_not )
-				tokens[ i ] = "[_NOT_]";
-			else if( i == token_beg )
-				tokens[ i ] = "[_BEG_]";
-			else
-				addExtra( i, "[_extra_token_%i]", i );
+			const size_t len = strlen( s );
+			rdi.insert( rdi.end(), s, s + len + 1 );
 		}
 	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+	return S_OK;
+}
+
+HRESULT Vocabulary::loadTable( const char* table, size_t cb, int countTokens, int lengthInHeader )
+{
+	if( countTokens <= 0 || countTokens < lengthInHeader || 0 == cb || table[ cb - 1 ] != '\0' )
+		return E_INVALIDARG;
+
+	tokens.clear();
+	stringData.clear();
+	idFromToken.RemoveAll();
+	tokens.resize( (size_t)countTokens );
+
+	const char* rsi = table;
+	const char* const end = table + cb;
+	for( auto& t : tokens )
+	{
+		if( rsi >= end )
+			return E_INVALIDARG;
+		t = rsi;
+		rsi += strlen( rsi ) + 1;
+	}
+
+	setLength( lengthInHeader );
+	completeBuild();
+	return S_OK;
+}
+
+HRESULT Vocabulary::loadStrings( std::vector<char>&& table, int countTokens, int lengthInHeader )
+{
+	if( countTokens <= 0 || lengthInHeader <= 0 || table.empty() || table.back() != '\0' )
+		return E_INVALIDARG;
+
+	tokens.clear();
+	idFromToken.RemoveAll();
+	stringData.swap( table );
+	table.clear();
+
+	const size_t count = (uint32_t)countTokens;
+	tokens.resize( std::max( count, (size_t)lengthInHeader ) );
+
+	// Same as load() method, keep offsets in the tokens vector until completeBuild()
+	size_t offset = 0;
+	const size_t cb = stringData.size();
+	for( size_t i = 0; i < count; i++ )
+	{
+		if( offset >= cb )
+			return E_INVALIDARG;
+		tokens[ i ] = reinterpret_cast<const char*>( offset );
+		offset += strlen( stringData.data() + offset ) + 1;
+	}
 
+	setLength( lengthInHeader );
+	addMissingTokens( countTokens, lengthInHeader );
 	completeBuild();
 	return S_OK;
 }
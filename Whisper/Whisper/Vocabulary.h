@@ -15,6 +15,9 @@ namespace Whisper
 		void addExtra( int index, const char* format, int i );
 
 		void completeBuild();
+		void setLength( int lengthInHeader );
+		// Generate names of the tokens in [ countWords .. lengthInHeader ) interval, missing from the model file
+		void addMissingTokens( int countWords, int lengthInHeader );
 	public:
 		Vocabulary();
 
@@ -22,6 +25,15 @@ namespace Whisper
 
 		HRESULT load( ComLight::iReadStream* stm, int lengthInHeader );
 
+		// Serialize all tokens, including the extra ones, as a sequence of NUL-terminated strings
+		HRESULT saveTable( std::vector<char>& rdi ) const;
+		// Load the table produced by saveTable() method, replacing the current content of this object.
+		// The tokens point straight into that memory, the caller must keep it alive for the lifetime of this object.
+		HRESULT loadTable( const char* table, size_t cb, int countTokens, int lengthInHeader );
+		// Load the tokens from a sequence of NUL-terminated strings, like the tokenizer.ggml.tokens array of GGUF files.
+		// Unlike loadTable(), this method takes ownership of the memory.
+		HRESULT loadStrings( std::vector<char>&& table, int countTokens, int lengthInHeader );
+
 		using id = int;
 
 		id token_eot = 50256;
@@ -8,6 +8,11 @@
 #include "../Utils/CpuProfiler.h"
 #include "../CPU/HybridLoader.h"
 #include "../ML/Reshaper.h"
+#include "../Utils/MappedStream.h"
+#include "TensorReadAhead.h"
+#include "ModelCache.h"
+#include "SharedModelData.h"
+#include "GgufReader.h"
 using namespace Whisper;
 using namespace DirectCompute;
 
@@ -19,6 +24,35 @@ namespace
 		uint32_t n_mel = 0, n_fft = 0;
 	};
 
+	// Load MEL filters from the current position of the stream, the caller sets n_mel and n_fft fields
+	HRESULT loadFilters( Filters& filters, ComLight::iReadStream* stm, MappedStream* mapped )
+	{
+		const size_t len = filters.size();
+		const uint8_t* pointer = nullptr;
+		if( nullptr != mapped )
+			CHECK( mapped->view( len * 4, pointer ) );
+		if( nullptr != pointer && 0 == ( (size_t)pointer % alignof( float ) ) )
+		{
+			filters.data = (const float*)pointer;
+			logDebug( u8"Mapped MEL filters from the model file" );
+		}
+		else
+		{
+			auto& storage = filters.storage;
+			storage.resize( len );
+			if( nullptr != pointer )
+				memcpy( storage.data(), pointer, len * 4 );
+			else
+				CHECK( readBytes( stm, storage.data(), len * 4 ) );
+			filters.data = storage.data();
+
+			const int64_t cb = len * 4;
+			constexpr double mulKb = 1.0 / ( 1 << 10 );
+			logDebug( u8"Loaded MEL filters, %.1f kb RAM", mulKb * cb );
+		}
+		return S_OK;
+	}
+
 	enum struct ePostProcessing : uint8_t
 	{
 		None = 0,
@@ -161,26 +195,68 @@ namespace
 		populateDecodeTensorsMap( map, layersDec, tensors, hybrid );
 	}
 
-	struct sTensorHeader
-	{
-		int n_dims, length, ftype;
-	};
+	inline const char* cstr( const CStringA& s ) { return s; }
 
-	// compare signed int32 lanes for a <= b
-	inline __m128i cmple( __m128i a, __m128i b )
+	// Map GGML ftype to DirectCompute data type, and compute size of the payload
+	HRESULT setTensorType( LoadedTensor& t )
 	{
-		__m128i i = _mm_min_epi32( a, b );
-		return _mm_cmpeq_epi32( a, i );
-	}
+		DirectCompute::eDataType dt;
+		size_t cbElement;
 
-	inline bool allPositive( const std::array<int, 4>& ne )
-	{
-		const __m128i v = _mm_loadu_si128( ( const __m128i* )ne.data() );
-		const __m128i le = cmple( v, _mm_setzero_si128() );
-		return (bool)_mm_testz_si128( le, le );
-	}
+		switch( t.ftype )
+		{
+		case 0:  // GGML_TYPE_F32
+			dt = DirectCompute::eDataType::FP32;
+			cbElement = 4;
+			break;
+		case 1:  // GGML_TYPE_F16
+			dt = DirectCompute::eDataType::FP16;
+			cbElement = 2;
+			break;
+		case 2:  // GGML_TYPE_Q4_0
+			dt = DirectCompute::eDataType::Q4_0;
+			cbElement = 18;  // 18 bytes per Q4_0 block (32 elements)
+			break;
+		case 7:  // GGML_TYPE_Q5_1
+			dt = DirectCompute::eDataType::Q5_1;
+			cbElement = 24;  // 24 bytes per Q5_1 block (32 elements)
+			break;
+		case 8:  // GGML_TYPE_Q8_0
+			dt = DirectCompute::eDataType::Q8_0;
+			cbElement = 34;  // 34 bytes per Q8_0 block (32 elements)
+			break;
+		default:
+			// For now, fall back to FP16 for unsupported types
+			logWarning( u8"Unsupported quantization type %d, falling back to FP16", t.ftype );
+			dt = DirectCompute::eDataType::FP16;
+			cbElement = 2;
+			break;
+		}
 
-	inline const char* cstr( const CStringA& s ) { return s; }
+		const auto& ne = t.ne;
+		const size_t totalElts = (size_t)(uint32_t)ne[ 0 ] * (uint32_t)ne[ 1 ] * (uint32_t)ne[ 2 ];
+
+		size_t totalBytes;
+		if( dt == DirectCompute::eDataType::Q4_0 || dt == DirectCompute::eDataType::Q5_1 || dt == DirectCompute::eDataType::Q8_0 )
+		{
+			// For quantized types, calculate based on blocks
+			const uint32_t elementsPerBlock = 32;  // All GGML quantization types use 32 elements per block
+			const uint32_t blockCount = (totalElts + elementsPerBlock - 1) / elementsPerBlock;
+			totalBytes = blockCount * cbElement;
+		}
+		else
+		{
+			// For non-quantized types, calculate based on elements
+			totalBytes = totalElts * cbElement;
+		}
+
+		if( totalBytes > UINT_MAX )
+			return DISP_E_OVERFLOW;
+
+		t.dataType = (uint32_t)dt;
+		t.payloadBytes = totalBytes;
+		return S_OK;
+	}
 }
 
 class WhisperModel::CallbacksImpl : public CpuCompute::iLoaderProgressSink
@@ -232,6 +308,18 @@ public:
 	}
 
 	HRESULT call( ComLight::iReadStream* stm )
+	{
+		int64_t pos = 0;
+		if( nullptr != lmcb.progress )
+		{
+			CHECK( stm->getPosition( pos ) );
+			pos -= postponedBytes;
+		}
+		return call( pos );
+	}
+
+	// Same as above, the position is computed by the caller, and excludes the postponed bytes
+	HRESULT call( int64_t pos )
 	{
 		if( nullptr != lmcb.cancel )
 		{
@@ -243,9 +331,6 @@ public:
 
 		if( nullptr != lmcb.progress )
 		{
-			int64_t pos;
-			CHECK( stm->getPosition( pos ) );
-			pos -= postponedBytes;
 			const double progressVal = (double)pos / (double)fileSize;
 			HRESULT hr = lmcb.progress( progressVal, lmcb.pv );
 			CHECK( hr );
@@ -254,119 +339,39 @@ public:
 	}
 };
 
-HRESULT WhisperModel::loadGpu( ComLight::iReadStream* stm, CallbacksImpl& callbacks )
+HRESULT WhisperModel::uploadTensors( TensorReadAhead& readAhead, CallbacksImpl& callbacks, size_t countExpected, sLoadModelTimes& times )
 {
-	CAtlMap<CStringA, PendingTensor> map;
-	populateTensorsMap( map, parameters.n_audio_layer, parameters.n_text_layer, tensors, false );
-
 	DirectCompute::Reshaper reshape;
+	CHECK( readAhead.start() );
 
-	std::vector<uint8_t> bytesVector;
 	size_t countLoaded = 0;
-	CStringA name;
 	int64_t cb = 0;
 	while( true )
 	{
-		CHECK( callbacks.call( stm ) );
-
-		sTensorHeader header;
-		HRESULT hr = readStruct( stm, header );
-		if( hr == E_EOF )
+		std::unique_ptr<LoadedTensor> t;
+		const HRESULT hr = readAhead.next( t );
+		CHECK( hr );
+		if( S_FALSE == hr )
 			break;
-		if( FAILED( hr ) )
-			return hr;
-		if( header.n_dims < 1 || header.n_dims>3 )
-			return E_INVALIDARG;
-
-		std::array<int, 4> ne = { 1, 1, 1, 1 };
-		CHECK( readBytes( stm, ne.data(), header.n_dims * 4 ) );
-		if( !allPositive( ne ) )
-			return E_INVALIDARG;
-
-		char* nameBuffer = name.GetBufferSetLength( header.length );
-		hr = readBytes( stm, nameBuffer, header.length );
-		name.ReleaseBuffer();
-		if( FAILED( hr ) )
-			return hr;
+		CHECK( callbacks.call( t->progressPosition ) );
 
-		auto p = map.Lookup( name );
-		if( nullptr == p )
-		{
-			logError( u8"%s: unknown tensor '%s' in model file", __func__, cstr( name ) );
-			return E_INVALIDARG;
-		}
+		const CpuProfiler perf;
+		PendingTensor& pt = *(PendingTensor*)t->context;
+		const DirectCompute::eDataType dt = (DirectCompute::eDataType)t->dataType;
+		CHECK( pt.dest->createImmutable( dt, t->ne, t->payload ) );
+		CHECK( pt.postProcess( reshape, dt ) );
+		times.upload += perf.elapsed();
 
-		DirectCompute::eDataType dt;
-		size_t cbElement;
-
-		// Map GGML ftype to DirectCompute data type
-		switch( header.ftype )
-		{
-		case 0:  // GGML_TYPE_F32
-			dt = DirectCompute::eDataType::FP32;
-			cbElement = 4;
-			break;
-		case 1:  // GGML_TYPE_F16
-			dt = DirectCompute::eDataType::FP16;
-			cbElement = 2;
-			break;
-		case 2:  // GGML_TYPE_Q4_0
-			dt = DirectCompute::eDataType::Q4_0;
-			cbElement = 18;  // 18 bytes per Q4_0 block (32 elements)
-			break;
-		case 7:  // GGML_TYPE_Q5_1
-			dt = DirectCompute::eDataType::Q5_1;
-			cbElement = 24;  // 24 bytes per Q5_1 block (32 elements)
-			break;
-		case 8:  // GGML_TYPE_Q8_0
-			dt = DirectCompute::eDataType::Q8_0;
-			cbElement = 34;  // 34 bytes per Q8_0 block (32 elements)
-			break;
-		default:
-			// For now, fall back to FP16 for unsupported types
-			logWarning( u8"Unsupported quantization type %d, falling back to FP16", header.ftype );
-			dt = DirectCompute::eDataType::FP16;
-			cbElement = 2;
-			break;
-		}
-
-		const size_t totalElts = (size_t)(uint32_t)ne[ 0 ] * (uint32_t)ne[ 1 ] * (uint32_t)ne[ 2 ];
-
-		size_t totalBytes;
-		if( dt == DirectCompute::eDataType::Q4_0 || dt == DirectCompute::eDataType::Q5_1 || dt == DirectCompute::eDataType::Q8_0 )
-		{
-			// For quantized types, calculate based on blocks
-			const uint32_t elementsPerBlock = 32;  // All GGML quantization types use 32 elements per block
-			const uint32_t blockCount = (totalElts + elementsPerBlock - 1) / elementsPerBlock;
-			totalBytes = blockCount * cbElement;
-		}
-		else
-		{
-			// For non-quantized types, calculate based on elements
-			totalBytes = totalElts * cbElement;
-		}
-
-		if( totalBytes > UINT_MAX )
-			return DISP_E_OVERFLOW;
-
-		try
-		{
-			bytesVector.resize( totalBytes );
-		}
-		catch( const std::bad_alloc& )
-		{
-			return E_OUTOFMEMORY;
-		}
-		CHECK( readBytes( stm, bytesVector.data(), bytesVector.size() ) );
-		cb += bytesVector.size();
-		CHECK( p->m_value.dest->createImmutable( dt, ne, bytesVector.data() ) );
-		CHECK( p->m_value.postProcess( reshape, dt ) );
+		cb += t->payloadBytes;
 		countLoaded++;
+		readAhead.recycle( std::move( t ) );
 	}
+	readAhead.join();
+	times.read += readAhead.readTime();
 
-	if( countLoaded != map.GetCount() )
+	if( countLoaded != countExpected )
 	{
-		logError( u8"Not all tensors loaded from model file - expected %zu, got %zu", map.GetCount(), countLoaded );
+		logError( u8"Not all tensors loaded from model file - expected %zu, got %zu", countExpected, countLoaded );
 		return E_INVALIDARG;
 	}
 
@@ -375,154 +380,129 @@ HRESULT WhisperModel::loadGpu( ComLight::iReadStream* stm, CallbacksImpl& callba
 	return S_OK;
 }
 
-#if BUILD_HYBRID_VERSION
-HRESULT WhisperModel::loadHybrid( ComLight::iReadStream* stm, CallbacksImpl& callbacks )
+HRESULT WhisperModel::loadGpu( ComLight::iReadStream* stm, MappedStream* mapped, const GgufTensors* ggufTensors, CallbacksImpl& callbacks, sLoadModelTimes& times )
 {
 	CAtlMap<CStringA, PendingTensor> map;
-	populateTensorsMap( map, parameters.n_audio_layer, parameters.n_text_layer, tensors, true );
-	DirectCompute::Reshaper reshape;
-	CpuCompute::HybridLoader loader( shared->hybridTensors, parameters.n_text_layer );
+	populateTensorsMap( map, parameters.n_audio_layer, parameters.n_text_layer, tensors, false );
 
-	std::vector<uint8_t> bytesVector;
-	size_t countLoaded = 0;
-	CStringA name;
-	int64_t cb = 0;
-	while( true )
+	// Runs on the background thread of the read-ahead
+	auto filter = [ & ]( LoadedTensor& t ) -> HRESULT
 	{
-		CHECK( callbacks.call( stm ) );
-
-		sTensorHeader header;
-		HRESULT hr = readStruct( stm, header );
-		if( hr == E_EOF )
-			break;
-		if( FAILED( hr ) )
-			return hr;
-		if( header.n_dims < 1 || header.n_dims > 3 )
-			return E_INVALIDARG;
-
-		std::array<int, 4> ne = { 1, 1, 1, 1 };
-		CHECK( readBytes( stm, ne.data(), header.n_dims * 4 ) );
-		if( !allPositive( ne ) )
-			return E_INVALIDARG;
-
-		char* nameBuffer = name.GetBufferSetLength( header.length );
-		hr = readBytes( stm, nameBuffer, header.length );
-		name.ReleaseBuffer();
-		if( FAILED( hr ) )
-			return hr;
-
-		auto p = map.Lookup( name );
+		auto p = map.Lookup( t.name );
 		if( nullptr == p )
 		{
-			HRESULT hr = loader.setupTensor( name, header.n_dims, header.ftype, ne, stm, callbacks.postponedBytes );
-			if( hr == S_OK )
-				continue;
-			logError( u8"%s: unknown tensor '%s' in model file", __func__, cstr( name ) );
+			logError( u8"%s: unknown tensor '%s' in model file", "loadGpu", cstr( t.name ) );
 			return E_INVALIDARG;
 		}
+		t.context = &p->m_value;
+		return setTensorType( t );
+	};
 
-		DirectCompute::eDataType dt;
-		size_t cbElement;
-
-		// Map GGML ftype to DirectCompute data type
-		switch( header.ftype )
-		{
-		case 0:  // GGML_TYPE_F32
-			dt = DirectCompute::eDataType::FP32;
-			cbElement = 4;
-			break;
-		case 1:  // GGML_TYPE_F16
-			dt = DirectCompute::eDataType::FP16;
-			cbElement = 2;
-			break;
-		case 2:  // GGML_TYPE_Q4_0
-			dt = DirectCompute::eDataType::Q4_0;
-			cbElement = 18;  // 18 bytes per Q4_0 block (32 elements)
-			break;
-		case 7:  // GGML_TYPE_Q5_1
-			dt = DirectCompute::eDataType::Q5_1;
-			cbElement = 24;  // 24 bytes per Q5_1 block (32 elements)
-			break;
-		case 8:  // GGML_TYPE_Q8_0
-			dt = DirectCompute::eDataType::Q8_0;
-			cbElement = 34;  // 34 bytes per Q8_0 block (32 elements)
-			break;
-		default:
-			// For now, fall back to FP16 for unsupported types
-			logWarning( u8"Unsupported quantization type %d, falling back to FP16", header.ftype );
-			dt = DirectCompute::eDataType::FP16;
-			cbElement = 2;
-			break;
-		}
+	TensorReadAhead readAhead( stm, mapped, filter );
+	if( nullptr != ggufTensors )
+		readAhead.setTensorList( *ggufTensors );
+	return uploadTensors( readAhead, callbacks, map.GetCount(), times );
+}
 
-		const size_t totalElts = (size_t)(uint32_t)ne[ 0 ] * (uint32_t)ne[ 1 ] * (uint32_t)ne[ 2 ];
+#if BUILD_HYBRID_VERSION
+HRESULT WhisperModel::loadHybrid( ComLight::iReadStream* stm, MappedStream* mapped, const SharedModelData* sharedData, const GgufTensors* ggufTensors, CallbacksImpl& callbacks, sLoadModelTimes& times )
+{
+	CAtlMap<CStringA, PendingTensor> map;
+	populateTensorsMap( map, parameters.n_audio_layer, parameters.n_text_layer, tensors, true );
+	CpuCompute::HybridLoader loader( shared->hybridTensors, parameters.n_text_layer );
 
-		size_t totalBytes;
-		if( dt == DirectCompute::eDataType::Q4_0 || dt == DirectCompute::eDataType::Q5_1 || dt == DirectCompute::eDataType::Q8_0 )
-		{
-			// For quantized types, calculate based on blocks
-			const uint32_t elementsPerBlock = 32;  // All GGML quantization types use 32 elements per block
-			const uint32_t blockCount = (totalElts + elementsPerBlock - 1) / elementsPerBlock;
-			totalBytes = blockCount * cbElement;
-		}
-		else
+	// Runs on the background thread of the read-ahead; the decoder tensors are only located there, their payloads are loaded later by completeLoad()
+	auto filter = [ & ]( LoadedTensor& t ) -> HRESULT
+	{
+		auto p = map.Lookup( t.name );
+		if( nullptr == p )
 		{
-			// For non-quantized types, calculate based on elements
-			totalBytes = totalElts * cbElement;
+			HRESULT hr = loader.setupTensor( t.name, t.n_dims, t.ftype, t.ne, stm, callbacks.postponedBytes );
+			if( hr == S_OK )
+				return S_FALSE;
+			logError( u8"%s: unknown tensor '%s' in model file", "loadHybrid", cstr( t.name ) );
+			return E_INVALIDARG;
 		}
+		t.context = &p->m_value;
+		return setTensorType( t );
+	};
 
-		if( totalBytes > UINT_MAX )
-			return DISP_E_OVERFLOW;
-
-		try
-		{
-			bytesVector.resize( totalBytes );
-		}
-		catch( const std::bad_alloc& )
-		{
-			return E_OUTOFMEMORY;
-		}
-		CHECK( readBytes( stm, bytesVector.data(), bytesVector.size() ) );
-		CHECK( p->m_value.dest->createImmutable( dt, ne, bytesVector.data() ) );
-		CHECK( p->m_value.postProcess( reshape, dt ) );
-		countLoaded++;
-		cb += bytesVector.size();
+	{
+		TensorReadAhead readAhead( stm, mapped, filter, &callbacks.postponedBytes );
+		if( nullptr != ggufTensors )
+			readAhead.setTensorList( *ggufTensors );
+		CHECK( uploadTensors( readAhead, callbacks, map.GetCount(), times ) );
 	}
 
-	if( countLoaded != map.GetCount() )
+	const CpuProfiler perf;
+	if( nullptr != sharedData && sharedData->attached() )
 	{
-		logError( u8"Not all tensors loaded from model file - expected %zu, got %zu", map.GetCount(), countLoaded );
-		return E_INVALIDARG;
+		const HRESULT hr = sharedData->bindTensors( shared->hybridTensors );
+		CHECK( hr );
+		if( S_OK == hr )
+		{
+			// Another process has published these tensors, no need to load them
+			times.convert += perf.elapsed();
+			logDebug( u8"Decoder tensors are in the shared memory segment" );
+			return S_OK;
+		}
 	}
-
-	constexpr double mulMb = 1.0 / ( 1 << 20 );
-	logDebug( u8"Loaded %zu GPU tensors, %g MB VRAM", countLoaded, mulMb * cb );
-
-	CHECK( loader.completeLoad( stm, callbacks ) );
+	CHECK( loader.completeLoad( stm, callbacks, ( nullptr != mapped ) ? mapped->data() : nullptr ) );
+	times.convert += perf.elapsed();
 	return S_OK;
 }
 #endif
 
-HRESULT WhisperModel::load( ComLight::iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks )
+HRESULT WhisperModel::load( ComLight::iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped, const SharedModelData* sharedData )
 {
 	CpuProfiler cpuPerf;
 	CallbacksImpl cb;
 	CHECK( cb.initialize( stm, callbacks ) );
 	// verify magic
+	uint32_t magic;
+	CHECK( readStruct( stm, magic ) );
+	if( magic != 0x67676d6c && magic != GgufReader::magic )
 	{
-		uint32_t magic;
-		CHECK( readStruct( stm, magic ) );
-		if( magic != 0x67676d6c )
-		{
-			logError( u8"Invalid model file, bad magic" );
-			return E_INVALIDARG;
-		}
+		logError( u8"Invalid model file, bad magic" );
+		return E_INVALIDARG;
 	}
 
 	shared = std::make_shared<ModelShared>();
+	if( nullptr != mapped )
+		shared->mapping = mapped->getMapping();
 
-	// hparams and MEL filters
+	GgufReader gguf;
+	if( magic == GgufReader::magic )
 	{
+		// GGUF header with the metadata and the table of tensors
+		CHECK( gguf.read( stm ) );
+		CHECK( gguf.getModelParams( parameters ) );
+		assert( parameters.n_text_state == parameters.n_audio_state );
+
+		GgufTensorInfo melTensor;
+		HRESULT hr = gguf.extractTensor( "mel_filters", melTensor );
+		CHECK( hr );
+		if( S_FALSE == hr || melTensor.ftype != 0 || melTensor.n_dims != 2 )
+		{
+			logError( u8"GGUF model lacks FP32 \"mel_filters\" tensor" );
+			return E_INVALIDARG;
+		}
+		shared->filters.n_fft = (uint32_t)melTensor.ne[ 0 ];
+		shared->filters.n_mel = (uint32_t)melTensor.ne[ 1 ];
+		CHECK( stm->seek( melTensor.offset, ComLight::eSeekOrigin::Begin ) );
+		CHECK( loadFilters( shared->filters, stm, mapped ) );
+		CHECK( cb.call( stm ) );
+
+		if( 0 == gguf.countTokens )
+		{
+			logError( u8"GGUF model lacks tokenizer.ggml.tokens array" );
+			return E_INVALIDARG;
+		}
+		CHECK( shared->vocab.loadStrings( std::move( gguf.tokensTable ), gguf.countTokens, parameters.n_vocab ) );
+	}
+	else
+	{
+		// hparams and MEL filters
 		ParamsAndMelHeader pmh;
 		CHECK( readStruct( stm, pmh ) );
 		parameters = pmh.mp;
@@ -530,43 +510,103 @@ HRESULT WhisperModel::load( ComLight::iReadStream* stm, bool hybrid, const sLoad
 
 		shared->filters.n_mel = pmh.n_mel;
 		shared->filters.n_fft = pmh.n_fft;
-		const size_t len = (size_t)pmh.n_mel * pmh.n_fft;
-		shared->filters.data.resize( len );
-		CHECK( readBytes( stm, shared->filters.data.data(), len * 4 ) );
+		CHECK( loadFilters( shared->filters, stm, mapped ) );
+		CHECK( cb.call( stm ) );
 
-		const int64_t cb = len * 4;
-		constexpr double mulKb = 1.0 / ( 1 << 10 );
-		logDebug( u8"Loaded MEL filters, %.1f kb RAM", mulKb * cb );
+		// Vocabulary
+		CHECK( shared->vocab.load( stm, parameters.n_vocab ) );
 	}
-	CHECK( cb.call( stm ) );
-
-	// Vocabulary
-	CHECK( shared->vocab.load( stm, parameters.n_vocab ) );
+	if( nullptr != sharedData && sharedData->attached() )
+		CHECK( sharedData->bindFiltersAndVocab( *shared ) );
+	const GgufTensors* const ggufTensors = ( magic == GgufReader::magic ) ? &gguf.tensors : nullptr;
 	CHECK( cb.call( stm ) );
 
 	DirectCompute::GpuProfilerSimple gpuProfiler;
 	CHECK( gpuProfiler.create() );
 
+	sLoadModelTimes times;
+	memset( &times, 0, sizeof( times ) );
 	if( hybrid )
 	{
 #if BUILD_HYBRID_VERSION
-		CHECK( loadHybrid( stm, cb ) )
+		CHECK( loadHybrid( stm, mapped, sharedData, ggufTensors, cb, times ) )
 #else
 		return E_NOTIMPL;
 #endif
 	}
 	else
-		CHECK( loadGpu( stm, cb ) );
+		CHECK( loadGpu( stm, mapped, ggufTensors, cb, times ) );
 
 	CHECK( gpuProfiler.time( loadTimeGpu ) );
 	loadTimeCpu = cpuPerf.elapsed();
+
+	times.total = loadTimeCpu;
+	constexpr double msFromTicks = 1.0E-4;
+	logDebug( u8"Model load stages: read %g ms, convert %g ms, upload %g ms, total %g ms",
+		msFromTicks * times.read, msFromTicks * times.convert, msFromTicks * times.upload, msFromTicks * times.total );
+	loadStageTimes = times;
+	return S_OK;
+}
+
+HRESULT WhisperModel::loadCompiled( const ModelCache& cache, const sLoadModelCallbacks* callbacks )
+{
+	CpuProfiler cpuPerf;
+	DirectCompute::GpuProfilerSimple gpuProfiler;
+	CHECK( gpuProfiler.create() );
+
+	sLoadModelTimes times;
+	memset( &times, 0, sizeof( times ) );
+	CHECK( cache.load( *this, times ) );
+
+	CHECK( gpuProfiler.time( loadTimeGpu ) );
+	loadTimeCpu = cpuPerf.elapsed();
+	times.total = loadTimeCpu;
+
+	constexpr double msFromTicks = 1.0E-4;
+	logDebug( u8"Compiled model load stages: convert %g ms, upload %g ms, total %g ms",
+		msFromTicks * times.convert, msFromTicks * times.upload, msFromTicks * times.total );
+	loadStageTimes = times;
+
+	if( nullptr != callbacks && nullptr != callbacks->progress )
+		CHECK( callbacks->progress( 1.0, callbacks->pv ) );
 	return S_OK;
 }
 
+HRESULT WhisperModel::setupResidency()
+{
+#if BUILD_HYBRID_VERSION
+	if( !shared->mapping )
+	{
+		logWarning( u8"Lazy residency requires a memory-mapped model" );
+		return S_FALSE;
+	}
+	auto res = std::make_shared<CpuCompute::LayerResidency>();
+	CHECK( res->create( shared->hybridTensors, shared->mapping->data(), shared->mapping->size() ) );
+	shared->hybridTensors.residency = std::move( res );
+	return S_OK;
+#else
+	return E_NOTIMPL;
+#endif
+}
+
+HRESULT WhisperModel::setResidentBudget( size_t budgetBytes )
+{
+#if BUILD_HYBRID_VERSION
+	CpuCompute::LayerResidency* const res = shared->hybridTensors.residency.get();
+	if( nullptr == res )
+		return S_FALSE;
+	res->setBudget( budgetBytes );
+	return S_OK;
+#else
+	return S_FALSE;
+#endif
+}
+
 HRESULT Whisper::WhisperModel::createClone( const WhisperModel& rsi )
 {
 	parameters = rsi.parameters;
 	shared = rsi.shared;
+	quantizedKvCache = rsi.quantizedKvCache;
 	CHECK( tensors.createClone( rsi.tensors ) );
 	return S_OK;
 }
@@ -574,7 +614,7 @@ HRESULT Whisper::WhisperModel::createClone( const WhisperModel& rsi )
 __m128i Whisper::WhisperModel::getMemoryUse() const
 {
 	size_t cb = shared->vocab.getMemoryUse();
-	cb += vectorMemoryUse( shared->filters.data );
+	cb += vectorMemoryUse( shared->filters.storage );
 	__m128i v = _mm_cvtsi64_si128( (int64_t)cb );
 	v = _mm_add_epi64( v, tensors.getMemoryUse() );
 	return v;
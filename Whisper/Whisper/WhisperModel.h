@@ -7,25 +7,41 @@
 #include "../API/sLoadModelCallbacks.h"
 #include "sModelParams.h"
 
+class MappedStream;
+struct MappedFile;
+
 namespace Whisper
 {
+	class TensorReadAhead;
+	class ModelCache;
+	class SharedModelData;
+	struct GgufTensorInfo;
+
 	struct Filters
 	{
 		uint32_t n_mel;
 		uint32_t n_fft;
-		std::vector<float> data;
+		// n_mel * n_fft elements, either in the storage vector, or straight in the memory-mapped model file
+		const float* data = nullptr;
+		std::vector<float> storage;
+
+		size_t size() const { return (size_t)n_mel * n_fft; }
 	};
 
 	struct ModelShared
 	{
 		Vocabulary vocab;
 		Filters filters;
+		// When the model was loaded with eGpuModelFlags.MemoryMapped, keeps alive the mapping of the model file
+		std::shared_ptr<const MappedFile> mapping;
+		// When the model was loaded with eGpuModelFlags.SharedWeights flag, keeps alive the shared memory segment
+		std::shared_ptr<const SharedModelData> segment;
 #if BUILD_HYBRID_VERSION
 		CpuCompute::DecoderTensors hybridTensors;
 #endif
 	};
 
-	// The complete model, as loaded from a GGML binary file.
+	// The complete model, as loaded from a GGML binary file, or a GGUF file.
 	// The entire model is immutable, and can be safely used from multiple threads in parallel.
 	// The tensors are uploaded to VRAM and don’t stay in system memory, everything else is in the system RAM.
 	struct WhisperModel
@@ -33,8 +49,20 @@ namespace Whisper
 		sModelParams parameters;
 		std::shared_ptr<ModelShared> shared;
 		DirectCompute::ModelBuffers tensors;
+		// The hybrid contexts keep the self-attention KV cache in Q8_0 format, set by eGpuModelFlags.QuantizedKvCache
+		bool quantizedKvCache = false;
 
-		HRESULT load( ComLight::iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks );
+		// Both legacy GGML and GGUF files are supported, the format is detected from the magic number.
+		// When the `mapped` argument is not nullptr, it's the same stream as `stm`.
+		// In that case the tensors are uploaded straight from the mapped file, and the CPU-side data points into that mapping.
+		// When the sharedData is attached to an existing segment, the filters, vocabulary and the decoder tensors of the hybrid model are bound to that segment instead of loading
+		HRESULT load( ComLight::iReadStream* stm, bool hybrid, const sLoadModelCallbacks* callbacks, MappedStream* mapped = nullptr, const SharedModelData* sharedData = nullptr );
+		// Load the model from the compiled cache, the cache must be open
+		HRESULT loadCompiled( const ModelCache& cache, const sLoadModelCallbacks* callbacks );
+		// For the hybrid model loaded from a memory-mapped file, track the working set of the decoder layers, initially with unlimited budget
+		HRESULT setupResidency();
+		// Change the budget of the resident decoder layers, S_FALSE when the model doesn't track them
+		HRESULT setResidentBudget( size_t budgetBytes );
 		HRESULT createClone( const WhisperModel& rsi );
 
 		// A vector of 2 uint64_t values, both numbers are 100 nanosecond ticks:
@@ -46,15 +74,25 @@ namespace Whisper
 			return _mm_loadu_si128( ( const __m128i* )( &loadTimeCpu ) );
 		}
 
+		const sLoadModelTimes& getLoadStageTimes() const
+		{
+			return loadStageTimes;
+		}
+
 		__m128i getMemoryUse() const;
 
 	private:
 		uint64_t loadTimeCpu = 0;
 		uint64_t loadTimeGpu = 0;
+		sLoadModelTimes loadStageTimes = {};
 
 		class CallbacksImpl;
+		// When loading GGUF files, the table of tensors from the header of the file
+		using GgufTensors = std::vector<GgufTensorInfo>;
 
-		HRESULT loadGpu( ComLight::iReadStream* stm, CallbacksImpl& callbacks );
-		HRESULT loadHybrid( ComLight::iReadStream* stm, CallbacksImpl& callbacks );
+		HRESULT loadGpu( ComLight::iReadStream* stm, MappedStream* mapped, const GgufTensors* ggufTensors, CallbacksImpl& callbacks, sLoadModelTimes& times );
+		HRESULT loadHybrid( ComLight::iReadStream* stm, MappedStream* mapped, const SharedModelData* sharedData, const GgufTensors* ggufTensors, CallbacksImpl& callbacks, sLoadModelTimes& times );
+		// Upload the tensors parsed by the read-ahead thread to VRAM, on the calling thread which owns the device
+		HRESULT uploadTensors( TensorReadAhead& readAhead, CallbacksImpl& callbacks, size_t countExpected, sLoadModelTimes& times );
 	};
 }
\ No newline at end of file
@@ -3,10 +3,7 @@
 
 namespace Whisper
 {
-	struct alignas( 8 ) StereoSample
-	{
-		float left, right;
-	};
+	class StereoEnergy;
 
 	__interface iSpectrogram
 	{
@@ -17,8 +14,8 @@ namespace Whisper
 		// Apparently, the length unit is 160 input samples = 10 milliseconds of audio
 		size_t getLength() const;
 
-		// If the source data is stereo, copy the specified slice of the data into the provided vector
-		HRESULT copyStereoPcm( size_t offset, size_t length, std::vector<StereoSample>& buffer ) const;
+		// If the source data is stereo, per-channel energy of the audio for the diarization; otherwise nullptr
+		const StereoEnergy* getStereoEnergy() const;
 	};
 
 	// RAII class to deal with iSpectrogram's makeBuffer method.
@@ -0,0 +1,24 @@
+#pragma once
+#include <memory>
+
+namespace Whisper
+{
+	struct sCaptureParams;
+
+	// Voice activity detector for the audio capture.
+	// The capture appends new samples to the PCM buffer, and calls detect() method with the complete buffer; implementations keep enough state to only process the new samples.
+	struct iVoiceDetector
+	{
+		virtual ~iVoiceDetector() { }
+
+		// When no speech is detected, returns 0
+		// When speech is detected, returns sample position for the end of the speech
+		virtual size_t detect( const float* rsi, size_t length ) = 0;
+
+		// Reset the state, called when the PCM buffer is discarded or moved to the transcribe thread
+		virtual void clear() = 0;
+	};
+
+	// Create the voice activity detector requested by the capture parameters
+	HRESULT createVoiceDetector( const sCaptureParams& params, std::unique_ptr<iVoiceDetector>& rdi );
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "neuralVAD.h"
+#include "voiceActivityDetection.h"
+#include "../API/MfStructs.h"
+#include "../source/whisper.h"
+#include "../Utils/stringUtils.h"
+using namespace Whisper;
+
+NeuralVAD::NeuralVAD()
+{
+	threshold = whisper_vad_default_params().threshold;
+}
+
+NeuralVAD::~NeuralVAD()
+{
+	if( nullptr != context )
+	{
+		whisper_vad_free( context );
+		context = nullptr;
+	}
+}
+
+HRESULT NeuralVAD::load( const wchar_t* path )
+{
+	if( nullptr == path )
+		return E_POINTER;
+
+	whisper_vad_context_params cp = whisper_vad_default_context_params();
+	// The model is tiny, and the capture feeds it just a few windows at a time; more threads only add synchronization overhead
+	cp.n_threads = 1;
+	cp.use_gpu = false;
+
+	const std::string utf8 = wstring_to_string( path );
+	context = whisper_vad_init_from_file_with_params( utf8.c_str(), cp );
+	if( nullptr == context )
+	{
+		logError16( L"Unable to load VAD model from \"%s\"", path );
+		return E_INVALIDARG;
+	}
+
+	const int window = whisper_vad_n_window( context );
+	if( window <= 0 )
+		return E_UNEXPECTED;
+	windowSamples = (uint32_t)window;
+	clear();
+	return S_OK;
+}
+
+void NeuralVAD::clear()
+{
+	processed = 0;
+	lastSpeech = 0;
+	// The capture restarted or discarded the buffer, the LSTM state of the model no longer matches the PCM
+	if( nullptr != context )
+		whisper_vad_reset_state( context );
+}
+
+size_t NeuralVAD::detect( const float* rsi, size_t length )
+{
+	if( length < processed )
+	{
+		// The buffer was truncated without calling clear(), restart from scratch
+		clear();
+	}
+
+	const size_t windows = ( length - processed ) / windowSamples;
+	if( windows < minBatchWindows )
+		return lastSpeech;
+
+	const size_t samples = windows * windowSamples;
+	const float* const source = rsi + processed;
+	const bool ok = whisper_vad_detect_speech_continue( context, source, (int)samples );
+	if( !ok )
+	{
+		logError( u8"whisper_vad_detect_speech failed" );
+		processed += samples;
+		return lastSpeech;
+	}
+
+	const int countProbs = whisper_vad_n_probs( context );
+	const float* const probs = whisper_vad_probs( context );
+	for( int i = 0; i < countProbs; i++ )
+		if( probs[ i ] >= threshold )
+			lastSpeech = processed + (size_t)( i + 1 ) * windowSamples;
+
+	processed += samples;
+	return lastSpeech;
+}
+
+HRESULT Whisper::createVoiceDetector( const sCaptureParams& params, std::unique_ptr<iVoiceDetector>& rdi )
+{
+	rdi.reset();
+	if( 0 != ( params.flags & (uint32_t)eCaptureFlags::NeuralVAD ) )
+	{
+		if( nullptr == params.vadModelPath )
+		{
+			logError( u8"eCaptureFlags.NeuralVAD flag requires vadModelPath" );
+			return E_INVALIDARG;
+		}
+		std::unique_ptr<NeuralVAD> neural = std::make_unique<NeuralVAD>();
+		CHECK( neural->load( params.vadModelPath ) );
+		rdi = std::move( neural );
+		return S_OK;
+	}
+
+	std::unique_ptr<VAD> vad = std::make_unique<VAD>();
+	vad->clear();
+	rdi = std::move( vad );
+	return S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "iVoiceDetector.h"
+
+struct whisper_vad_context;
+
+namespace Whisper
+{
+	// Voice activity detector which runs the neural VAD model of whisper.cpp, Silero LSTM network converted to GGML format.
+	// The model consumes the PCM in fixed windows of 32 milliseconds, this class runs it in small batches of these windows on CPU, and carries the LSTM state across calls.
+	class NeuralVAD : public iVoiceDetector
+	{
+		whisper_vad_context* context = nullptr;
+		// Count of samples in a single window of the model
+		uint32_t windowSamples = 0;
+		// Count of samples already processed by the model
+		size_t processed = 0;
+		// Sample position for the end of the last window classified as speech
+		size_t lastSpeech = 0;
+		float threshold;
+
+		// Minimum count of windows to run the model; smaller batches are postponed to the next call
+		static constexpr uint32_t minBatchWindows = 4;
+
+	public:
+		NeuralVAD();
+		~NeuralVAD() override;
+
+		HRESULT load( const wchar_t* path );
+
+		size_t detect( const float* rsi, size_t length ) override final;
+
+		void clear() override final;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "stereoEnergy.h"
+using namespace Whisper;
+
+namespace
+{
+	// Compute per-channel sum of std::absf( pcm ) in the buffer of interleaved stereo samples,
+	// and return left / right numbers in the lower 2 lanes of the SSE vector
+	inline __m128 __vectorcall computeChannelsEnergy( const float* rsi, size_t countSamples )
+	{
+		// Might be possible to implement way more sophisticated, and precise, version of this function.
+		// For example, compute these 3 metrics with VAD code, and cluster the numbers somehow.
+		// Not doing that currently; instead, replicating the simple version from the whisper.cpp original version.
+
+		const float* const rsiEnd = rsi + countSamples * 2;
+		const float* const rsiEndAligned = rsi + ( countSamples & ( ~(size_t)1 ) ) * 2;
+
+		// Move 0x7FFFFFFF to lowest lane of the int32 vector;
+		// unlike float scalars or all vectors, integer scalar constants are in the instruction stream
+		__m128i absMaskInt = _mm_cvtsi32_si128( (int)0x7FFFFFFFu );
+		// Broadcast over the complete vector
+		absMaskInt = _mm_shuffle_epi32( absMaskInt, 0 );
+		// Bitcast to FP32 vector, for _mm_and_ps instruction
+		const __m128 absMask = _mm_castsi128_ps( absMaskInt );
+
+		__m128 acc = _mm_setzero_ps();
+		for( ; rsi < rsiEndAligned; rsi += 4 )
+		{
+			__m128 v = _mm_loadu_ps( rsi );
+			v = _mm_and_ps( v, absMask );
+			acc = _mm_add_ps( acc, v );
+		}
+		if( rsi != rsiEnd )
+		{
+			__m128 v = _mm_castpd_ps( _mm_load_sd( (const double*)rsi ) );
+			v = _mm_and_ps( v, absMask );
+			acc = _mm_add_ps( acc, v );
+		}
+
+		// Return acc.xy + acc.zw
+		acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+		return acc;
+	}
+}
+
+void StereoEnergy::clear()
+{
+	count.store( 0, std::memory_order_release );
+}
+
+HRESULT StereoEnergy::allocate( size_t chunks )
+{
+	count.store( 0, std::memory_order_release );
+	if( chunks + 1 <= capacity )
+		return S_OK;
+
+	prefixSums.reset();
+	capacity = 0;
+	try
+	{
+		prefixSums = std::make_unique<__m128d[]>( chunks + 1 );
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+	capacity = chunks + 1;
+	return S_OK;
+}
+
+bool StereoEnergy::appendChunk( const float* stereo )
+{
+	// Only this thread modifies the counter
+	size_t n = count.load( std::memory_order_relaxed );
+	if( 0 == n )
+	{
+		if( 0 == capacity )
+			return false;
+		prefixSums[ 0 ] = _mm_setzero_pd();
+		n = 1;
+	}
+	if( n >= capacity )
+		return false;
+
+	const __m128d sum = _mm_cvtps_pd( computeChannelsEnergy( stereo, FFT_STEP ) );
+	prefixSums[ n ] = _mm_add_pd( prefixSums[ n - 1 ], sum );
+	count.store( n + 1, std::memory_order_release );
+	return true;
+}
+
+HRESULT StereoEnergy::build( const float* stereo, size_t countSamples )
+{
+	const size_t chunks = ( countSamples + FFT_STEP - 1 ) / FFT_STEP;
+	CHECK( allocate( chunks ) );
+
+	__m128d acc = _mm_setzero_pd();
+	prefixSums[ 0 ] = acc;
+	for( size_t i = 0; i < chunks; i++, stereo += FFT_STEP * 2 )
+	{
+		const size_t len = std::min( countSamples - i * FFT_STEP, (size_t)FFT_STEP );
+		acc = _mm_add_pd( acc, _mm_cvtps_pd( computeChannelsEnergy( stereo, len ) ) );
+		prefixSums[ i + 1 ] = acc;
+	}
+	count.store( chunks + 1, std::memory_order_release );
+	return S_OK;
+}
+
+HRESULT StereoEnergy::query( size_t offset, size_t length, __m128& result ) const
+{
+	const size_t chunks = countChunks();
+	if( offset >= chunks )
+		return E_BOUNDS;
+
+	const size_t end = std::min( offset + length, chunks );
+	const __m128d diff = _mm_sub_pd( prefixSums[ end ], prefixSums[ offset ] );
+	result = _mm_cvtpd_ps( diff );
+	return S_OK;
+}
\ No newline at end of file
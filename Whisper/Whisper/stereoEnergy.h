@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "audioConstants.h"
+
+namespace Whisper
+{
+	// Per-channel prefix sums of absolute values of stereo PCM samples, at the granularity of the spectrogram, 10ms = FFT_STEP samples.
+	// Built while the spectrogram is computed; iContext.detectSpeaker queries these sums in constant time, without copying any audio.
+	class StereoEnergy
+	{
+		// Element [ i ] contains left/right sums for the chunks [ 0 .. i ), the first element is zeros.
+		// FP64 because the differences of large sums are taken, FP32 would lose precision on long audio.
+		std::unique_ptr<__m128d[]> prefixSums;
+		size_t capacity = 0;
+		// Count of the valid elements in prefixSums.
+		// MelStreamerThread appends chunks on the background thread while detectSpeaker queries them on another one:
+		// the writer publishes new elements with a release store, readers use acquire loads, and the buffer is never reallocated while appending.
+		std::atomic<size_t> count = 0;
+
+		size_t countElements() const noexcept
+		{
+			return count.load( std::memory_order_acquire );
+		}
+
+	public:
+		bool empty() const noexcept
+		{
+			return countElements() < 2;
+		}
+
+		// Count of complete or incomplete chunks summed so far
+		size_t countChunks() const noexcept
+		{
+			const size_t n = countElements();
+			return ( n < 2 ) ? 0 : n - 1;
+		}
+
+		void clear();
+
+		// Allocate the buffer for the specified count of chunks, and discard the content.
+		// Must be called before any other thread has a chance to query the sums.
+		HRESULT allocate( size_t chunks );
+
+		// Append one chunk of FFT_STEP interleaved stereo samples, returns false when the buffer is full
+		bool appendChunk( const float* stereo );
+
+		// Replace the content with sums for the complete buffer of interleaved stereo samples.
+		// The incomplete last chunk is treated as if padded with zeros.
+		HRESULT build( const float* stereo, size_t countSamples );
+
+		// Compute per-channel sum of absolute values in the specified slice of chunks, return left / right numbers in the lower 2 lanes of the SSE vector.
+		// The slice is clipped to the end of the audio.
+		HRESULT query( size_t offset, size_t length, __m128& result ) const;
+	};
+}
\ No newline at end of file
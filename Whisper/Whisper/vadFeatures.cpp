@@ -0,0 +1,259 @@
+#include "stdafx.h"
+#include "vadFeatures.h"
+#include "audioConstants.h"
+#include <cmath>
+using namespace Whisper;
+
+namespace
+{
+	// Count of real samples in the frame
+	constexpr uint32_t N = VAD_FFT_POINTS;
+	// Real FFT is computed with a complex FFT of the half size, on the even/odd samples packed into real/imaginary parts
+	constexpr uint32_t M = N / 2;
+	static_assert( 0 == ( M & ( M - 1 ) ) );
+
+	constexpr float mulInt16FromFloat = 32768.0f;
+	constexpr float frequencyStep = (float)SAMPLE_RATE / (float)N;
+
+	struct FftTables
+	{
+		// Bit reversal permutation for the complex FFT
+		std::array<uint8_t, M> bitReverse;
+		// exp( -2πi k / M ) for k in [ 0 .. M/2 ), for the butterflies of the complex FFT
+		std::array<float, M / 2> cosM, sinM;
+		// exp( -2πi k / N ) for k in [ 0 .. M ), for the post-processing which splits the real spectrum
+		std::array<float, M> cosN, sinN;
+
+		FftTables();
+	};
+
+	FftTables::FftTables()
+	{
+		uint32_t bits = 0;
+		while( ( 1u << bits ) < M )
+			bits++;
+
+		for( uint32_t i = 0; i < M; i++ )
+		{
+			uint32_t r = 0;
+			for( uint32_t b = 0; b < bits; b++ )
+				if( 0 != ( i & ( 1u << b ) ) )
+					r |= 1u << ( bits - 1 - b );
+			bitReverse[ i ] = (uint8_t)r;
+		}
+
+		for( uint32_t k = 0; k < M / 2; k++ )
+		{
+			const double angle = ( -2.0 * M_PI * (int)k ) / (double)M;
+			cosM[ k ] = (float)std::cos( angle );
+			sinM[ k ] = (float)std::sin( angle );
+		}
+		for( uint32_t k = 0; k < M; k++ )
+		{
+			const double angle = ( -2.0 * M_PI * (int)k ) / (double)N;
+			cosN[ k ] = (float)std::cos( angle );
+			sinN[ k ] = (float)std::sin( angle );
+		}
+	}
+
+	const FftTables s_tables;
+
+	// Zero frame to pad incomplete batches
+	alignas( 16 ) const std::array<float, N> s_zeroFrame = {};
+
+	__forceinline __m128 fmadd( __m128 a, __m128 b, __m128 c )
+	{
+		return _mm_add_ps( _mm_mul_ps( a, b ), c );
+	}
+
+	// Complex spectra of 4 frames, SIMD lanes are the frames
+	class alignas( 16 ) Batch4
+	{
+		std::array<__m128, M> re, im;
+		std::array<__m128, M + 1> power;
+
+		__m128 load( const float* f0, const float* f1, const float* f2, const float* f3 );
+		void butterflies();
+		void splitRealSpectrum();
+		void computeFeatures( __m128 energy, VadFeature* rdi, size_t count ) const;
+
+	public:
+		void run( const float* f0, const float* f1, const float* f2, const float* f3, VadFeature* rdi, size_t count )
+		{
+			const __m128 energy = load( f0, f1, f2, f3 );
+			butterflies();
+			splitRealSpectrum();
+			computeFeatures( energy, rdi, count );
+		}
+	};
+
+	// Scale the samples to int16 range, transpose into SIMD lanes, pack even/odd samples into real/imaginary parts of the complex signal, and permute into the bit-reversed order.
+	// Returns sums of squares of the scaled samples.
+	__m128 Batch4::load( const float* f0, const float* f1, const float* f2, const float* f3 )
+	{
+		const __m128 scale = _mm_set1_ps( mulInt16FromFloat );
+		__m128 energy = _mm_setzero_ps();
+		const uint8_t* const rev = s_tables.bitReverse.data();
+
+		for( uint32_t n = 0; n < N; n += 4 )
+		{
+			__m128 r0 = _mm_mul_ps( _mm_loadu_ps( f0 + n ), scale );
+			__m128 r1 = _mm_mul_ps( _mm_loadu_ps( f1 + n ), scale );
+			__m128 r2 = _mm_mul_ps( _mm_loadu_ps( f2 + n ), scale );
+			__m128 r3 = _mm_mul_ps( _mm_loadu_ps( f3 + n ), scale );
+			_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+
+			energy = fmadd( r0, r0, energy );
+			energy = fmadd( r1, r1, energy );
+			energy = fmadd( r2, r2, energy );
+			energy = fmadd( r3, r3, energy );
+
+			const uint32_t i = n / 2;
+			re[ rev[ i ] ] = r0;
+			im[ rev[ i ] ] = r1;
+			re[ rev[ i + 1 ] ] = r2;
+			im[ rev[ i + 1 ] ] = r3;
+		}
+		return energy;
+	}
+
+	// Iterative radix-2 decimation in time
+	void Batch4::butterflies()
+	{
+		for( uint32_t size = 2; size <= M; size *= 2 )
+		{
+			const uint32_t half = size / 2;
+			const uint32_t step = M / size;
+			for( uint32_t j = 0; j < half; j++ )
+			{
+				const __m128 wr = _mm_set1_ps( s_tables.cosM[ j * step ] );
+				const __m128 wi = _mm_set1_ps( s_tables.sinM[ j * step ] );
+				for( uint32_t k = j; k < M; k += size )
+				{
+					const uint32_t l = k + half;
+					const __m128 tr = _mm_sub_ps( _mm_mul_ps( wr, re[ l ] ), _mm_mul_ps( wi, im[ l ] ) );
+					const __m128 ti = fmadd( wr, im[ l ], _mm_mul_ps( wi, re[ l ] ) );
+					re[ l ] = _mm_sub_ps( re[ k ], tr );
+					im[ l ] = _mm_sub_ps( im[ k ], ti );
+					re[ k ] = _mm_add_ps( re[ k ], tr );
+					im[ k ] = _mm_add_ps( im[ k ], ti );
+				}
+			}
+		}
+	}
+
+	// Recover the first half of the spectrum of the real signal, compute squared magnitudes
+	void Batch4::splitRealSpectrum()
+	{
+		// Bins 0 and M are real
+		const __m128 x0 = _mm_add_ps( re[ 0 ], im[ 0 ] );
+		const __m128 xm = _mm_sub_ps( re[ 0 ], im[ 0 ] );
+		power[ 0 ] = _mm_mul_ps( x0, x0 );
+		power[ M ] = _mm_mul_ps( xm, xm );
+
+		const __m128 half = _mm_set1_ps( 0.5f );
+		for( uint32_t k = 1; k < M; k++ )
+		{
+			// A = Z[ k ], B = conj( Z[ M - k ] )
+			const __m128 ar = re[ k ];
+			const __m128 ai = im[ k ];
+			const __m128 br = re[ M - k ];
+			const __m128 bi = im[ M - k ];
+
+			// Even part = ( A + B ) / 2
+			const __m128 er = _mm_mul_ps( _mm_add_ps( ar, br ), half );
+			const __m128 ei = _mm_mul_ps( _mm_sub_ps( ai, bi ), half );
+			// Odd part = ( A - B ) / 2i
+			const __m128 odr = _mm_mul_ps( _mm_add_ps( ai, bi ), half );
+			const __m128 odi = _mm_mul_ps( _mm_sub_ps( br, ar ), half );
+
+			// X = Even + W^k * Odd
+			const __m128 wr = _mm_set1_ps( s_tables.cosN[ k ] );
+			const __m128 wi = _mm_set1_ps( s_tables.sinN[ k ] );
+			const __m128 xr = _mm_add_ps( er, _mm_sub_ps( _mm_mul_ps( wr, odr ), _mm_mul_ps( wi, odi ) ) );
+			const __m128 xi = _mm_add_ps( ei, fmadd( wr, odi, _mm_mul_ps( wi, odr ) ) );
+
+			power[ k ] = fmadd( xr, xr, _mm_mul_ps( xi, xi ) );
+		}
+	}
+
+	void Batch4::computeFeatures( __m128 energy, VadFeature* rdi, size_t count ) const
+	{
+		// Dominant frequency: index of the first maximum in the bins [ 0 .. M )
+		__m128 maxPower = _mm_setzero_ps();
+		__m128 maxIndex = _mm_setzero_ps();
+		__m128 index = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps( 1.0f );
+
+		// Spectral flatness, arithmetic versus geometric mean of the magnitudes over the complete spectrum.
+		// The spectrum of a real signal is symmetric, bins [ 1 .. M ) are counted twice.
+		// Geometric mean is computed in log2 domain, log2( |X| ) = 0.5 * log2( |X|^2 )
+		// The power is clamped from below, pure tones and digital silence have bins with exact zeros which would make the measure infinite.
+		__m128 sumMag = _mm_setzero_ps();
+		__m128 sumLog = _mm_setzero_ps();
+		const __m128 minPower = _mm_set1_ps( 1e-10f );
+
+		for( uint32_t k = 0; k < M; k++ )
+		{
+			const __m128 p = power[ k ];
+			const __m128 gt = _mm_cmpgt_ps( p, maxPower );
+			maxPower = _mm_blendv_ps( maxPower, p, gt );
+			maxIndex = _mm_blendv_ps( maxIndex, index, gt );
+			index = _mm_add_ps( index, one );
+
+			if( 0 != k )
+			{
+				const __m128 pc = _mm_max_ps( p, minPower );
+				sumMag = _mm_add_ps( sumMag, _mm_sqrt_ps( pc ) );
+				sumLog = _mm_add_ps( sumLog, DirectX::XMVectorLog2( pc ) );
+			}
+		}
+		// Each of the bins [ 1 .. M ) is counted twice, that's 2 * 0.5 = 1.0 for the log, and 2.0 for the magnitudes
+		sumMag = _mm_add_ps( sumMag, sumMag );
+		const __m128 p0 = _mm_max_ps( power[ 0 ], minPower );
+		const __m128 pm = _mm_max_ps( power[ M ], minPower );
+		sumMag = _mm_add_ps( sumMag, _mm_add_ps( _mm_sqrt_ps( p0 ), _mm_sqrt_ps( pm ) ) );
+		const __m128 halfLog = _mm_add_ps( DirectX::XMVectorLog2( p0 ), DirectX::XMVectorLog2( pm ) );
+		sumLog = fmadd( halfLog, _mm_set1_ps( 0.5f ), sumLog );
+
+		const __m128 invN = _mm_set1_ps( 1.0f / N );
+		// log2( geometric / arithmetic )
+		const __m128 ratioLog2 = _mm_sub_ps( _mm_mul_ps( sumLog, invN ), DirectX::XMVectorLog2( _mm_mul_ps( sumMag, invN ) ) );
+		// -10 * log10( geometric / arithmetic )
+		const float log10Of2 = 0.30102999566398119521f;
+		const __m128 sfm = _mm_mul_ps( ratioLog2, _mm_set1_ps( -10.0f * log10Of2 ) );
+
+		const __m128 rms = _mm_sqrt_ps( _mm_mul_ps( energy, invN ) );
+		const __m128 freq = _mm_mul_ps( maxIndex, _mm_set1_ps( frequencyStep ) );
+
+		alignas( 16 ) std::array<float, 4> e, f, s;
+		_mm_store_ps( e.data(), rms );
+		_mm_store_ps( f.data(), freq );
+		_mm_store_ps( s.data(), sfm );
+		for( size_t i = 0; i < count; i++ )
+		{
+			rdi[ i ].energy = e[ i ];
+			rdi[ i ].F = f[ i ];
+			rdi[ i ].SFM = s[ i ];
+		}
+	}
+}
+
+void Whisper::computeVadFeatures( const float* pcm, size_t frames, VadFeature* rdi )
+{
+	Batch4 batch;
+	const float* const zero = s_zeroFrame.data();
+
+	const size_t framesAligned = frames & ~(size_t)3;
+	size_t i;
+	for( i = 0; i < framesAligned; i += 4, pcm += N * 4, rdi += 4 )
+		batch.run( pcm, pcm + N, pcm + N * 2, pcm + N * 3, rdi, 4 );
+
+	const size_t rem = frames - i;
+	if( 0 == rem )
+		return;
+	// Pad the incomplete batch with zero frames, and only store the features of the actual ones
+	const float* f1 = rem > 1 ? pcm + N : zero;
+	const float* f2 = rem > 2 ? pcm + N * 2 : zero;
+	batch.run( pcm, f1, f2, zero, rdi, rem );
+}
\ No newline at end of file
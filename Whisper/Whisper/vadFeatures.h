@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+namespace Whisper
+{
+	// Features of a single frame, computed by the voice activity detector
+	struct VadFeature
+	{
+		// RMS of the signal, in int16 units
+		float energy;
+		// Dominant frequency, Hz
+		float F;
+		// Spectral flatness measure, dB
+		float SFM;
+	};
+
+	// Count of PCM samples in a single VAD frame, 16 milliseconds of audio
+	constexpr uint32_t VAD_FFT_POINTS = 256;
+
+	// Compute VAD features for a batch of consecutive frames, each frame is VAD_FFT_POINTS samples.
+	// Runs a real-input FFT with precomputed twiddle factors, processing 4 frames at once in the lanes of SSE vectors.
+	void computeVadFeatures( const float* pcm, size_t frames, VadFeature* rdi );
+}
\ No newline at end of file
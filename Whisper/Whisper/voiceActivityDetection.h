@@ -1,21 +1,14 @@
 #pragma once
-#include <complex>
-#include <memory>
+#include <vector>
 #include "audioConstants.h"
+#include "vadFeatures.h"
+#include "iVoiceDetector.h"
 
 namespace Whisper
 {
-	class VAD
+	class VAD : public iVoiceDetector
 	{
-		using cplx = std::complex<float>;
-		std::unique_ptr<cplx[]> fft_signal;
-
-		struct Feature
-		{
-			float energy;
-			float F;
-			float SFM;
-		};
+		using Feature = VadFeature;
 		const Feature primThresh;
 		static Feature defaultPrimaryThresholds();
 
@@ -31,12 +24,8 @@ namespace Whisper
 		};
 		State state;
 
-		static inline void fft( cplx* buf, cplx* out, size_t n, size_t step );
-		void fft() const;
-
-		static float computeEnergy( const float* rsi );
-		static float computeDominant( const cplx* spectrum );
-		static float computreSpectralFlatnessMeasure( const cplx* spectrum );
+		// Features of the new frames, computed in a single batch by each call to detect() method
+		std::vector<Feature> features;
 
 	public:
 
@@ -44,11 +33,11 @@ namespace Whisper
 
 		// When no speech is detected, returns 0
 		// When speech is detected, returns sample position for the end of the speech
-		size_t detect( const float* rsi, size_t length );
+		size_t detect( const float* rsi, size_t length ) override final;
 
-		void clear();
+		void clear() override final;
 
-		static constexpr uint32_t FFT_POINTS = 256;
+		static constexpr uint32_t FFT_POINTS = VAD_FFT_POINTS;
 		static constexpr float FFT_STEP = (float)SAMPLE_RATE / (float)FFT_POINTS;
 	};
 }
\ No newline at end of file
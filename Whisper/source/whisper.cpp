@@ -997,6 +997,69 @@ static void read_safe(whisper_model_loader * loader, T & dest) {
     BYTESWAP_VALUE(dest);
 }
 
+// read the headers of all tensors in the file, skipping the payloads, then rewind the loader back to the first tensor
+// the ftype in the model header is only the most common type, the quantizer writes models with per-tensor types
+static bool whisper_model_scan_tensor_types(whisper_model_loader * loader, std::map<std::string, ggml_type> & types) {
+    const size_t offset_start = loader->tell(loader->context);
+
+    std::string name;
+
+    while (true) {
+        int32_t n_dims;
+        int32_t length;
+        int32_t ttype;
+
+        read_safe(loader, n_dims);
+        read_safe(loader, length);
+        read_safe(loader, ttype);
+
+        if (loader->eof(loader->context)) {
+            break;
+        }
+
+        if (n_dims < 1 || n_dims > 4 || length <= 0 || ttype < 0 || ttype >= GGML_TYPE_COUNT || ggml_blck_size((ggml_type) ttype) == 0) {
+            WHISPER_LOG_ERROR("%s: invalid tensor header: n_dims = %d, length = %d, type = %d\n", __func__, n_dims, length, ttype);
+            return false;
+        }
+
+        int64_t nelements = 1;
+        int32_t ne[4] = { 1, 1, 1, 1 };
+        for (int i = 0; i < n_dims; ++i) {
+            read_safe(loader, ne[i]);
+            nelements *= ne[i];
+        }
+
+        name.resize(length);
+        loader->read(loader->context, &name[0], name.size());
+
+        const ggml_type type = (ggml_type) ttype;
+        if (ne[0] <= 0 || nelements <= 0 || ne[0] % ggml_blck_size(type) != 0) {
+            WHISPER_LOG_ERROR("%s: tensor '%s' has invalid shape for the type %s\n", __func__, name.c_str(), ggml_type_name(type));
+            return false;
+        }
+
+        types[name] = type;
+
+        const size_t nbytes = ggml_row_size(type, ne[0])*(size_t)(nelements/ne[0]);
+        if (!loader->seek(loader->context, loader->tell(loader->context) + nbytes)) {
+            WHISPER_LOG_ERROR("%s: failed to skip the payload of tensor '%s'\n", __func__, name.c_str());
+            return false;
+        }
+    }
+
+    return loader->seek(loader->context, offset_start);
+}
+
+// change the type of the weight tensor which was not allocated yet
+static void whisper_tensor_set_type(ggml_tensor * t, ggml_type type) {
+    t->type  = type;
+    t->nb[0] = ggml_type_size(type);
+    t->nb[1] = t->nb[0]*(t->ne[0]/ggml_blck_size(type));
+    for (int i = 2; i < GGML_MAX_DIMS; i++) {
+        t->nb[i] = t->nb[i - 1]*t->ne[i - 1];
+    }
+}
+
 static bool whisper_kv_cache_init(
              struct whisper_kv_cache & cache,
                       ggml_backend_t   backend,
@@ -1697,6 +1760,16 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
     const ggml_type wtype = wctx.wtype;
     const ggml_type vtype = wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16; // conv type
 
+    // the types of the tensors stored in the file, when the loader can seek
+    // without it, every tensor must have the type derived from the ftype in the header
+    std::map<std::string, ggml_type> file_types;
+    if (loader->tell && loader->seek) {
+        if (!whisper_model_scan_tensor_types(loader, file_types)) {
+            WHISPER_LOG_ERROR("%s: failed to read the tensor types\n", __func__);
+            return false;
+        }
+    }
+
     const auto & hparams = model.hparams;
 
     const int n_audio_layer = hparams.n_audio_layer;
@@ -1732,16 +1805,24 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
     buft_list_t buft_list = make_buft_list(wctx.params);
 
     auto create_tensor = [&](asr_tensor type, asr_system system, ggml_tensor * meta, int layer = 0) -> ggml_tensor * {
+        std::string name = format(ASR_TENSOR_NAMES.at(system).at(type), layer);
+
+        // mixed-precision models; the buffer type depends on the tensor type, so this happens before selecting it
+        const auto it_type = file_types.find(name);
+        if (it_type != file_types.end() && it_type->second != meta->type) {
+            whisper_tensor_set_type(meta, it_type->second);
+        }
+
         ggml_op op = ASR_TENSOR_INFO.at(type);
         ggml_backend_buffer_type_t buft = select_weight_buft(hparams, meta, op, buft_list);
         if (!buft) {
-            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", ASR_TENSOR_NAMES.at(system).at(type)));
+            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", name.c_str()));
         }
 
         ggml_context * ctx = get_ctx(buft);
         ggml_tensor * tensor = ggml_dup_tensor(ctx, meta);
 
-        model.tensors[format(ASR_TENSOR_NAMES.at(system).at(type), layer)] = tensor;
+        model.tensors[name] = tensor;
 
         return tensor;
     };
@@ -1931,6 +2012,12 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
                 return false;
             }
 
+            if (tensor->type != ttype) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has type %d in model file, expected %s\n",
+                        __func__, name.data(), ttype, ggml_type_name(tensor->type));
+                return false;
+            }
+
             const size_t bpe = ggml_type_size(ggml_type(ttype));
 
             if ((nelements*bpe)/ggml_blck_size(tensor->type) != ggml_nbytes(tensor)) {
@@ -3673,6 +3760,18 @@ struct whisper_context * whisper_init_from_file_with_params_no_state(const char
         fin->close();
     };
 
+    loader.tell = [](void * ctx) {
+        std::ifstream * fin = (std::ifstream*)ctx;
+        return (size_t) fin->tellg();
+    };
+
+    loader.seek = [](void * ctx, size_t offset) {
+        std::ifstream * fin = (std::ifstream*)ctx;
+        fin->clear();
+        fin->seekg((std::streamoff) offset);
+        return !fin->fail();
+    };
+
     auto ctx = whisper_init_with_params_no_state(&loader, params);
 
     if (ctx) {
@@ -3716,6 +3815,22 @@ struct whisper_context * whisper_init_from_buffer_with_params_no_state(void * bu
 
     loader.close = [](void * /*ctx*/) { };
 
+    loader.tell = [](void * ctx) {
+        buf_context * buf = reinterpret_cast<buf_context *>(ctx);
+
+        return buf->current_offset;
+    };
+
+    loader.seek = [](void * ctx, size_t offset) {
+        buf_context * buf = reinterpret_cast<buf_context *>(ctx);
+
+        if (offset > buf->size) {
+            return false;
+        }
+        buf->current_offset = offset;
+        return true;
+    };
+
     return whisper_init_with_params_no_state(&loader, params);
 }
 
@@ -5097,23 +5212,31 @@ struct whisper_vad_context * whisper_vad_init_with_params(
     return vctx;
 }
 
-bool whisper_vad_detect_speech(
+static bool whisper_vad_detect_speech_impl(
         struct whisper_vad_context * vctx,
         const float * samples,
-        int n_samples) {
+        int n_samples,
+        bool reset_state) {
     int n_chunks = n_samples / vctx->n_window;
     if (n_samples % vctx->n_window != 0) {
         n_chunks += 1;  // Add one more chunk for remaining samples.
     }
 
-    WHISPER_LOG_INFO("%s: detecting speech in %d samples\n", __func__, n_samples);
-    WHISPER_LOG_INFO("%s: n_chunks: %d\n", __func__, n_chunks);
+    if (reset_state) {
+        WHISPER_LOG_INFO("%s: detecting speech in %d samples\n", __func__, n_samples);
+        WHISPER_LOG_INFO("%s: n_chunks: %d\n", __func__, n_chunks);
 
-    // Reset LSTM hidden/cell states
-    ggml_backend_buffer_clear(vctx->buffer, 0);
+        // Reset LSTM hidden/cell states
+        ggml_backend_buffer_clear(vctx->buffer, 0);
+    }
 
     vctx->probs.resize(n_chunks);
-    WHISPER_LOG_INFO("%s: props size: %u\n", __func__, n_chunks);
+    // the incremental path runs several times per second on live capture, keep it quiet
+    if (reset_state) {
+        WHISPER_LOG_INFO("%s: props size: %u\n", __func__, n_chunks);
+    } else {
+        WHISPER_LOG_DEBUG("%s: props size: %u\n", __func__, n_chunks);
+    }
 
     std::vector<float> window(vctx->n_window, 0.0f);
 
@@ -5172,13 +5295,37 @@ bool whisper_vad_detect_speech(
     }
 
     vctx->t_vad_us += ggml_time_us() - t_start_vad_us;
-    WHISPER_LOG_INFO("%s: vad time = %.2f ms processing %d samples\n", __func__, 1e-3f * vctx->t_vad_us, n_samples);
+    if (reset_state) {
+        WHISPER_LOG_INFO("%s: vad time = %.2f ms processing %d samples\n", __func__, 1e-3f * vctx->t_vad_us, n_samples);
+    }
 
     ggml_backend_sched_reset(sched);
 
     return true;
 }
 
+bool whisper_vad_detect_speech(
+        struct whisper_vad_context * vctx,
+        const float * samples,
+        int n_samples) {
+    return whisper_vad_detect_speech_impl(vctx, samples, n_samples, true);
+}
+
+bool whisper_vad_detect_speech_continue(
+        struct whisper_vad_context * vctx,
+        const float * samples,
+        int n_samples) {
+    return whisper_vad_detect_speech_impl(vctx, samples, n_samples, false);
+}
+
+void whisper_vad_reset_state(struct whisper_vad_context * vctx) {
+    ggml_backend_buffer_clear(vctx->buffer, 0);
+}
+
+int whisper_vad_n_window(struct whisper_vad_context * vctx) {
+    return vctx->n_window;
+}
+
 int whisper_vad_segments_n_segments(struct whisper_vad_segments * segments) {
     return segments->data.size();
 }
@@ -156,6 +156,11 @@ extern "C" {
         size_t (*read)(void * ctx, void * output, size_t read_size);
         bool    (*eof)(void * ctx);
         void  (*close)(void * ctx);
+
+        // optional; when both are set, the loader reads the types of all tensors before allocating them,
+        // which is required for the models with per-tensor types written by Tools/quantize
+        size_t (*tell)(void * ctx);
+        bool   (*seek)(void * ctx, size_t offset);
     } whisper_model_loader;
 
     // grammar element type
@@ -692,6 +697,17 @@ extern "C" {
                            const float * samples,
                                    int   n_samples);
 
+    // Same as whisper_vad_detect_speech, but keeps the LSTM state from the previous call.
+    // Allows to feed the audio stream incrementally, in multiples of whisper_vad_n_window samples.
+    WHISPER_API bool whisper_vad_detect_speech_continue(
+            struct whisper_vad_context * vctx,
+                           const float * samples,
+                                   int   n_samples);
+
+    // Clears the LSTM state, call before feeding an unrelated stream to whisper_vad_detect_speech_continue.
+    WHISPER_API void    whisper_vad_reset_state(struct whisper_vad_context * vctx);
+    WHISPER_API int     whisper_vad_n_window   (struct whisper_vad_context * vctx);
+
     WHISPER_API int     whisper_vad_n_probs(struct whisper_vad_context * vctx);
     WHISPER_API float * whisper_vad_probs  (struct whisper_vad_context * vctx);
 
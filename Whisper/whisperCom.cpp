@@ -116,6 +116,15 @@ namespace Whisper
 			whisper_reset_timings( &ctx );
 			return S_OK;
 		}
+		virtual HRESULT COMLIGHTCALL timingsTraceStart() override final
+		{
+			logError( u8"Reference CPU model doesn’t support timeline traces" );
+			return E_NOTIMPL;
+		}
+		virtual HRESULT COMLIGHTCALL timingsTraceSave( const wchar_t* path ) override final
+		{
+			return E_NOTIMPL;
+		}
 
 		virtual HRESULT COMLIGHTCALL fullDefaultParams( eSamplingStrategy strategy, sFullParams* rdi )
 		{
@@ -181,6 +190,16 @@ namespace Whisper
 			return S_OK;
 		}
 
+		virtual HRESULT COMLIGHTCALL getLoadStageTimes( sLoadModelTimes& rdi ) override final
+		{
+			return E_NOTIMPL;
+		}
+
+		virtual HRESULT COMLIGHTCALL setResidentBudget( uint32_t megabytes ) override final
+		{
+			return S_FALSE;
+		}
+
 	public:
 
 		Context()